@@ -74,6 +74,7 @@ let sqliteFlags = (opsqliteConfig["sqliteFlags"] as? String) ?? ""
 let fts5 = (opsqliteConfig["fts5"] as? Bool) == true
 let rtree = (opsqliteConfig["rtree"] as? Bool) == true
 let useSqliteVec = (opsqliteConfig["sqliteVec"] as? Bool) == true
+let poolAllocator = (opsqliteConfig["poolAllocator"] as? Bool) == true
 let tokenizers = (opsqliteConfig["tokenizers"] as? [String]) ?? []
 
 if phoneVersion {
@@ -86,6 +87,9 @@ if phoneVersion {
   if useSqliteVec {
     fatalError("[OP-SQLITE] sqlite-vec is not supported with phone version. It cannot load extensions.")
   }
+  if poolAllocator {
+    fatalError("[OP-SQLITE] The pool allocator is not supported with phone version. The embedded SQLite is already initialized by the system.")
+  }
 }
 if useLibsql && useSqliteVec {
   fatalError("[OP-SQLITE] You cannot use sqlite-vec with libsql. libsql already has vector search included.")
@@ -96,6 +100,9 @@ if useTurso && useSqliteVec {
 if useTurso && useLibsql {
   fatalError("[OP-SQLITE] You cannot enable both libsql and turso backend.")
 }
+if poolAllocator && (useLibsql || useTurso) {
+  fatalError("[OP-SQLITE] The pool allocator is only available with the default sqlite or sqlcipher backends.")
+}
 if !tokenizers.isEmpty && useTurso {
   fatalError("[OP-SQLITE] Tokenizers are not supported with turso backend. Please disable tokenizers or do not enable turso.")
 }
@@ -305,6 +312,10 @@ if useSqliteVec {
   print("[OP-SQLITE] using Sqlite Vec ↗️")
   defines.append(("OP_SQLITE_USE_SQLITE_VEC", "1"))
 }
+if poolAllocator {
+  print("[OP-SQLITE] Pool allocator enabled")
+  defines.append(("OP_SQLITE_USE_POOL_ALLOCATOR", "1"))
+}
 if useLibsql {
   defines.append(("OP_SQLITE_USE_LIBSQL", "1"))
 }
@@ -22,7 +22,9 @@ struct OPSQLiteBridge : jni::JavaClass<OPSQLiteBridge> {
     javaClassStatic()->registerNatives(
         {makeNativeMethod("installNativeJsi", OPSQLiteBridge::installNativeJsi),
          makeNativeMethod("clearStateNativeJsi",
-                          OPSQLiteBridge::clearStateNativeJsi)});
+                          OPSQLiteBridge::clearStateNativeJsi),
+         makeNativeMethod("onMemoryPressureNativeJsi",
+                          OPSQLiteBridge::onMemoryPressureNativeJsi)});
   }
 
 private:
@@ -60,6 +62,11 @@ private:
     opsqlite::invalidate(*handle);
     delete handle;
   }
+
+  static void onMemoryPressureNativeJsi(jni::alias_ref<jni::JObject> thiz,
+                                        jboolean critical) {
+    opsqlite::on_memory_pressure(critical);
+  }
 };
 
 JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *) {
@@ -17,6 +17,7 @@ class OPSQLiteBridge {
         docPath: String
     ): Long
     private external fun clearStateNativeJsi(handle: Long)
+    private external fun onMemoryPressureNativeJsi(critical: Boolean)
 
     fun install(context: ReactContext): Long {
         val jsContextPointer = context.javaScriptContextHolder!!.get()
@@ -36,6 +37,11 @@ class OPSQLiteBridge {
         clearStateNativeJsi(handle)
     }
 
+    // Releases unused SQLite cache memory of every open database
+    fun onMemoryPressure(critical: Boolean) {
+        onMemoryPressureNativeJsi(critical)
+    }
+
     companion object {
         val instance = OPSQLiteBridge()
     }
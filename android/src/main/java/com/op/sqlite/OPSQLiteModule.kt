@@ -1,5 +1,7 @@
 package com.op.sqlite
 
+import android.content.ComponentCallbacks2
+import android.content.res.Configuration
 import android.util.Log
 import com.facebook.react.bridge.Promise
 import com.facebook.react.bridge.ReactApplicationContext
@@ -20,6 +22,24 @@ internal class OPSQLiteModule(context: ReactApplicationContext?) : ReactContextB
     // carries per-generation identity across the JNI boundary.
     private var generationAliveHandle: Long = 0
 
+    private val memoryCallbacks = object : ComponentCallbacks2 {
+        override fun onTrimMemory(level: Int) {
+            // UI_HIDDEN is just the app going to the background
+            if (level == ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN) {
+                return
+            }
+            val critical = level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL ||
+                    level >= ComponentCallbacks2.TRIM_MEMORY_MODERATE
+            OPSQLiteBridge.instance.onMemoryPressure(critical)
+        }
+
+        override fun onLowMemory() {
+            OPSQLiteBridge.instance.onMemoryPressure(true)
+        }
+
+        override fun onConfigurationChanged(newConfig: Configuration) {}
+    }
+
     override fun getName(): String {
         return NAME
     }
@@ -49,6 +69,7 @@ internal class OPSQLiteModule(context: ReactApplicationContext?) : ReactContextB
     fun install(): Boolean {
         return try {
             generationAliveHandle = OPSQLiteBridge.instance.install(reactApplicationContext)
+            reactApplicationContext.applicationContext.registerComponentCallbacks(memoryCallbacks)
             true
         } catch (exception: Exception) {
             Log.e(NAME, "Install exception: $exception")
@@ -112,6 +133,7 @@ internal class OPSQLiteModule(context: ReactApplicationContext?) : ReactContextB
 
     override fun invalidate() {
         super.invalidate()
+        reactApplicationContext.applicationContext.unregisterComponentCallbacks(memoryCallbacks)
         OPSQLiteBridge.instance.invalidate(generationAliveHandle)
     }
 
@@ -0,0 +1,510 @@
+#if defined(OP_SQLITE_USE_POOL_ALLOCATOR) && !defined(OP_SQLITE_USE_LIBSQL) && \
+    !defined(OP_SQLITE_USE_TURSO)
+
+#include "OPAllocator.hpp"
+#include "OPLogs.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+namespace opsqlite {
+
+namespace {
+
+// Every block starts with the usable size, SQLite needs it for xSize and 8
+// bytes keep the returned pointer 8 byte aligned
+constexpr size_t header_size = 8;
+constexpr int class_count = 64;
+constexpr size_t max_class_size = 16384;
+// Free blocks a thread keeps per class, in bytes. The shared pool keeps up to
+// four times as many.
+constexpr size_t thread_cache_budget = 16 * 1024;
+
+// 16 byte steps up to 256, then 8 classes per doubling up to 16KB. Rounding
+// wastes at most 12.5% and a 4KB page plus its header (4360 bytes) lands in
+// the 4608 class.
+constexpr size_t class_size(int index) {
+  if (index < 16) {
+    return static_cast<size_t>(index + 1) * 16;
+  }
+  int k = index - 16;
+  int log = 8 + k / 8;
+  return (size_t(1) << log) + (static_cast<size_t>(k % 8) + 1) *
+                                  (size_t(1) << (log - 3));
+}
+
+// size includes the header and is at most max_class_size
+inline int class_index(size_t size) {
+  if (size <= 256) {
+    return static_cast<int>((size + 15) / 16) - 1;
+  }
+  size_t n = size - 1;
+  int log = 63 - __builtin_clzll(static_cast<unsigned long long>(n));
+  return 16 + (log - 8) * 8 +
+         static_cast<int>((n - (size_t(1) << log)) >> (log - 3));
+}
+
+constexpr int cache_limit(int index) {
+  return static_cast<int>(std::clamp<size_t>(
+      thread_cache_budget / class_size(index), 4, 128));
+}
+
+inline size_t round8(size_t size) { return (size + 7) & ~size_t(7); }
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+// Only ever written by the owning thread, so a relaxed load plus store is
+// enough and the counters never bounce between cores. Other threads only
+// read them for stats.
+struct Counters {
+  std::atomic<long long> allocations{0};
+  std::atomic<long long> frees{0};
+  std::atomic<long long> thread_cache_hits{0};
+  std::atomic<long long> shared_pool_hits{0};
+  std::atomic<long long> system_allocations{0};
+  std::atomic<long long> large_allocations{0};
+  std::atomic<long long> bytes_in_use{0};
+  std::atomic<long long> bytes_cached{0};
+};
+
+inline void bump(std::atomic<long long> &counter, long long delta) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+void add_counters(AllocatorStats &stats, Counters const &counters) {
+  stats.allocations += counters.allocations.load(std::memory_order_relaxed);
+  stats.frees += counters.frees.load(std::memory_order_relaxed);
+  stats.thread_cache_hits +=
+      counters.thread_cache_hits.load(std::memory_order_relaxed);
+  stats.shared_pool_hits +=
+      counters.shared_pool_hits.load(std::memory_order_relaxed);
+  stats.system_allocations +=
+      counters.system_allocations.load(std::memory_order_relaxed);
+  stats.large_allocations +=
+      counters.large_allocations.load(std::memory_order_relaxed);
+  stats.bytes_in_use += counters.bytes_in_use.load(std::memory_order_relaxed);
+  stats.bytes_cached += counters.bytes_cached.load(std::memory_order_relaxed);
+}
+
+struct ThreadCache;
+
+struct SharedClass {
+  std::mutex mutex;
+  FreeBlock *head = nullptr;
+  int count = 0;
+};
+
+struct State {
+  SharedClass classes[class_count];
+  std::atomic<long long> shared_bytes{0};
+
+  // Live thread caches, plus the counters of threads that already exited
+  std::mutex registry_mutex;
+  std::unordered_set<ThreadCache *> caches;
+  AllocatorStats retired;
+};
+
+// Never destroyed, SQLite can still free memory while statics are torn down
+State &state() {
+  static State *instance = new State();
+  return *instance;
+}
+
+std::atomic<bool> installed{false};
+
+// Moves a list of free blocks to the shared pool, freeing what does not fit
+void release_blocks(int index, FreeBlock *list) {
+  auto &shared = state().classes[index];
+  int kept = 0;
+  {
+    std::lock_guard<std::mutex> g(shared.mutex);
+    int room = cache_limit(index) * 4 - shared.count;
+    while (list != nullptr && kept < room) {
+      FreeBlock *next = list->next;
+      list->next = shared.head;
+      shared.head = list;
+      list = next;
+      kept++;
+    }
+    shared.count += kept;
+  }
+  state().shared_bytes.fetch_add(static_cast<long long>(kept) *
+                                     static_cast<long long>(class_size(index)),
+                                 std::memory_order_relaxed);
+
+  while (list != nullptr) {
+    FreeBlock *next = list->next;
+    std::free(list);
+    list = next;
+  }
+}
+
+struct ThreadCache {
+  FreeBlock *heads[class_count] = {};
+  int counts[class_count] = {};
+  Counters counters;
+
+  ThreadCache() {
+    std::lock_guard<std::mutex> g(state().registry_mutex);
+    state().caches.insert(this);
+  }
+
+  ~ThreadCache();
+
+  // Takes half a cache worth of blocks from the shared pool
+  bool refill(int index) {
+    auto &shared = state().classes[index];
+    int taken = 0;
+    {
+      std::lock_guard<std::mutex> g(shared.mutex);
+      int batch = std::max(1, cache_limit(index) / 2);
+      while (shared.head != nullptr && taken < batch) {
+        FreeBlock *block = shared.head;
+        shared.head = block->next;
+        block->next = heads[index];
+        heads[index] = block;
+        taken++;
+      }
+      shared.count -= taken;
+    }
+    if (taken == 0) {
+      return false;
+    }
+
+    long long bytes = static_cast<long long>(taken) *
+                      static_cast<long long>(class_size(index));
+    state().shared_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counts[index] += taken;
+    bump(counters.bytes_cached, bytes);
+    return true;
+  }
+
+  // Hands half of the list to the shared pool once it is over the limit
+  void spill(int index) {
+    int batch = counts[index] / 2;
+    FreeBlock *list = heads[index];
+    FreeBlock *last = list;
+    for (int i = 1; i < batch; i++) {
+      last = last->next;
+    }
+    heads[index] = last->next;
+    last->next = nullptr;
+    counts[index] -= batch;
+    bump(counters.bytes_cached, -static_cast<long long>(batch) *
+                                    static_cast<long long>(class_size(index)));
+
+    release_blocks(index, list);
+  }
+
+  void trim() {
+    for (int index = 0; index < class_count; index++) {
+      FreeBlock *block = heads[index];
+      while (block != nullptr) {
+        FreeBlock *next = block->next;
+        std::free(block);
+        block = next;
+      }
+      heads[index] = nullptr;
+      counts[index] = 0;
+    }
+    counters.bytes_cached.store(0, std::memory_order_relaxed);
+  }
+};
+
+thread_local ThreadCache thread_cache;
+// Trivially destructible, still readable after thread_cache is destroyed
+thread_local bool thread_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+  for (int index = 0; index < class_count; index++) {
+    if (heads[index] != nullptr) {
+      release_blocks(index, heads[index]);
+      heads[index] = nullptr;
+      counts[index] = 0;
+    }
+  }
+  counters.bytes_cached.store(0, std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> g(state().registry_mutex);
+    add_counters(state().retired, counters);
+    state().caches.erase(this);
+  }
+  thread_cache_destroyed = true;
+}
+
+// nullptr while the thread is exiting, allocations then go straight to the
+// shared pool
+inline ThreadCache *local_cache() {
+  if (thread_cache_destroyed) {
+    return nullptr;
+  }
+  return &thread_cache;
+}
+
+// Bookkeeping for threads without a cache, rare enough to take the lock
+void count_without_cache(long long AllocatorStats::*field, long long delta) {
+  std::lock_guard<std::mutex> g(state().registry_mutex);
+  state().retired.*field += delta;
+}
+
+inline void *to_user(void *block, size_t size) {
+  *static_cast<sqlite3_int64 *>(block) = static_cast<sqlite3_int64>(size);
+  return static_cast<char *>(block) + header_size;
+}
+
+inline void *to_block(void *pointer) {
+  return static_cast<char *>(pointer) - header_size;
+}
+
+inline size_t usable_size(void *pointer) {
+  return static_cast<size_t>(*static_cast<sqlite3_int64 *>(to_block(pointer)));
+}
+
+void *pool_malloc(int requested) {
+  size_t total = round8(static_cast<size_t>(requested)) + header_size;
+  ThreadCache *cache = local_cache();
+
+  if (total > max_class_size) {
+    void *block = std::malloc(total);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    size_t size = total - header_size;
+    if (cache != nullptr) {
+      bump(cache->counters.allocations, 1);
+      bump(cache->counters.large_allocations, 1);
+      bump(cache->counters.system_allocations, 1);
+      bump(cache->counters.bytes_in_use, static_cast<long long>(size));
+    } else {
+      count_without_cache(&AllocatorStats::allocations, 1);
+      count_without_cache(&AllocatorStats::large_allocations, 1);
+      count_without_cache(&AllocatorStats::system_allocations, 1);
+      count_without_cache(&AllocatorStats::bytes_in_use,
+                          static_cast<long long>(size));
+    }
+    return to_user(block, size);
+  }
+
+  int index = class_index(total);
+  size_t block_size = class_size(index);
+  size_t size = block_size - header_size;
+  void *block = nullptr;
+
+  if (cache != nullptr) {
+    if (cache->heads[index] != nullptr) {
+      bump(cache->counters.thread_cache_hits, 1);
+    } else if (cache->refill(index)) {
+      bump(cache->counters.shared_pool_hits, 1);
+    }
+
+    FreeBlock *head = cache->heads[index];
+    if (head != nullptr) {
+      cache->heads[index] = head->next;
+      cache->counts[index]--;
+      bump(cache->counters.bytes_cached, -static_cast<long long>(block_size));
+      block = head;
+    } else {
+      block = std::malloc(block_size);
+      if (block == nullptr) {
+        return nullptr;
+      }
+      bump(cache->counters.system_allocations, 1);
+    }
+    bump(cache->counters.allocations, 1);
+    bump(cache->counters.bytes_in_use, static_cast<long long>(size));
+    return to_user(block, size);
+  }
+
+  block = std::malloc(block_size);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  count_without_cache(&AllocatorStats::allocations, 1);
+  count_without_cache(&AllocatorStats::system_allocations, 1);
+  count_without_cache(&AllocatorStats::bytes_in_use,
+                      static_cast<long long>(size));
+  return to_user(block, size);
+}
+
+void pool_free(void *pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+
+  size_t size = usable_size(pointer);
+  void *block = to_block(pointer);
+  ThreadCache *cache = local_cache();
+
+  if (cache == nullptr) {
+    count_without_cache(&AllocatorStats::frees, 1);
+    count_without_cache(&AllocatorStats::bytes_in_use,
+                        -static_cast<long long>(size));
+    if (size + header_size > max_class_size) {
+      std::free(block);
+    } else {
+      int index = class_index(size + header_size);
+      auto list = static_cast<FreeBlock *>(block);
+      list->next = nullptr;
+      release_blocks(index, list);
+    }
+    return;
+  }
+
+  bump(cache->counters.frees, 1);
+  bump(cache->counters.bytes_in_use, -static_cast<long long>(size));
+
+  if (size + header_size > max_class_size) {
+    std::free(block);
+    return;
+  }
+
+  int index = class_index(size + header_size);
+  auto free_block = static_cast<FreeBlock *>(block);
+  free_block->next = cache->heads[index];
+  cache->heads[index] = free_block;
+  cache->counts[index]++;
+  bump(cache->counters.bytes_cached, static_cast<long long>(class_size(index)));
+
+  if (cache->counts[index] > cache_limit(index)) {
+    cache->spill(index);
+  }
+}
+
+int pool_size(void *pointer) {
+  return pointer == nullptr ? 0 : static_cast<int>(usable_size(pointer));
+}
+
+// SQLite asks before allocating and uses the whole block, e.g. to grow
+// strings in place
+int pool_roundup(int requested) {
+  size_t total = round8(static_cast<size_t>(requested)) + header_size;
+  if (total > max_class_size) {
+    return static_cast<int>(total - header_size);
+  }
+  return static_cast<int>(class_size(class_index(total)) - header_size);
+}
+
+void *pool_realloc(void *pointer, int requested) {
+  size_t size = usable_size(pointer);
+  size_t total = round8(static_cast<size_t>(requested)) + header_size;
+
+  // Still fits the same class, nothing to move
+  if (size + header_size <= max_class_size && total <= max_class_size &&
+      class_index(total) == class_index(size + header_size)) {
+    return pointer;
+  }
+
+  // Large to large, let the system allocator grow it in place if it can
+  if (size + header_size > max_class_size && total > max_class_size) {
+    void *block = std::realloc(to_block(pointer), total);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    long long delta = static_cast<long long>(total - header_size) -
+                      static_cast<long long>(size);
+    ThreadCache *cache = local_cache();
+    if (cache != nullptr) {
+      bump(cache->counters.bytes_in_use, delta);
+    } else {
+      count_without_cache(&AllocatorStats::bytes_in_use, delta);
+    }
+    return to_user(block, total - header_size);
+  }
+
+  void *moved = pool_malloc(requested);
+  if (moved == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(moved, pointer, std::min(size, usable_size(moved)));
+  pool_free(pointer);
+  return moved;
+}
+
+int pool_init(void * /*data*/) { return SQLITE_OK; }
+
+void pool_shutdown(void * /*data*/) { trim_pool_allocator(); }
+
+} // namespace
+
+bool install_pool_allocator() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    static sqlite3_mem_methods methods = {
+        pool_malloc, pool_free,   pool_realloc,   pool_size,
+        pool_roundup, pool_init, pool_shutdown, nullptr};
+
+    // Fails with SQLITE_MISUSE once SQLite is initialized, e.g. when
+    // something else in the process opened a database first
+    if (sqlite3_config(SQLITE_CONFIG_MALLOC, &methods) != SQLITE_OK) {
+      LOGW("Could not install the pool allocator, SQLite was already "
+           "initialized");
+      return;
+    }
+    installed = true;
+  });
+
+  return installed;
+}
+
+bool is_pool_allocator_installed() { return installed; }
+
+AllocatorStats get_pool_allocator_stats() {
+  AllocatorStats stats;
+  {
+    std::lock_guard<std::mutex> g(state().registry_mutex);
+    stats = state().retired;
+    for (ThreadCache *cache : state().caches) {
+      add_counters(stats, cache->counters);
+    }
+  }
+  // Exited threads handed their blocks to the shared pool
+  stats.bytes_cached += state().shared_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void trim_pool_allocator() {
+  ThreadCache *cache = local_cache();
+  if (cache != nullptr) {
+    cache->trim();
+  }
+
+  for (int index = 0; index < class_count; index++) {
+    auto &shared = state().classes[index];
+    FreeBlock *list = nullptr;
+    int count = 0;
+    {
+      std::lock_guard<std::mutex> g(shared.mutex);
+      list = shared.head;
+      count = shared.count;
+      shared.head = nullptr;
+      shared.count = 0;
+    }
+    state().shared_bytes.fetch_sub(static_cast<long long>(count) *
+                                       static_cast<long long>(
+                                           class_size(index)),
+                                   std::memory_order_relaxed);
+    while (list != nullptr) {
+      FreeBlock *next = list->next;
+      std::free(list);
+      list = next;
+    }
+  }
+}
+
+void configure_lookaside(sqlite3 *db) {
+  // A null buffer makes SQLite allocate it, as one large block
+  sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, nullptr,
+                    OP_SQLITE_LOOKASIDE_SLOT_SIZE, OP_SQLITE_LOOKASIDE_SLOTS);
+}
+
+} // namespace opsqlite
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#if defined(OP_SQLITE_USE_POOL_ALLOCATOR) && !defined(OP_SQLITE_USE_LIBSQL) && \
+    !defined(OP_SQLITE_USE_TURSO)
+
+#ifdef __ANDROID__
+#include "sqlite3.h"
+#else
+#include <sqlite3.h>
+#endif
+
+// Lookaside given to every connection. SQLite's default is 1200 x 40, the
+// extra slots keep statement and row objects out of the allocator entirely.
+// Can be overridden through sqliteFlags.
+#ifndef OP_SQLITE_LOOKASIDE_SLOT_SIZE
+#define OP_SQLITE_LOOKASIDE_SLOT_SIZE 1200
+#endif
+#ifndef OP_SQLITE_LOOKASIDE_SLOTS
+#define OP_SQLITE_LOOKASIDE_SLOTS 128
+#endif
+
+namespace opsqlite {
+
+// Process wide counters. Each thread counts on its own, so a snapshot taken
+// while queries run can be slightly off.
+struct AllocatorStats {
+  long long allocations = 0;
+  long long frees = 0;
+  // Allocations served by the calling thread's cache, without any locking
+  long long thread_cache_hits = 0;
+  // Allocations served by the pool shared between threads
+  long long shared_pool_hits = 0;
+  // Calls to the system allocator, cache misses plus large allocations
+  long long system_allocations = 0;
+  // Allocations above the biggest size class, they bypass the pools
+  long long large_allocations = 0;
+  long long bytes_in_use = 0;
+  // Free blocks kept in the caches and the shared pool
+  long long bytes_cached = 0;
+};
+
+// Makes SQLite allocate through size-class pools: every thread keeps a small
+// free list per class and only touches the shared pool, behind a lock, to
+// refill or spill a batch. The worker thread and the JS thread then stop
+// contending on the system malloc for the many short lived allocations a
+// query makes. Has to run before SQLite is initialized, returns false (and
+// SQLite keeps its own allocator) otherwise.
+bool install_pool_allocator();
+bool is_pool_allocator_installed();
+AllocatorStats get_pool_allocator_stats();
+// Returns the blocks cached by the calling thread and the shared pool to the
+// system
+void trim_pool_allocator();
+// Applies the lookaside size above, must run right after opening
+void configure_lookaside(sqlite3 *db);
+
+} // namespace opsqlite
+
+#endif
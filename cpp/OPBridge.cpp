@@ -3,11 +3,13 @@
 // so that threading operations are safe and contained within OPDatabase
 
 #include "OPBridge.hpp"
+#include "OPAllocator.hpp"
 #include "OPDatabase.hpp"
 #include "OPDumbHostObject.hpp"
 #include "OPSmartHostObject.hpp"
 #include "OPLogs.h"
 #include "OPUtils.hpp"
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <sqlite3.h>
@@ -35,7 +37,7 @@ inline void opsqlite_bind_statement(sqlite3_stmt *statement,
 
   for (int ii = 0; ii < size; ii++) {
     int stmt_index = ii + 1;
-    JSVariant value = values->at(ii);
+    const JSVariant &value = values->at(ii);
 
     std::visit(
         [&](auto &&v) {
@@ -45,8 +47,10 @@ inline void opsqlite_bind_statement(sqlite3_stmt *statement,
             sqlite3_bind_int(statement, stmt_index, static_cast<int>(v));
           } else if constexpr (std::is_same_v<T, int>) {
             sqlite3_bind_int(statement, stmt_index, v);
-          } else if constexpr (std::is_same_v<T, long long>) {
-            sqlite3_bind_double(statement, stmt_index, static_cast<double>(v));
+          } else if constexpr (std::is_same_v<T, long> ||
+                               std::is_same_v<T, long long>) {
+            sqlite3_bind_int64(statement, stmt_index,
+                               static_cast<sqlite3_int64>(v));
           } else if constexpr (std::is_same_v<T, double>) {
             sqlite3_bind_double(statement, stmt_index, v);
           } else if constexpr (std::is_same_v<T, std::string>) {
@@ -110,6 +114,10 @@ sqlite3 *opsqlite_open(std::string const &name, std::string const &path,
     throw std::runtime_error(sqlite3_errmsg(db));
   }
 
+#ifdef OP_SQLITE_USE_POOL_ALLOCATOR
+  configure_lookaside(db);
+#endif
+
 #ifdef OP_SQLITE_USE_SQLCIPHER
   if (!encryption_key.empty()) {
     // Use the SQLCipher C API directly instead of `PRAGMA key = '...'`.
@@ -851,6 +859,22 @@ void opsqlite_deregister_rollback_hook(sqlite3 *db) {
   sqlite3_rollback_hook(db, nullptr, nullptr);
 }
 
+int authorizer_callback(void *opsqlite_db_ptr, int action, char const *arg1,
+                        char const *arg2,
+                        [[maybe_unused]] char const *database,
+                        [[maybe_unused]] char const *trigger) {
+  auto opsqlite_db = reinterpret_cast<OPDatabase *>(opsqlite_db_ptr);
+  return opsqlite_db->on_authorize(action, arg1, arg2);
+}
+
+void opsqlite_register_authorizer(sqlite3 *db, void *opsqlite_db_ptr) {
+  sqlite3_set_authorizer(db, &authorizer_callback, opsqlite_db_ptr);
+}
+
+void opsqlite_deregister_authorizer(sqlite3 *db) {
+  sqlite3_set_authorizer(db, nullptr, nullptr);
+}
+
 void opsqlite_load_extension(sqlite3 *db, std::string &path,
                              std::string &entry_point) {
 #ifdef OP_SQLITE_USE_PHONE_VERSION
@@ -879,6 +903,146 @@ void opsqlite_load_extension(sqlite3 *db, std::string &path,
 #endif
 }
 
+sqlite3_backup *opsqlite_backup_init(sqlite3 *db, std::string const &schema,
+                                     std::string const &dest_path,
+                                     sqlite3 **dest) {
+  create_dirs_if_needed(dest_path);
+
+  int status = sqlite3_open_v2(
+      dest_path.c_str(), dest,
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+      nullptr);
+
+  if (status != SQLITE_OK) {
+    std::string message = sqlite3_errmsg(*dest);
+    sqlite3_close_v2(*dest);
+    *dest = nullptr;
+    throw std::runtime_error("[op-sqlite][backup] " + message);
+  }
+
+  sqlite3_backup *backup =
+      sqlite3_backup_init(*dest, "main", db, schema.c_str());
+
+  if (backup == nullptr) {
+    std::string message = sqlite3_errmsg(*dest);
+    sqlite3_close_v2(*dest);
+    *dest = nullptr;
+    throw std::runtime_error("[op-sqlite][backup] " + message);
+  }
+
+  return backup;
+}
+
+int opsqlite_backup_step(sqlite3_backup *backup, sqlite3 *dest, int pages) {
+  int status = sqlite3_backup_step(backup, pages);
+
+  switch (status) {
+  case SQLITE_DONE:
+  case SQLITE_OK:
+  case SQLITE_BUSY:
+  case SQLITE_LOCKED:
+    return status;
+  default:
+    throw std::runtime_error("[op-sqlite][backup] " +
+                             std::string(sqlite3_errmsg(dest)));
+  }
+}
+
+void opsqlite_backup_finish(sqlite3_backup *backup, sqlite3 *dest) {
+  if (backup != nullptr) {
+    sqlite3_backup_finish(backup);
+  }
+  if (dest != nullptr) {
+    sqlite3_close_v2(dest);
+  }
+}
+
+unsigned char *opsqlite_serialize(sqlite3 *db, std::string const &schema,
+                                  sqlite3_int64 *size) {
+  unsigned char *data = sqlite3_serialize(db, schema.c_str(), size, 0);
+
+  if (data == nullptr) {
+    throw std::runtime_error("[op-sqlite][serialize] Could not serialize "
+                             "schema " +
+                             schema + ": " + sqlite3_errmsg(db));
+  }
+
+  return data;
+}
+
+void opsqlite_read_schema(sqlite3 *db) {
+  int status = sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", nullptr,
+                            nullptr, nullptr);
+  if (status != SQLITE_OK) {
+    throw std::runtime_error("[op-sqlite][openAsync] " +
+                             std::string(sqlite3_errmsg(db)));
+  }
+}
+
+bool opsqlite_fires_update_hook(sqlite3 *db, std::string const &table) {
+  // table_list knows about every schema and flags WITHOUT ROWID tables, it
+  // only exists since SQLite 3.37 though. Older ones (iosSqlite) fall back to
+  // the CREATE statement, where a false match only costs a cache entry.
+  static const char *const queries[] = {
+      "SELECT 1 FROM pragma_table_list(?1) "
+      "WHERE wr OR type NOT IN ('table', 'shadow')",
+      "SELECT 1 FROM sqlite_schema WHERE type = 'table' AND name = ?1 AND "
+      "(sql LIKE 'CREATE VIRTUAL%' OR sql LIKE '%WITHOUT%ROWID%') "
+      "UNION ALL "
+      "SELECT 1 FROM sqlite_temp_schema WHERE type = 'table' AND name = ?1 AND "
+      "(sql LIKE 'CREATE VIRTUAL%' OR sql LIKE '%WITHOUT%ROWID%')"};
+
+  for (const char *query : queries) {
+    sqlite3_stmt *statement = nullptr;
+    if (sqlite3_prepare_v2(db, query, -1, &statement, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(statement);
+      continue;
+    }
+    sqlite3_bind_text(statement, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+    int status = sqlite3_step(statement);
+    sqlite3_finalize(statement);
+    return status == SQLITE_DONE;
+  }
+  return false;
+}
+
+void opsqlite_deserialize(sqlite3 *db, const uint8_t *data, size_t size,
+                          bool read_only) {
+  auto *image = static_cast<unsigned char *>(sqlite3_malloc64(size));
+  if (image == nullptr && size > 0) {
+    throw std::runtime_error(
+        "[op-sqlite][deserialize] Could not allocate database image");
+  }
+  memcpy(image, data, size);
+
+  // Images taken from WAL databases keep the WAL version bytes in their
+  // header, which an in-memory database can't open, so flag them as rollback
+  if (size >= 20 && image[18] == 2 && image[19] == 2) {
+    image[18] = 1;
+    image[19] = 1;
+  }
+
+  unsigned flags = SQLITE_DESERIALIZE_FREEONCLOSE;
+  flags |= read_only ? SQLITE_DESERIALIZE_READONLY
+                     : SQLITE_DESERIALIZE_RESIZEABLE;
+
+  // SQLite takes ownership of image even when this fails
+  int status = sqlite3_deserialize(db, "main", image, size, size, flags);
+
+  if (status != SQLITE_OK) {
+    throw std::runtime_error("[op-sqlite][deserialize] " +
+                             std::string(sqlite3_errmsg(db)));
+  }
+
+  // A bad image is only detected once the schema is read
+  status = sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", nullptr,
+                        nullptr, nullptr);
+  if (status != SQLITE_OK) {
+    throw std::runtime_error("[op-sqlite][deserialize] " +
+                             std::string(sqlite3_errmsg(db)));
+  }
+}
+
 BatchResult
 opsqlite_execute_batch(sqlite3 *db,
                        const std::vector<BatchArguments> *commands) {
@@ -893,8 +1057,7 @@ opsqlite_execute_batch(sqlite3 *db,
     const auto &command = commands->at(i);
     // We do not provide a datastructure to receive query data because we
     // don't need/want to handle this results in a batch execution
-    // There is also no need to commit/catch this transaction, this is done
-    // in the JS code
+    // The transaction is opened and committed or rolled back by executeBatch
     auto result = opsqlite_execute(db, command.sql, &command.params);
     affectedRows += result.affectedRows;
   }
@@ -49,7 +49,11 @@ sqlite3 *opsqlite_open_remote(std::string const &url,
                               std::string const &auth_token,
                               std::string const &base_path);
 
-void opsqlite_sync(sqlite3 *db);
+// Pushes local changes, then pulls and applies the remote ones. on_phase is
+// told "push", "pull" and "apply" as each of them starts.
+void opsqlite_sync(
+    sqlite3 *db,
+    std::function<void(const std::string &phase)> const &on_phase = nullptr);
 #endif
 
 void opsqlite_close(sqlite3 *db);
@@ -84,6 +88,8 @@ void opsqlite_register_commit_hook(sqlite3 *db, void *opsqlite_db_ptr);
 void opsqlite_deregister_commit_hook(sqlite3 *db);
 void opsqlite_register_rollback_hook(sqlite3 *db, void *opsqlite_db_ptr);
 void opsqlite_deregister_rollback_hook(sqlite3 *db);
+void opsqlite_register_authorizer(sqlite3 *db, void *opsqlite_db_ptr);
+void opsqlite_deregister_authorizer(sqlite3 *db);
 
 sqlite3_stmt *opsqlite_prepare_statement(sqlite3 *db, std::string const &query);
 
@@ -100,4 +106,37 @@ BridgeResult opsqlite_execute_prepared_statement(
 void opsqlite_load_extension(sqlite3 *db, std::string &path,
                              std::string &entry_point);
 
+// Online backup of schema into the database file at dest_path. The
+// destination connection is returned through dest and both are released by
+// opsqlite_backup_finish
+sqlite3_backup *opsqlite_backup_init(sqlite3 *db, std::string const &schema,
+                                     std::string const &dest_path,
+                                     sqlite3 **dest);
+
+// Copies up to pages pages and returns SQLITE_DONE once the backup is
+// complete, SQLITE_OK when pages remain, or SQLITE_BUSY/SQLITE_LOCKED when the
+// step has to be retried later. Throws on any other error.
+int opsqlite_backup_step(sqlite3_backup *backup, sqlite3 *dest, int pages);
+
+void opsqlite_backup_finish(sqlite3_backup *backup, sqlite3 *dest);
+
+// Database image of schema, allocated by SQLite and released by the caller
+// with sqlite3_free
+unsigned char *opsqlite_serialize(sqlite3 *db, std::string const &schema,
+                                  sqlite3_int64 *size);
+
+// Reads the schema so the first query doesn't pay for it, with SQLCipher this
+// is also where the key is derived and checked
+void opsqlite_read_schema(sqlite3 *db);
+
+// Whether writes to table reach the update hook. SQLite skips it for WITHOUT
+// ROWID and virtual tables. Prepares statements, so not from inside an
+// authorizer callback.
+bool opsqlite_fires_update_hook(sqlite3 *db, std::string const &table);
+
+// Replaces main with the database image in data. The image is copied into
+// memory owned by SQLite, data can be released right after.
+void opsqlite_deserialize(sqlite3 *db, const uint8_t *data, size_t size,
+                          bool read_only);
+
 } // namespace opsqlite
@@ -0,0 +1,148 @@
+#include "OPCancellation.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+namespace opsqlite {
+
+namespace {
+
+// Fires timeouts in deadline order. Leaked on purpose, it has to outlive
+// every token and a thread still running at exit can't be joined safely.
+class Watchdog {
+public:
+  static Watchdog &instance() {
+    static Watchdog *watchdog = new Watchdog();
+    return *watchdog;
+  }
+
+  void add(std::chrono::steady_clock::time_point deadline,
+           std::weak_ptr<QueryToken> token) {
+    {
+      std::lock_guard<std::mutex> g(mutex);
+      deadlines.emplace(deadline, std::move(token));
+      if (!started) {
+        started = true;
+        std::thread(&Watchdog::run, this).detach();
+      }
+    }
+    wake.notify_one();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      if (deadlines.empty()) {
+        wake.wait(lock);
+        continue;
+      }
+
+      auto next = deadlines.begin();
+      if (std::chrono::steady_clock::now() < next->first) {
+        wake.wait_until(lock, next->first);
+        continue;
+      }
+
+      auto token = next->second.lock();
+      deadlines.erase(next);
+      lock.unlock();
+      if (token != nullptr) {
+        token->cancel(QueryToken::Reason::TimedOut);
+      }
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::multimap<std::chrono::steady_clock::time_point,
+                std::weak_ptr<QueryToken>>
+      deadlines;
+  bool started = false;
+};
+
+} // namespace
+
+QueryToken::QueryToken(std::string function_name,
+                       std::function<void()> interrupt)
+    : function_name(std::move(function_name)),
+      interrupt(std::move(interrupt)) {}
+
+void QueryToken::cancel(Reason cancel_reason) {
+  std::lock_guard<std::mutex> g(mutex);
+  if (reason != Reason::None) {
+    return;
+  }
+  reason = cancel_reason;
+
+  // Under the lock, finish() can't return while the interrupt is in flight,
+  // so it never lands on the next task's statements
+  if (running && interrupt) {
+    interrupt();
+  }
+}
+
+bool QueryToken::is_cancelled() const { return reason != Reason::None; }
+
+bool QueryToken::start() {
+  std::lock_guard<std::mutex> g(mutex);
+  if (reason != Reason::None) {
+    return false;
+  }
+  running = true;
+  return true;
+}
+
+void QueryToken::finish() {
+  std::lock_guard<std::mutex> g(mutex);
+  running = false;
+}
+
+std::string QueryToken::error() const {
+  if (reason == Reason::TimedOut) {
+    return "[op-sqlite][" + function_name + "] Query timed out after " +
+           std::to_string(timeout_ms) + "ms";
+  }
+  if (reason == Reason::Expired) {
+    return "[op-sqlite][" + function_name + "] Query waited more than " +
+           std::to_string(deadline_ms) + "ms in the queue";
+  }
+  return "[op-sqlite][" + function_name + "] Query aborted";
+}
+
+void QueryToken::schedule_timeout(std::shared_ptr<QueryToken> const &token,
+                                  int timeout_ms) {
+  token->timeout_ms = timeout_ms;
+  Watchdog::instance().add(std::chrono::steady_clock::now() +
+                               std::chrono::milliseconds(timeout_ms),
+                           token);
+}
+
+void QueryToken::set_deadline(int deadline_ms) {
+  this->deadline_ms = deadline_ms;
+  deadline_at = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(deadline_ms);
+}
+
+std::chrono::steady_clock::time_point QueryToken::deadline() const {
+  return deadline_at;
+}
+
+void QueryToken::on_settled(
+    std::function<void(facebook::jsi::Runtime &)> callback) {
+  settled_callback = std::move(callback);
+}
+
+void QueryToken::settled(facebook::jsi::Runtime &rt) {
+  // Moved out so whatever JS values it holds are released here, on the JS
+  // thread, and not wherever the last reference to the token goes
+  auto callback = std::move(settled_callback);
+  settled_callback = nullptr;
+  if (callback) {
+    callback(rt);
+  }
+}
+
+} // namespace opsqlite
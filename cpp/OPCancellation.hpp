@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace facebook::jsi {
+class Runtime;
+}
+
+namespace opsqlite {
+
+// Cancellation state of one async call, created from its { signal, timeoutMs,
+// deadlineMs } options. Cancelled before it starts the task is skipped,
+// cancelled while it runs the running statement is interrupted (where the
+// backend supports it). A task that completes anyway keeps its result.
+class QueryToken {
+public:
+  // Expired: still queued at its deadline
+  enum class Reason { None, Aborted, TimedOut, Expired };
+
+  // interrupt stops whatever statement runs on the connection right now, it
+  // is only called between start() and finish(). Can be empty.
+  QueryToken(std::string function_name, std::function<void()> interrupt);
+
+  // Safe from any thread
+  void cancel(Reason reason);
+  bool is_cancelled() const;
+
+  // Bracket the task on the worker. start() returns false if the token was
+  // cancelled already and the task should not run at all.
+  bool start();
+  void finish();
+
+  // Error the promise is rejected with once cancelled
+  std::string error() const;
+
+  // Cancels the token with Reason::TimedOut after timeout_ms, unless it is
+  // gone by then. Timeouts share a single watchdog thread.
+  static void schedule_timeout(std::shared_ptr<QueryToken> const &token,
+                               int timeout_ms);
+
+  // Latest time the task may start, for the thread pool to enforce.
+  // time_point::max() unless set.
+  void set_deadline(int deadline_ms);
+  std::chrono::steady_clock::time_point deadline() const;
+
+  // Undoes what the options set up on the JS side, e.g. removes the abort
+  // listener of the signal. settled() runs it once the promise resolves or
+  // rejects. Both only on the JS thread.
+  void on_settled(std::function<void(facebook::jsi::Runtime &)> callback);
+  void settled(facebook::jsi::Runtime &rt);
+
+private:
+  std::string function_name;
+  std::function<void()> interrupt;
+  int timeout_ms = 0;
+  int deadline_ms = 0;
+  std::chrono::steady_clock::time_point deadline_at =
+      std::chrono::steady_clock::time_point::max();
+  std::function<void(facebook::jsi::Runtime &)> settled_callback;
+
+  std::mutex mutex;
+  std::atomic<Reason> reason{Reason::None};
+  bool running = false;
+};
+
+} // namespace opsqlite
@@ -0,0 +1,185 @@
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+
+#include "OPCheckpointScheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#ifdef __APPLE__
+#include <pthread.h>
+#elif defined(__ANDROID__)
+#include <sys/resource.h>
+#endif
+
+namespace opsqlite {
+
+namespace {
+
+// Value of the first column of a single row pragma
+std::string read_pragma(sqlite3 *db, const char *pragma) {
+  sqlite3_stmt *statement = nullptr;
+  std::string query = std::string("PRAGMA ") + pragma;
+
+  if (sqlite3_prepare_v2(db, query.c_str(), -1, &statement, nullptr) !=
+      SQLITE_OK) {
+    throw std::runtime_error("[op-sqlite][startCheckpointScheduler] " +
+                             std::string(sqlite3_errmsg(db)));
+  }
+
+  std::string value;
+  if (sqlite3_step(statement) == SQLITE_ROW) {
+    auto text = sqlite3_column_text(statement, 0);
+    if (text != nullptr) {
+      value = reinterpret_cast<const char *>(text);
+    }
+  }
+  sqlite3_finalize(statement);
+
+  return value;
+}
+
+} // namespace
+
+CheckpointScheduler::CheckpointScheduler(
+    sqlite3 *db, std::shared_ptr<ThreadPool> thread_pool,
+    long long wal_size_limit, int idle_ms)
+    : db(db), thread_pool(std::move(thread_pool)), idle_time(idle_ms) {
+  std::string journal_mode = read_pragma(db, "journal_mode");
+  if (journal_mode != "wal") {
+    throw std::runtime_error("[op-sqlite][startCheckpointScheduler] "
+                             "journal_mode must be WAL, it is " +
+                             journal_mode);
+  }
+
+  // Every WAL frame is a page plus a 24 byte header
+  long long frame_size = std::stoll(read_pragma(db, "page_size")) + 24;
+  frame_limit = static_cast<int>(
+      std::clamp(wal_size_limit / frame_size, 1LL, 1LL << 30));
+  previous_auto_checkpoint = std::stoi(read_pragma(db, "wal_autocheckpoint"));
+
+  last_commit = std::chrono::steady_clock::now();
+  sqlite3_wal_hook(db, on_wal_commit, this);
+  thread = std::thread(&CheckpointScheduler::run, this);
+}
+
+CheckpointScheduler::~CheckpointScheduler() {
+  // Takes the connection mutex, so once it returns no commit is still inside
+  // on_wal_commit. Also puts the default auto-checkpoint hook back.
+  sqlite3_wal_autocheckpoint(db, previous_auto_checkpoint);
+
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+CheckpointStats CheckpointScheduler::stats() {
+  std::lock_guard<std::mutex> g(mutex);
+  return _stats;
+}
+
+// Called by SQLite after every commit in WAL mode, on the committing thread
+// and with the connection mutex held. Must not touch the connection.
+int CheckpointScheduler::on_wal_commit(void *scheduler, sqlite3 * /*db*/,
+                                       const char * /*schema*/, int frames) {
+  auto self = static_cast<CheckpointScheduler *>(scheduler);
+
+  {
+    std::lock_guard<std::mutex> g(self->mutex);
+    self->pending_frames = std::max(self->pending_frames, frames);
+    self->last_commit = std::chrono::steady_clock::now();
+  }
+  self->wake.notify_all();
+
+  return SQLITE_OK;
+}
+
+void CheckpointScheduler::run() {
+  // Checkpoints are background work, let queries and the UI go first
+#ifdef __APPLE__
+  pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__ANDROID__)
+  setpriority(PRIO_PROCESS, 0, 10);
+#endif
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (pending_frames == 0) {
+      wake.wait(lock);
+      continue;
+    }
+
+    bool over_limit = pending_frames >= frame_limit;
+    if (!over_limit) {
+      auto idle_at = last_commit + idle_time;
+      if (std::chrono::steady_clock::now() < idle_at) {
+        wake.wait_until(lock, idle_at);
+        continue;
+      }
+
+      // Quiet for long enough but a query is still running or queued
+      if (!thread_pool->is_idle()) {
+        wake.wait_for(lock, idle_time);
+        continue;
+      }
+    }
+
+    pending_frames = 0;
+    lock.unlock();
+    checkpoint(over_limit);
+    lock.lock();
+  }
+}
+
+void CheckpointScheduler::checkpoint(bool truncate) {
+  auto start = std::chrono::steady_clock::now();
+  int log_frames = 0;
+  int checkpointed_frames = 0;
+
+  int status = sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                         &log_frames, &checkpointed_frames);
+
+  // TRUNCATE waits on the busy handler while holding the connection, so it
+  // only runs once the WAL is too big and the passive pass copied everything,
+  // i.e. when nothing else is expected to hold it up. All that is left to do
+  // is resetting the file.
+  bool truncated = false;
+  if (status == SQLITE_OK && truncate && checkpointed_frames >= log_frames) {
+    status = sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                       &log_frames, &checkpointed_frames);
+    truncated = status == SQLITE_OK;
+  }
+
+  auto duration = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start);
+  // BUSY, LOCKED (a shared-cache connection holds the WAL, the busy handler
+  // never runs for it), or frames left behind a reader on another connection
+  bool blocked = status == SQLITE_BUSY || status == SQLITE_LOCKED ||
+                 (status == SQLITE_OK && checkpointed_frames < log_frames);
+
+  std::lock_guard<std::mutex> g(mutex);
+  _stats.checkpoints++;
+  if (truncated) {
+    _stats.truncates++;
+  }
+  if (blocked) {
+    _stats.busy++;
+    // Try again after the next idle period, even without new commits. Below
+    // the limit on purpose, retrying right away would only spin.
+    if (pending_frames == 0) {
+      pending_frames = 1;
+      last_commit = std::chrono::steady_clock::now();
+    }
+  }
+  _stats.wal_frames = log_frames;
+  _stats.checkpointed_frames = checkpointed_frames;
+  _stats.last_duration_ms = duration.count();
+}
+
+} // namespace opsqlite
+
+#endif
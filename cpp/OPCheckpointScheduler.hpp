@@ -0,0 +1,74 @@
+#pragma once
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+
+#include "OPThreadPool.hpp"
+#ifdef __ANDROID__
+#include "sqlite3.h"
+#else
+#include <sqlite3.h>
+#endif
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace opsqlite {
+
+struct CheckpointStats {
+  int checkpoints = 0;
+  // Checkpoints escalated to TRUNCATE because the WAL crossed the size limit
+  int truncates = 0;
+  // Checkpoints that could not copy every frame, e.g. because of a reader on
+  // another connection, or that failed with SQLITE_BUSY or SQLITE_LOCKED.
+  // Retried on the next idle period.
+  int busy = 0;
+  // Frames in the WAL and frames copied back by the last checkpoint
+  int wal_frames = 0;
+  int checkpointed_frames = 0;
+  double last_duration_ms = 0;
+};
+
+// Replaces SQLite's auto-checkpoint for one connection. Commits only record
+// the WAL size (through sqlite3_wal_hook, which also turns auto-checkpoint
+// off) and a low priority thread checkpoints once the database has been idle
+// for idle_ms, or right away when the WAL crosses wal_size_limit bytes.
+// Checkpoints are PASSIVE, escalating to TRUNCATE above the limit so the file
+// shrinks again.
+class CheckpointScheduler {
+public:
+  // Throws if the database is not in WAL mode
+  CheckpointScheduler(sqlite3 *db, std::shared_ptr<ThreadPool> thread_pool,
+                      long long wal_size_limit, int idle_ms);
+  // Stops the thread and restores the previous auto-checkpoint setting, must
+  // run before the connection is closed
+  ~CheckpointScheduler();
+
+  CheckpointStats stats();
+
+private:
+  static int on_wal_commit(void *scheduler, sqlite3 *db, const char *schema,
+                           int frames);
+  void run();
+  void checkpoint(bool truncate);
+
+  sqlite3 *db;
+  std::shared_ptr<ThreadPool> thread_pool;
+  int frame_limit;
+  std::chrono::milliseconds idle_time;
+  int previous_auto_checkpoint;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  int pending_frames = 0;
+  std::chrono::steady_clock::time_point last_commit;
+  CheckpointStats _stats;
+
+  std::thread thread;
+};
+
+} // namespace opsqlite
+
+#endif
@@ -5,13 +5,27 @@
 #else
 #include "OPBridge.hpp"
 #endif
+#include "OPAllocator.hpp"
 #include "OPLogs.h"
 #include "OPMacros.hpp"
 #include "OPUtils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <thread>
 #include <utility>
 
+// executeFast runs a statement on the JS thread only if it took less than
+// this many microseconds the last time. Can be overridden through sqliteFlags.
+#ifndef OP_SQLITE_FAST_PATH_MAX_US
+#define OP_SQLITE_FAST_PATH_MAX_US 500
+#endif
+
 namespace opsqlite {
 
 namespace jsi = facebook::jsi;
@@ -95,6 +109,10 @@ void OPDatabase::on_rollback() {
 
 void OPDatabase::on_update(const std::string &table,
                              const std::string &operation, long long row_id) {
+  if (is_query_cache_enabled) {
+    query_cache.invalidate_table(table);
+  }
+
   if (alive != nullptr && !alive->load()) {
     return;
   }
@@ -160,7 +178,7 @@ void OPDatabase::sync_update_hook_registration() {
   }
 
   if (update_hook_callback == nullptr && reactive_queries.empty() &&
-      is_update_hook_registered) {
+      !is_query_cache_enabled && is_update_hook_registered) {
     opsqlite_deregister_update_hook(db);
     is_update_hook_registered = false;
     return;
@@ -173,7 +191,459 @@ void OPDatabase::sync_update_hook_registration() {
   opsqlite_register_update_hook(db, this);
   is_update_hook_registered = true;
 }
+
+void OPDatabase::enable_query_cache() {
+  if (is_query_cache_enabled) {
+    return;
+  }
+
+  is_query_cache_enabled = true;
+  opsqlite_register_authorizer(db, this);
+  sync_update_hook_registration();
+}
+
+// onProgress of loadFile/importFile, posted to the JS thread through the
+// invoker
+std::function<void(const ImportProgress &)>
+OPDatabase::import_progress_callback(jsi::Runtime &rt, jsi::Object &options) {
+  auto js_on_progress = options.getProperty(rt, "onProgress");
+  if (!js_on_progress.isObject() ||
+      !js_on_progress.asObject(rt).isFunction(rt)) {
+    return nullptr;
+  }
+
+  auto callback = std::make_shared<jsi::Value>(rt, js_on_progress);
+  return [callback, alive = alive,
+          invoker = invoker](const ImportProgress &progress) {
+    if (alive != nullptr && !alive->load()) {
+      return;
+    }
+    invoker->invokeAsync([callback, progress](jsi::Runtime &rt) {
+      auto res = jsi::Object(rt);
+      res.setProperty(rt, "rowsAffected", jsi::Value(progress.affectedRows));
+      res.setProperty(rt, "commands", jsi::Value(progress.commands));
+      res.setProperty(rt, "bytesRead",
+                      jsi::Value(static_cast<double>(progress.bytes_read)));
+      res.setProperty(rt, "totalBytes",
+                      jsi::Value(static_cast<double>(progress.total_bytes)));
+      callback->asObject(rt).asFunction(rt).call(rt, res);
+    });
+  };
+}
+
+namespace {
+
+// Built-in functions whose result changes between two runs of the same query
+bool is_non_deterministic(const char *function) {
+  static const char *const functions[] = {
+      "random",       "randomblob",        "changes",
+      "total_changes", "last_insert_rowid", "date",
+      "time",         "datetime",          "julianday",
+      "unixepoch",    "strftime",          "timediff",
+      "current_date", "current_time",      "current_timestamp"};
+
+  for (const char *name : functions) {
+    if (sqlite3_stricmp(function, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+int OPDatabase::on_authorize(int action, const char *arg1, const char *arg2) {
+  auto capture = QueryCache::active_capture();
+  const char *table = arg1;
+  bool follows_drop = is_authorizing_drop;
+  is_authorizing_drop = false;
+
+  switch (action) {
+  case SQLITE_READ:
+    if (capture != nullptr && table != nullptr) {
+      capture->tables.insert(table);
+    }
+    return SQLITE_OK;
+
+  case SQLITE_SELECT:
+  case SQLITE_RECURSIVE:
+    return SQLITE_OK;
+
+  case SQLITE_FUNCTION:
+    if (capture != nullptr && arg2 != nullptr && is_non_deterministic(arg2)) {
+      capture->cacheable = false;
+    }
+    return SQLITE_OK;
+
+  case SQLITE_DELETE:
+    if (capture != nullptr) {
+      capture->cacheable = false;
+    }
+    // The truncate optimization (DELETE without WHERE) skips the update hook
+    // which would leave stale entries behind. SQLITE_IGNORE keeps the delete
+    // but forces it to go row by row. DROP statements check SQLITE_DELETE on
+    // the dropped table (or on sqlite_schema for indexes and triggers) too,
+    // where SQLITE_IGNORE would silently skip them.
+    if (!follows_drop && table != nullptr &&
+        sqlite3_strnicmp(table, "sqlite_", 7) != 0) {
+      return SQLITE_IGNORE;
+    }
+    return SQLITE_OK;
+
+  case SQLITE_INSERT:
+  case SQLITE_UPDATE:
+  case SQLITE_TRANSACTION:
+  case SQLITE_SAVEPOINT:
+  case SQLITE_PRAGMA:
+    if (capture != nullptr) {
+      capture->cacheable = false;
+    }
+    return SQLITE_OK;
+
+  default:
+    // Everything else changes the schema (CREATE, DROP, ALTER, ATTACH...),
+    // which can change what any cached query resolves to
+    is_authorizing_drop =
+        action == SQLITE_DROP_TABLE || action == SQLITE_DROP_TEMP_TABLE ||
+        action == SQLITE_DROP_VIEW || action == SQLITE_DROP_TEMP_VIEW ||
+        action == SQLITE_DROP_VTABLE;
+    if (capture != nullptr) {
+      capture->cacheable = false;
+    }
+    query_cache.clear();
+    return SQLITE_OK;
+  }
+}
+
+void OPDatabase::deserialize(const uint8_t *data, size_t size,
+                             bool read_only) {
+  opsqlite_deserialize(db, data, size, read_only);
+}
+
+// Database image returned by sqlite3_serialize, handed to JS as the backing
+// store of an ArrayBuffer so it is not copied a second time
+class SerializedBuffer : public jsi::MutableBuffer {
+public:
+  SerializedBuffer(unsigned char *data, size_t size)
+      : _data(data), _size(size) {}
+  ~SerializedBuffer() override { sqlite3_free(_data); }
+
+  size_t size() const override { return _size; }
+  uint8_t *data() override { return _data; }
+
+private:
+  unsigned char *_data;
+  size_t _size;
+};
+
+void BackupJob::finish() {
+  std::lock_guard<std::mutex> g(mutex);
+  if (finished) {
+    return;
+  }
+
+  finished = true;
+  opsqlite_backup_finish(backup, dest);
+  backup = nullptr;
+  dest = nullptr;
+}
+
+void OPDatabase::stop_backups() {
+  std::lock_guard<std::mutex> g(backups_mutex);
+  for (const auto &job : backups) {
+    job->cancelled = true;
+    // Waits for a running step, the source connection cannot be closed with
+    // an unfinished backup
+    job->finish();
+  }
+  backups.clear();
+}
+
+namespace {
+std::mutex live_databases_mutex;
+std::set<OPDatabase *> live_databases;
+
+// Without a memory warning for this long the soft heap limit goes back to
+// what it was before the first one
+constexpr auto heap_limit_restore_after = std::chrono::seconds(60);
+
+// Lowers the soft heap limit on memory warnings and puts the configured one
+// back once they stop. Leaked on purpose, like the timeout watchdog, its
+// thread may still be waiting at exit.
+class HeapLimit {
+public:
+  static HeapLimit &instance() {
+    static HeapLimit *heap_limit = new HeapLimit();
+    return *heap_limit;
+  }
+
+  void lower(sqlite3_int64 limit) {
+    {
+      std::lock_guard<std::mutex> g(mutex);
+      sqlite3_int64 current = sqlite3_soft_heap_limit64(-1);
+      // The app changed the limit since it was lowered, that is the one to
+      // restore now
+      if (!lowered || current != lowered_to) {
+        configured = current;
+      }
+      // Never raises a limit the app set itself
+      if (current == 0 || limit < current) {
+        sqlite3_soft_heap_limit64(limit);
+        current = limit;
+      }
+      lowered = true;
+      lowered_to = current;
+      restore_at = std::chrono::steady_clock::now() + heap_limit_restore_after;
+      if (!started) {
+        started = true;
+        std::thread(&HeapLimit::run, this).detach();
+      }
+    }
+    wake.notify_one();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      if (!lowered) {
+        wake.wait(lock);
+        continue;
+      }
+      if (std::chrono::steady_clock::now() < restore_at) {
+        wake.wait_until(lock, restore_at);
+        continue;
+      }
+      // Left alone if the app set a limit of its own in the meantime
+      if (sqlite3_soft_heap_limit64(-1) == lowered_to) {
+        sqlite3_soft_heap_limit64(configured);
+      }
+      lowered = false;
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool started = false;
+  bool lowered = false;
+  sqlite3_int64 configured = 0;
+  sqlite3_int64 lowered_to = 0;
+  std::chrono::steady_clock::time_point restore_at;
+};
+} // namespace
+
+void OPDatabase::track_memory() {
+  std::lock_guard<std::mutex> g(live_databases_mutex);
+  live_databases.insert(this);
+}
+
+// Before the thread pool is drained, so no release queued by
+// on_memory_pressure runs after the connection is closed
+void OPDatabase::untrack_memory() {
+  std::lock_guard<std::mutex> g(live_databases_mutex);
+  live_databases.erase(this);
+}
+
+bool OPDatabase::is_fast_query(const std::string &query) {
+  std::lock_guard<std::mutex> g(fast_queries_mutex);
+  auto it = fast_queries.find(query);
+  return it != fast_queries.end() && it->second.read_only && it->second.cheap;
+}
+
+// Runs on whichever thread just executed query
+void OPDatabase::classify_fast_query(const std::string &query,
+                                     Clock::duration took) {
+  bool cheap = took < std::chrono::microseconds(OP_SQLITE_FAST_PATH_MAX_US);
+
+  {
+    std::lock_guard<std::mutex> g(fast_queries_mutex);
+    auto it = fast_queries.find(query);
+    if (it != fast_queries.end()) {
+      // A write stays a write, a read is reclassified by its latest run
+      it->second.cheap = cheap;
+      return;
+    }
+  }
+
+  // First run, find out whether the statement writes. Uses the connection, so
+  // this only happens on the thread that owns it right now. Execution runs
+  // every statement of the string, anything after the first one (other than
+  // comments) makes it a write. So do transaction statements.
+  bool read_only = false;
+  const char *tail = nullptr;
+  sqlite3_stmt *statement = nullptr;
+  if (!is_transaction_control(query) &&
+      sqlite3_prepare_v2(db, query.c_str(), -1, &statement, &tail) ==
+          SQLITE_OK &&
+      statement != nullptr) {
+    read_only = sqlite3_stmt_readonly(statement);
+    sqlite3_finalize(statement);
+    statement = nullptr;
+
+    if (read_only && sqlite3_prepare_v2(db, tail, -1, &statement, nullptr) ==
+                         SQLITE_OK) {
+      read_only = statement == nullptr;
+    } else {
+      read_only = false;
+    }
+  }
+  sqlite3_finalize(statement);
+
+  std::lock_guard<std::mutex> g(fast_queries_mutex);
+  // Keystroke lookups reuse a handful of statements, generated SQL shouldn't
+  // grow this forever
+  if (fast_queries.size() >= 256) {
+    fast_queries.clear();
+  }
+  fast_queries[query] = {read_only, cheap};
+}
+
+void OPDatabase::on_memory_pressure(bool critical) {
+  // Only known when memory statistics are enabled (SQLITE_DEFAULT_MEMSTATUS),
+  // which is also the only case where SQLite enforces the soft heap limit
+  sqlite3_int64 used = sqlite3_memory_used();
+  if (used > 0) {
+    sqlite3_int64 floor = critical ? 2 * 1024 * 1024 : 4 * 1024 * 1024;
+    HeapLimit::instance().lower(
+        std::max(floor, critical ? used / 2 : used * 3 / 4));
+  }
+
+  // Releasing takes the connection mutex, queueing keeps the platform's
+  // (usually main) thread from waiting on a running query
+  std::lock_guard<std::mutex> g(live_databases_mutex);
+  for (OPDatabase *database : live_databases) {
+    sqlite3 *connection = database->db;
+    database->thread_pool->queue_work(
+        [connection]() {
+          sqlite3_db_release_memory(connection);
+#ifdef OP_SQLITE_USE_POOL_ALLOCATOR
+          // The worker's cached blocks, and the pool shared between threads
+          trim_pool_allocator();
 #endif
+        },
+        Priority::Background);
+  }
+}
+
+// A step that finds the source or destination locked is retried after a
+// pause doubling from the first one, and fails the backup after this many
+// in a row
+constexpr int backup_max_busy_steps = 20;
+constexpr int backup_first_busy_ms = 10;
+constexpr int backup_max_busy_ms = 1000;
+
+// Runs one step of a backup() and schedules the next one at the back of the
+// queue, so queries queued in the meantime run between steps. With sleep_ms,
+// or after a locked step, the next step is only queued once a JS timer fires,
+// leaving the worker free.
+void queue_backup_step(const std::shared_ptr<BackupJob> &job) {
+  job->thread_pool->queue_work([job]() {
+    bool is_done = false;
+    int remaining = 0;
+    int page_count = 0;
+    int delay_ms = job->sleep_ms;
+    std::string error;
+
+    {
+      std::lock_guard<std::mutex> g(job->mutex);
+      try {
+        if (job->finished || job->cancelled) {
+          throw std::runtime_error(
+              "[op-sqlite][backup] Backup cancelled, the database was closed");
+        }
+
+        if (job->backup == nullptr) {
+          job->backup = opsqlite_backup_init(job->source, job->schema,
+                                             job->dest_path, &job->dest);
+        }
+
+        int status =
+            opsqlite_backup_step(job->backup, job->dest, job->pages_per_step);
+        is_done = status == SQLITE_DONE;
+        if (status == SQLITE_BUSY || status == SQLITE_LOCKED) {
+          if (++job->busy_steps > backup_max_busy_steps) {
+            throw std::runtime_error(
+                "[op-sqlite][backup] Database still locked after " +
+                std::to_string(backup_max_busy_steps) + " attempts");
+          }
+          delay_ms = std::max(
+              delay_ms, std::min(backup_max_busy_ms,
+                                 backup_first_busy_ms
+                                     << std::min(job->busy_steps - 1, 16)));
+        } else {
+          job->busy_steps = 0;
+        }
+        remaining = sqlite3_backup_remaining(job->backup);
+        page_count = sqlite3_backup_pagecount(job->backup);
+      } catch (std::exception &exc) {
+        error = exc.what();
+      }
+    }
+
+    if (is_done || !error.empty()) {
+      job->finish();
+    }
+
+    if (job->alive != nullptr && !job->alive->load()) {
+      job->finish();
+      return;
+    }
+
+    if (!is_done && error.empty() && delay_ms <= 0) {
+      queue_backup_step(job);
+    }
+
+    // The JS values are moved out once the promise settles so they are
+    // released on the JS thread
+    job->invoker->invokeAsync([job, is_done, error, remaining, page_count,
+                               delay_ms](jsi::Runtime &rt) {
+      if (!error.empty()) {
+        auto reject = std::move(job->reject);
+        job->resolve = nullptr;
+        job->on_progress = nullptr;
+        auto errorCtr = rt.global().getPropertyAsFunction(rt, "Error");
+        auto js_error = errorCtr.callAsConstructor(
+            rt, jsi::String::createFromUtf8(rt, error));
+        reject->asObject(rt).asFunction(rt).call(rt, js_error);
+        return;
+      }
+
+      if (job->on_progress != nullptr) {
+        auto progress = jsi::Object(rt);
+        progress.setProperty(rt, "remaining", jsi::Value(remaining));
+        progress.setProperty(rt, "pageCount", jsi::Value(page_count));
+        job->on_progress->asObject(rt).asFunction(rt).call(rt, progress);
+      }
+
+      if (is_done) {
+        auto resolve = std::move(job->resolve);
+        job->reject = nullptr;
+        job->on_progress = nullptr;
+        resolve->asObject(rt).asFunction(rt).call(rt, {});
+        return;
+      }
+
+      if (delay_ms > 0) {
+        auto set_timeout = rt.global().getPropertyAsFunction(rt, "setTimeout");
+        set_timeout.call(rt, HFN(job) {
+          queue_backup_step(job);
+          return {};
+        }), jsi::Value(delay_ms));
+      }
+    });
+  });
+}
+#endif
+
+std::function<void()> OPDatabase::interrupter() {
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  // Only called while one of this database's tasks runs, close and delete
+  // wait for those before releasing the connection
+  return [this]() { sqlite3_interrupt(db); };
+#else
+  return nullptr;
+#endif
+}
 
 void OPDatabase::throw_if_closed(const char *function_name) const {
   if (invalidated) {
@@ -183,6 +653,13 @@ void OPDatabase::throw_if_closed(const char *function_name) const {
 }
 
 void OPDatabase::release_hooks() {
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  if (is_query_cache_enabled && db != nullptr) {
+    opsqlite_deregister_authorizer(db);
+  }
+#endif
+  query_cache.clear();
+  is_query_cache_enabled = false;
   reactive_queries.clear();
   pending_reactive_queries.clear();
   update_hook_callback = nullptr;
@@ -191,6 +668,21 @@ void OPDatabase::release_hooks() {
   is_update_hook_registered = false;
 }
 
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+void OPDatabase::start_sync_worker(int interval_ms) {
+  sync_worker = std::make_unique<SyncWorker>(
+      [this](const SyncWorker::Progress &progress) {
+#ifdef OP_SQLITE_USE_LIBSQL
+        progress("sync");
+        opsqlite_libsql_sync(db);
+#else
+        opsqlite_sync(db, progress);
+#endif
+      },
+      interval_ms);
+}
+#endif
+
 //    _____                _                   _
 //   / ____|              | |                 | |
 //  | |     ___  _ __  ___| |_ _ __ _   _  ___| |_ ___  _ __
@@ -204,6 +696,7 @@ OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
     : db_name(url) {
   thread_pool = std::make_shared<ThreadPool>();
   db = opsqlite_libsql_open_remote(url, auth_token);
+  start_sync_worker(0);
 
   create_jsi_functions(rt, js_object);
 }
@@ -222,6 +715,8 @@ OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
   db =
       opsqlite_libsql_open_sync(db_name, path, url, auth_token, sync_interval,
                                 offline, encryption_key, remote_encryption_key);
+  // libsql already syncs every sync_interval on its own
+  start_sync_worker(0);
 
   create_jsi_functions(rt, js_object);
 }
@@ -235,6 +730,7 @@ OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
       delete_db_name(turso_remote_db_name(url)) {
   thread_pool = std::make_shared<ThreadPool>();
   db = opsqlite_open_remote(url, auth_token, base_path);
+  start_sync_worker(0);
 
   create_jsi_functions(rt, js_object);
 }
@@ -243,13 +739,15 @@ OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
 OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
                            std::string &db_name, std::string &path,
                            std::string &url, std::string &auth_token,
-                           std::string &remote_encryption_key)
+                           std::string &remote_encryption_key,
+                           int sync_interval)
     : base_path(path), db_name(db_name), delete_db_name(db_name) {
 
   thread_pool = std::make_shared<ThreadPool>();
 
   db =
       opsqlite_open_sync(db_name, path, url, auth_token, remote_encryption_key);
+  start_sync_worker(sync_interval);
 
   create_jsi_functions(rt, js_object);
 }
@@ -259,23 +757,110 @@ OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
 OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
                            std::string &base_path, std::string &db_name,
                            std::string &path, bool readOnly,
-                           bool failOnCreate, std::string &encryption_key)
+                           bool failOnCreate, std::string &encryption_key,
+                           PragmaList const &pragmas)
     : base_path(base_path), db_name(db_name), delete_db_name(db_name) {
   thread_pool = std::make_shared<ThreadPool>();
+  db = open_connection(db_name, path, readOnly, failOnCreate, encryption_key,
+                       pragmas);
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  track_memory();
+#endif
+  create_jsi_functions(rt, js_object);
+};
 
+OPDatabase::OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
+                           std::string &base_path, std::string &db_name,
+                           DBConnection connection)
+    : base_path(base_path), db_name(db_name), delete_db_name(db_name),
+      db(connection) {
+  thread_pool = std::make_shared<ThreadPool>();
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  track_memory();
+#endif
+  create_jsi_functions(rt, js_object);
+}
+
+DBConnection OPDatabase::open_connection(std::string &db_name,
+                                         std::string &path, bool readOnly,
+                                         bool failOnCreate,
+                                         std::string &encryption_key,
+                                         PragmaList const &pragmas) {
 #ifdef OP_SQLITE_USE_SQLCIPHER
-  db = opsqlite_open(db_name, path, readOnly, failOnCreate, encryption_key);
+  DBConnection connection =
+      opsqlite_open(db_name, path, readOnly, failOnCreate, encryption_key);
 #elif OP_SQLITE_USE_LIBSQL
   if (readOnly) {
     throw std::runtime_error("libsql does not support read-only databases.");
   }
-  db = opsqlite_libsql_open(db_name, path, failOnCreate);
+  DBConnection connection = opsqlite_libsql_open(db_name, path, failOnCreate);
 #else
-  db = opsqlite_open(db_name, path, readOnly, failOnCreate);
+  DBConnection connection =
+      opsqlite_open(db_name, path, readOnly, failOnCreate);
 #endif
-  create_jsi_functions(rt, js_object);
+
+  // Runs after the SQLCipher key is set, pragmas like journal_mode need to
+  // read the database
+  for (auto const &[name, value] : pragmas) {
+    std::string query = "PRAGMA " + name + " = " + value;
+    try {
+#ifdef OP_SQLITE_USE_LIBSQL
+      opsqlite_libsql_execute(connection, query, nullptr);
+#else
+      opsqlite_execute(connection, query, nullptr);
+#endif
+    } catch (std::exception &e) {
+      close_connection(connection);
+      throw std::runtime_error("[op-sqlite][open] Could not apply PRAGMA " +
+                               name + ": " + e.what());
+    }
+  }
+
+  return connection;
+}
+
+void OPDatabase::close_connection(DBConnection &connection) {
+#ifdef OP_SQLITE_USE_LIBSQL
+  opsqlite_libsql_close(connection);
+#else
+  if (connection != nullptr) {
+    opsqlite_close(connection);
+    connection = nullptr;
+  }
+#endif
+}
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+namespace {
+
+// Keeps a JS object alive while a worker reads its memory. Whichever thread
+// drops the last reference, the value itself is released on the JS thread.
+class RetainedValue {
+public:
+  RetainedValue(jsi::Runtime &rt, jsi::Object const &object,
+                std::shared_ptr<react::CallInvoker> invoker,
+                std::shared_ptr<std::atomic<bool>> alive)
+      : value(std::make_shared<jsi::Value>(rt, object)),
+        invoker(std::move(invoker)), alive(std::move(alive)) {}
+
+  ~RetainedValue() {
+    if (alive != nullptr && !alive->load()) {
+      // The runtime is gone, releasing the value would touch freed memory
+      new std::shared_ptr<jsi::Value>(std::move(value));
+      return;
+    }
+    invoker->invokeAsync([value = std::move(value)](jsi::Runtime &) {});
+  }
+
+private:
+  std::shared_ptr<jsi::Value> value;
+  std::shared_ptr<react::CallInvoker> invoker;
+  std::shared_ptr<std::atomic<bool>> alive;
 };
 
+} // namespace
+#endif
+
 void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
                                         jsi::Object &js_object) {
   js_object.setProperty(rt, "attach", HFN(this) {
@@ -343,9 +928,16 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     invalidated = true;
     // Abort pending native SQLite work before waiting on the thread pool.
 #if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+    stop_backups();
+    checkpoint_scheduler = nullptr;
+    untrack_memory();
     if (db != nullptr) {
       sqlite3_interrupt(db);
     }
+#endif
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+    // Waits for a running sync, it uses the connection too
+    sync_worker = nullptr;
 #endif
     // Drain any in-flight async queries before closing the db handle.
     // Without this, a queued/running execute() on the thread pool may
@@ -392,9 +984,16 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     invalidated = true;
     // Abort pending native SQLite work before waiting on the thread pool.
 #if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+    stop_backups();
+    checkpoint_scheduler = nullptr;
+    untrack_memory();
     if (db != nullptr) {
       sqlite3_interrupt(db);
     }
+#endif
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+    // Waits for a running sync, it uses the connection too
+    sync_worker = nullptr;
 #endif
     // Drain any in-flight async queries before closing/removing the db handle.
     // Without this, queued/running work may dereference a freed sqlite handle.
@@ -417,13 +1016,24 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     return {};
   }));
 
+  js_object.setProperty(rt, "getQueueStats", HFN(this) {
+    throw_if_closed("getQueueStats");
+
+    return create_queue_stats(rt, thread_pool->get_stats(), false);
+  }));
+
   js_object.setProperty(rt, "executeRaw", HFN(this) {
     throw_if_closed("executeRaw");
 
     const std::string query = args[0].asString(rt).utf8(rt);
-    const std::vector<JSVariant> params = count == 2 && args[1].isObject()
+    const std::vector<JSVariant> params = count >= 2 && args[1].isObject()
                                               ? to_variant_vec(rt, args[1])
                                               : std::vector<JSVariant>();
+    Priority priority =
+        count > 2 ? to_priority(rt, args[2], "executeRaw") : Priority::Normal;
+    auto token =
+        count > 2 ? to_query_token(rt, args[2], "executeRaw", interrupter())
+                  : nullptr;
 
     return promisify(
         rt, thread_pool,
@@ -443,7 +1053,8 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
               std::move(prev));
 
           return create_raw_result(rt, std::get<0>(tuple), &std::get<1>(tuple));
-        });
+        },
+        priority, token, is_select_statement(query));
   }));
 
   js_object.setProperty(rt, "executeSync", HFN(this) {
@@ -487,9 +1098,14 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     throw_if_closed("execute");
 
     const std::string query = args[0].asString(rt).utf8(rt);
-    std::vector<JSVariant> params = count == 2 && args[1].isObject()
+    std::vector<JSVariant> params = count >= 2 && args[1].isObject()
                                         ? to_variant_vec(rt, args[1])
                                         : std::vector<JSVariant>();
+    Priority priority =
+        count > 2 ? to_priority(rt, args[2], "execute") : Priority::Normal;
+    auto token =
+        count > 2 ? to_query_token(rt, args[2], "execute", interrupter())
+                  : nullptr;
 
     return promisify(
         rt, thread_pool,
@@ -504,6 +1120,43 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
         [](jsi::Runtime &rt, std::any prev) {
           auto status = std::any_cast<BridgeResult>(std::move(prev));
           return create_js_rows(rt, status);
+        },
+        priority, token, is_select_statement(query));
+  }));
+
+  js_object.setProperty(rt, "getSettings", HFN(this) {
+    throw_if_closed("getSettings");
+
+    return promisify(
+        rt, thread_pool,
+        [this]() {
+          std::vector<std::pair<std::string, JSVariant>> settings;
+          for (auto const &name : get_settings_pragmas()) {
+            // Backends that don't know a pragma either fail or return
+            // nothing, it is left out of the result in both cases
+            try {
+#ifdef OP_SQLITE_USE_LIBSQL
+              auto status = opsqlite_libsql_execute(db, "PRAGMA " + name,
+                                                    nullptr);
+#else
+              auto status = opsqlite_execute(db, "PRAGMA " + name, nullptr);
+#endif
+              if (!status.rows.empty() && !status.rows[0].empty()) {
+                settings.emplace_back(name, status.rows[0][0]);
+              }
+            } catch (std::exception &) {
+            }
+          }
+          return settings;
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto settings = std::any_cast<
+              std::vector<std::pair<std::string, JSVariant>>>(std::move(prev));
+          jsi::Object result(rt);
+          for (auto const &[name, value] : settings) {
+            result.setProperty(rt, name.c_str(), to_jsi(rt, value));
+          }
+          return result;
         });
   }));
 
@@ -511,9 +1164,16 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     throw_if_closed("executeWithHostObjects");
 
     const std::string query = args[0].asString(rt).utf8(rt);
-    std::vector<JSVariant> params = count == 2 && args[1].isObject()
+    std::vector<JSVariant> params = count >= 2 && args[1].isObject()
                                         ? to_variant_vec(rt, args[1])
                                         : std::vector<JSVariant>();
+    Priority priority =
+        count > 2 ? to_priority(rt, args[2], "executeWithHostObjects")
+                  : Priority::Normal;
+    auto token = count > 2 ? to_query_token(rt, args[2],
+                                            "executeWithHostObjects",
+                                            interrupter())
+                           : nullptr;
 
     return promisify(
         rt, thread_pool,
@@ -539,7 +1199,8 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
               std::move(std::get<1>(tuple)));
           return create_result(rt, std::get<0>(tuple), results.get(),
                                std::get<2>(tuple));
-        });
+        },
+        priority, token, is_select_statement(query));
   }));
 
   js_object.setProperty(rt, "executeBatch", HFN(this) {
@@ -562,16 +1223,73 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
 
     std::vector<BatchArguments> commands;
     to_batch_arguments(rt, batchParams, &commands);
+    Priority priority = count > 1 ? to_priority(rt, args[1], "executeBatch")
+                                  : Priority::Normal;
+    auto token =
+        count > 1 ? to_query_token(rt, args[1], "executeBatch", interrupter())
+                  : nullptr;
 
     return promisify(
         rt, thread_pool,
-        [this, commands]() {
+        [this, commands, priority, token]() mutable {
+          // A backend reporting an error through message instead of throwing
+          // must not let the batch commit
+          auto execute = [this](const std::vector<BatchArguments> &batch) {
 #ifdef OP_SQLITE_USE_LIBSQL
-          auto batchResult = opsqlite_libsql_execute_batch(db, &commands);
+            auto result = opsqlite_libsql_execute_batch(db, &batch);
 #else
-          auto batchResult = opsqlite_execute_batch(db, &commands);
+            auto result = opsqlite_execute_batch(db, &batch);
 #endif
-          return batchResult;
+            if (!result.message.empty()) {
+              throw std::runtime_error(result.message);
+            }
+            return result;
+          };
+          auto run = [&]() {
+            bool preemptible = priority == Priority::Background;
+            if ((!preemptible && token == nullptr) || commands.size() < 2) {
+              return execute(commands);
+            }
+
+            // One command at a time, letting interactive reads queued in the
+            // meantime run in between. They see the uncommitted batch, like
+            // any query issued before the batch's COMMIT. Writes wait for the
+            // batch, they would join its transaction and roll back with it.
+            // Cancellation is checked at the same points, so batches stop
+            // early even on backends that can't interrupt a statement.
+            BatchResult batchResult{.affectedRows = 0,
+                                    .commands =
+                                        static_cast<int>(commands.size())};
+            std::vector<BatchArguments> command(1);
+            for (auto &next : commands) {
+              command[0] = std::move(next);
+              auto result = execute(command);
+              batchResult.affectedRows += result.affectedRows;
+              if (token != nullptr && token->is_cancelled()) {
+                throw std::runtime_error(token->error());
+              }
+              if (preemptible) {
+                thread_pool->run_interactive(true);
+              }
+            }
+            return batchResult;
+          };
+
+          // The transaction is opened and closed by this task rather than
+          // from JS, so no work queued behind the batch runs while it is open
+          execute({{"BEGIN TRANSACTION"}});
+          try {
+            auto batchResult = run();
+            execute({{"COMMIT"}});
+            return batchResult;
+          } catch (...) {
+            // Interrupted or failed statements may have rolled back already
+            try {
+              execute({{"ROLLBACK"}});
+            } catch (...) {
+            }
+            throw;
+          }
         },
         [](jsi::Runtime &rt, std::any prev) {
           auto batchResult = std::any_cast<BatchResult>(std::move(prev));
@@ -579,21 +1297,98 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
           res.setProperty(rt, "rowsAffected",
                           jsi::Value(batchResult.affectedRows));
           return res;
-        });
+        },
+        priority, token);
   }));
 
 #if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
   js_object.setProperty(rt, "sync", HFN(this) {
     throw_if_closed("sync");
 
+    if (sync_worker == nullptr) {
 #ifdef OP_SQLITE_USE_LIBSQL
-    opsqlite_libsql_sync(db);
+      opsqlite_libsql_sync(db);
 #else
-    opsqlite_sync(db);
+      opsqlite_sync(db);
 #endif
+      return {};
+    }
+
+    // Through the worker and waited for, so it never overlaps a periodic
+    // sync or a syncAsync of the same connection
+    auto done = std::make_shared<std::promise<std::string>>();
+    auto error = done->get_future();
+    sync_worker->request(nullptr, [done](const std::string &error) {
+      done->set_value(error);
+    });
+    auto message = error.get();
+    if (!message.empty()) {
+      throw std::runtime_error(message);
+    }
     return {};
   }));
 
+  js_object.setProperty(rt, "syncAsync", HFN(this) {
+    throw_if_closed("syncAsync");
+    if (sync_worker == nullptr) {
+      throw std::runtime_error("[op-sqlite][syncAsync] Only available for "
+                               "databases opened with openSync or openRemote");
+    }
+
+    std::shared_ptr<jsi::Value> on_progress;
+    if (count > 0 && args[0].isObject()) {
+      auto js_on_progress = args[0].asObject(rt).getProperty(rt, "onProgress");
+      if (js_on_progress.isObject() &&
+          js_on_progress.asObject(rt).isFunction(rt)) {
+        on_progress = std::make_shared<jsi::Value>(rt, js_on_progress);
+      }
+    }
+
+    auto promise_constructor = rt.global().getPropertyAsFunction(rt, "Promise");
+    auto executor = HFN2(this, on_progress) {
+      auto resolve = std::make_shared<jsi::Value>(rt, args[0]);
+      auto reject = std::make_shared<jsi::Value>(rt, args[1]);
+      auto invoker = this->invoker;
+      auto alive = this->alive;
+
+      SyncWorker::Progress progress = nullptr;
+      if (on_progress != nullptr) {
+        progress = [invoker, alive, on_progress](const std::string &phase) {
+          if (alive != nullptr && !alive->load()) {
+            return;
+          }
+          invoker->invokeAsync([on_progress, phase](jsi::Runtime &rt) {
+            on_progress->asObject(rt).asFunction(rt).call(
+                rt, jsi::String::createFromUtf8(rt, phase));
+          });
+        };
+      }
+
+      // resolve and reject are released on the JS thread, inside the
+      // invokeAsync lambda
+      sync_worker->request(
+          std::move(progress),
+          [invoker, alive, resolve, reject](const std::string &error) {
+            if (alive != nullptr && !alive->load()) {
+              return;
+            }
+            invoker->invokeAsync([resolve, reject, error](jsi::Runtime &rt) {
+              if (error.empty()) {
+                resolve->asObject(rt).asFunction(rt).call(rt, {});
+                return;
+              }
+              auto error_ctr = rt.global().getPropertyAsFunction(rt, "Error");
+              reject->asObject(rt).asFunction(rt).call(
+                  rt, error_ctr.callAsConstructor(
+                          rt, jsi::String::createFromUtf8(rt, error)));
+            });
+          });
+      return {};
+    });
+
+    return promise_constructor.callAsConstructor(rt, executor);
+  }));
+
 #ifdef OP_SQLITE_USE_LIBSQL
 
   js_object.setProperty(rt, "setReservedBytes", HFN(this) {
@@ -623,10 +1418,24 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
     }
 
     const std::string sqlFileName = args[0].asString(rt).utf8(rt);
+    int chunk_size = 0;
+    std::function<void(const ImportProgress &)> on_progress;
+
+    if (count > 1 && args[1].isObject()) {
+      auto options = args[1].asObject(rt);
+      auto js_chunk_size = options.getProperty(rt, "chunkSize");
+      if (js_chunk_size.isNumber()) {
+        chunk_size = static_cast<int>(js_chunk_size.asNumber());
+      }
+
+      on_progress = import_progress_callback(rt, options);
+    }
 
     return promisify(
         rt, thread_pool,
-        [this, sqlFileName]() { return import_sql_file(db, sqlFileName); },
+        [this, sqlFileName, chunk_size, on_progress]() {
+          return import_sql_file(db, sqlFileName, chunk_size, on_progress);
+        },
         [](jsi::Runtime &rt, std::any prev) {
           auto result = std::any_cast<BatchResult>(std::move(prev));
           auto res = jsi::Object(rt);
@@ -636,6 +1445,380 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
         });
   }));
 
+  js_object.setProperty(rt, "importFile", HFN(this) {
+    throw_if_closed("importFile");
+
+    if (count < 2 || !args[1].isObject()) {
+      throw std::runtime_error(
+          "[op-sqlite][importFile] Incorrect parameter count");
+    }
+
+    const std::string path = args[0].asString(rt).utf8(rt);
+    auto options = args[1].asObject(rt);
+    DataImportOptions import_options;
+
+    const std::string format =
+        options.getProperty(rt, "format").asString(rt).utf8(rt);
+    if (format == "csv") {
+      import_options.format = DataFileFormat::CSV;
+    } else if (format == "ndjson") {
+      import_options.format = DataFileFormat::NDJSON;
+    } else {
+      throw std::runtime_error("[op-sqlite][importFile] Unknown format " +
+                               format + ", expected csv or ndjson");
+    }
+
+    import_options.table =
+        options.getProperty(rt, "table").asString(rt).utf8(rt);
+
+    auto js_columns = options.getProperty(rt, "columns");
+    if (js_columns.isObject()) {
+      import_options.columns = to_string_vec(rt, js_columns);
+    }
+
+    auto js_header = options.getProperty(rt, "header");
+    if (js_header.isBool()) {
+      import_options.header = js_header.getBool();
+    }
+
+    auto js_delimiter = options.getProperty(rt, "delimiter");
+    if (js_delimiter.isString()) {
+      auto delimiter = js_delimiter.asString(rt).utf8(rt);
+      if (delimiter.size() != 1) {
+        throw std::runtime_error(
+            "[op-sqlite][importFile] delimiter must be a single character");
+      }
+      import_options.delimiter = delimiter[0];
+    }
+
+    auto js_chunk_size = options.getProperty(rt, "chunkSize");
+    if (js_chunk_size.isNumber()) {
+      import_options.chunk_size = static_cast<int>(js_chunk_size.asNumber());
+    }
+
+    auto on_progress = import_progress_callback(rt, options);
+
+    return promisify(
+        rt, thread_pool,
+        [this, path, import_options, on_progress]() {
+          return import_data_file(db, path, import_options, on_progress);
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto result = std::any_cast<BatchResult>(std::move(prev));
+          auto res = jsi::Object(rt);
+          res.setProperty(rt, "rowsAffected", jsi::Value(result.affectedRows));
+          return res;
+        });
+  }));
+
+  js_object.setProperty(rt, "insertVectors", HFN(this) {
+    throw_if_closed("insertVectors");
+
+    if (count < 4) {
+      throw std::runtime_error(
+          "[op-sqlite][insertVectors] Incorrect parameter count");
+    }
+
+    VectorInsertOptions insert_options;
+    insert_options.table = args[0].asString(rt).utf8(rt);
+    insert_options.chunk_size = 10000;
+
+    auto js_dimensions = args[3].isNumber() ? args[3].asNumber() : 0;
+    if (!std::isfinite(js_dimensions) || js_dimensions < 1 ||
+        js_dimensions > INT_MAX ||
+        std::trunc(js_dimensions) != js_dimensions) {
+      throw std::runtime_error(
+          "[op-sqlite][insertVectors] dim must be a positive integer");
+    }
+    insert_options.dimensions = static_cast<size_t>(js_dimensions);
+
+    auto vectors = args[2].isObject() ? args[2].asObject(rt) : jsi::Object(rt);
+    if (!vectors.instanceOf(
+            rt, rt.global().getPropertyAsFunction(rt, "Float32Array"))) {
+      throw std::runtime_error(
+          "[op-sqlite][insertVectors] vectors must be a Float32Array");
+    }
+
+    auto buffer = vectors.getPropertyAsObject(rt, "buffer");
+    size_t length;
+    const uint8_t *data = typed_array_data(
+        rt, vectors, sizeof(float), length, "[op-sqlite][insertVectors] vectors");
+    if (length % insert_options.dimensions != 0) {
+      throw std::runtime_error("[op-sqlite][insertVectors] vectors has " +
+                               std::to_string(length) +
+                               " floats, not a multiple of dim " +
+                               std::to_string(insert_options.dimensions));
+    }
+    insert_options.rows = length / insert_options.dimensions;
+    // Float32Array offsets are always a multiple of 4
+    insert_options.vectors = reinterpret_cast<const float *>(data);
+
+    if (!args[1].isNull() && !args[1].isUndefined()) {
+      insert_options.ids = to_row_ids(rt, args[1]);
+      if (insert_options.ids.size() != insert_options.rows) {
+        throw std::runtime_error(
+            "[op-sqlite][insertVectors] " +
+            std::to_string(insert_options.ids.size()) + " ids for " +
+            std::to_string(insert_options.rows) + " vectors");
+      }
+    }
+
+    std::function<void(const ImportProgress &)> on_progress;
+    if (count > 4 && args[4].isObject()) {
+      auto options = args[4].asObject(rt);
+
+      auto js_column = options.getProperty(rt, "column");
+      if (js_column.isString()) {
+        insert_options.column = js_column.asString(rt).utf8(rt);
+      }
+
+      auto js_chunk_size = options.getProperty(rt, "chunkSize");
+      if (js_chunk_size.isNumber()) {
+        // 0 is a single transaction
+        double chunk_size = js_chunk_size.asNumber();
+        if (!std::isfinite(chunk_size) || chunk_size < 0 ||
+            std::trunc(chunk_size) != chunk_size) {
+          throw std::runtime_error("[op-sqlite][insertVectors] chunkSize must "
+                                   "be a positive integer or 0");
+        }
+        insert_options.chunk_size =
+            static_cast<int>(std::min(chunk_size, static_cast<double>(INT_MAX)));
+      }
+
+      on_progress = import_progress_callback(rt, options);
+    }
+
+    // The worker binds straight from the typed array's memory, the buffer
+    // has to outlive the insert
+    auto retained =
+        std::make_shared<RetainedValue>(rt, buffer, invoker, alive);
+
+    return promisify(
+        rt, thread_pool,
+        [this, insert_options, on_progress, retained]() {
+          return insert_vectors(db, insert_options, on_progress);
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto result = std::any_cast<BatchResult>(std::move(prev));
+          auto res = jsi::Object(rt);
+          res.setProperty(rt, "rowsAffected", jsi::Value(result.affectedRows));
+          return res;
+        });
+  }));
+
+  js_object.setProperty(rt, "backup", HFN(this) {
+    throw_if_closed("backup");
+
+    if (count < 1) {
+      throw std::runtime_error("[op-sqlite][backup] Incorrect parameter count");
+    }
+
+    auto job = std::make_shared<BackupJob>();
+    job->source = db;
+    job->dest_path = args[0].asString(rt).utf8(rt);
+    job->schema = "main";
+    job->pages_per_step = 100;
+    job->sleep_ms = 0;
+    job->thread_pool = thread_pool;
+    job->invoker = invoker;
+    job->alive = alive;
+
+    if (count > 1 && args[1].isObject()) {
+      auto options = args[1].asObject(rt);
+
+      auto js_schema = options.getProperty(rt, "schema");
+      if (js_schema.isString()) {
+        job->schema = js_schema.asString(rt).utf8(rt);
+      }
+
+      // -1 copies everything in one step, above INT_MAX it is the same
+      auto js_pages_per_step = options.getProperty(rt, "pagesPerStep");
+      if (js_pages_per_step.isNumber()) {
+        double pages = js_pages_per_step.asNumber();
+        if (pages != -1 && !(pages >= 1)) {
+          throw std::runtime_error(
+              "[op-sqlite][backup] pagesPerStep must be at least 1, or -1");
+        }
+        job->pages_per_step = static_cast<int>(
+            std::min(pages, static_cast<double>(INT_MAX)));
+      }
+
+      auto js_sleep_ms = options.getProperty(rt, "sleepMs");
+      if (js_sleep_ms.isNumber()) {
+        double sleep_ms = js_sleep_ms.asNumber();
+        if (!(sleep_ms >= 0)) {
+          throw std::runtime_error(
+              "[op-sqlite][backup] sleepMs must be 0 or more");
+        }
+        job->sleep_ms = static_cast<int>(
+            std::min(sleep_ms, static_cast<double>(INT_MAX)));
+      }
+
+      auto js_on_progress = options.getProperty(rt, "onProgress");
+      if (js_on_progress.isObject() &&
+          js_on_progress.asObject(rt).isFunction(rt)) {
+        job->on_progress = std::make_shared<jsi::Value>(rt, js_on_progress);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> g(backups_mutex);
+      backups.erase(std::remove_if(backups.begin(), backups.end(),
+                                   [](const std::shared_ptr<BackupJob> &b) {
+                                     std::lock_guard<std::mutex> g(b->mutex);
+                                     return b->finished;
+                                   }),
+                    backups.end());
+      backups.push_back(job);
+    }
+
+    auto promise_constructor = rt.global().getPropertyAsFunction(rt, "Promise");
+    auto executor = HFN(job) {
+      job->resolve = std::make_shared<jsi::Value>(rt, args[0]);
+      job->reject = std::make_shared<jsi::Value>(rt, args[1]);
+      queue_backup_step(job);
+      return {};
+    });
+
+    return promise_constructor.callAsConstructor(rt, executor);
+  }));
+
+  js_object.setProperty(rt, "startCheckpointScheduler", HFN(this) {
+    throw_if_closed("startCheckpointScheduler");
+
+    long long wal_size_limit = 64 * 1024 * 1024;
+    int idle_ms = 1000;
+
+    if (count > 0 && args[0].isObject()) {
+      auto options = args[0].asObject(rt);
+      if (options.hasProperty(rt, "walSizeLimit")) {
+        wal_size_limit = static_cast<long long>(
+            options.getProperty(rt, "walSizeLimit").asNumber());
+      }
+      if (options.hasProperty(rt, "idleMs")) {
+        idle_ms =
+            static_cast<int>(options.getProperty(rt, "idleMs").asNumber());
+      }
+    }
+
+    if (wal_size_limit <= 0 || idle_ms < 0) {
+      throw std::runtime_error("[op-sqlite][startCheckpointScheduler] "
+                               "walSizeLimit must be positive and idleMs "
+                               "can't be negative");
+    }
+
+    // Only one per connection, restarting picks up the new options
+    checkpoint_scheduler = nullptr;
+    checkpoint_scheduler = std::make_unique<CheckpointScheduler>(
+        db, thread_pool, wal_size_limit, idle_ms);
+
+    return {};
+  }));
+
+  js_object.setProperty(rt, "stopCheckpointScheduler", HFN(this) {
+    throw_if_closed("stopCheckpointScheduler");
+    checkpoint_scheduler = nullptr;
+    return {};
+  }));
+
+  js_object.setProperty(rt, "getCheckpointStats", HFN(this) {
+    throw_if_closed("getCheckpointStats");
+
+    CheckpointStats stats;
+    if (checkpoint_scheduler != nullptr) {
+      stats = checkpoint_scheduler->stats();
+    }
+
+    jsi::Object result(rt);
+    result.setProperty(rt, "running", checkpoint_scheduler != nullptr);
+    result.setProperty(rt, "checkpoints", stats.checkpoints);
+    result.setProperty(rt, "truncates", stats.truncates);
+    result.setProperty(rt, "busy", stats.busy);
+    result.setProperty(rt, "walFrames", stats.wal_frames);
+    result.setProperty(rt, "checkpointedFrames", stats.checkpointed_frames);
+    result.setProperty(rt, "lastDurationMs", stats.last_duration_ms);
+    return result;
+  }));
+
+  js_object.setProperty(rt, "getMemoryUsage", HFN(this) {
+    throw_if_closed("getMemoryUsage");
+
+    return promisify(
+        rt, thread_pool,
+        [this]() {
+          auto status = [this](int op) {
+            int current = 0;
+            int highwater = 0;
+            sqlite3_db_status(db, op, &current, &highwater, 0);
+            return current;
+          };
+          // The lookaside hit and miss counters only have a high-water mark
+          auto count = [this](int op) {
+            int current = 0;
+            int highwater = 0;
+            sqlite3_db_status(db, op, &current, &highwater, 0);
+            return highwater;
+          };
+
+          return std::vector<std::pair<std::string, int>>{
+              {"cacheUsed", status(SQLITE_DBSTATUS_CACHE_USED)},
+              {"schemaUsed", status(SQLITE_DBSTATUS_SCHEMA_USED)},
+              {"statementsUsed", status(SQLITE_DBSTATUS_STMT_USED)},
+              {"cacheHits", status(SQLITE_DBSTATUS_CACHE_HIT)},
+              {"cacheMisses", status(SQLITE_DBSTATUS_CACHE_MISS)},
+              {"cacheSpills", status(SQLITE_DBSTATUS_CACHE_SPILL)},
+              {"lookasideUsed", status(SQLITE_DBSTATUS_LOOKASIDE_USED)},
+              {"lookasideHits", count(SQLITE_DBSTATUS_LOOKASIDE_HIT)},
+              {"lookasideMisses",
+               count(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE) +
+                   count(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL)}};
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto usage = std::any_cast<std::vector<std::pair<std::string, int>>>(
+              std::move(prev));
+          jsi::Object result(rt);
+          for (auto const &[name, value] : usage) {
+            result.setProperty(rt, name.c_str(), value);
+          }
+          return result;
+        });
+  }));
+
+  js_object.setProperty(rt, "releaseMemory", HFN(this) {
+    throw_if_closed("releaseMemory");
+
+    return promisify(
+        rt, thread_pool,
+        [this]() {
+          sqlite3_db_release_memory(db);
+          return nullptr;
+        },
+        [](jsi::Runtime &rt, std::any prev) { return jsi::Value::undefined(); });
+  }));
+
+  js_object.setProperty(rt, "serialize", HFN(this) {
+    throw_if_closed("serialize");
+
+    std::string schema = "main";
+    if (count > 0 && args[0].isString()) {
+      schema = args[0].asString(rt).utf8(rt);
+    }
+
+    return promisify(
+        rt, thread_pool,
+        [this, schema]() {
+          sqlite3_int64 size = 0;
+          unsigned char *data = opsqlite_serialize(db, schema, &size);
+          return std::make_shared<SerializedBuffer>(data,
+                                                    static_cast<size_t>(size));
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto buffer =
+              std::any_cast<std::shared_ptr<SerializedBuffer>>(std::move(prev));
+          return jsi::ArrayBuffer(rt, std::move(buffer));
+        });
+  }));
+
   js_object.setProperty(rt, "updateHook", HFN(this) {
     throw_if_closed("updateHook");
 
@@ -764,6 +1947,127 @@ void OPDatabase::create_jsi_functions(jsi::Runtime &rt,
 
     return unsubscribe;
   }));
+
+  js_object.setProperty(rt, "executeCached", HFN(this) {
+    throw_if_closed("executeCached");
+
+    const std::string query = args[0].asString(rt).utf8(rt);
+    std::vector<JSVariant> params = count >= 2 && args[1].isObject()
+                                        ? to_variant_vec(rt, args[1])
+                                        : std::vector<JSVariant>();
+    Priority priority = count > 2 ? to_priority(rt, args[2], "executeCached")
+                                  : Priority::Normal;
+    auto token =
+        count > 2 ? to_query_token(rt, args[2], "executeCached", interrupter())
+                  : nullptr;
+
+    enable_query_cache();
+    auto key = QueryCache::make_key(query, params);
+
+    // Only answer from the cache when nothing is queued ahead of this call,
+    // otherwise a write issued earlier might not have landed yet
+    if (thread_pool->is_idle() && token == nullptr) {
+      auto cached = query_cache.get(key);
+      if (cached != nullptr) {
+        auto promise_ctr = rt.global().getPropertyAsFunction(rt, "Promise");
+        auto resolve = promise_ctr.getPropertyAsFunction(rt, "resolve");
+        return resolve.callWithThis(rt, promise_ctr,
+                                    create_js_rows(rt, *cached));
+      }
+    }
+
+    return promisify(
+        rt, thread_pool,
+        [this, query, params, key]() {
+          QueryCacheCapture capture;
+          auto epoch = query_cache.epoch();
+
+          QueryCache::begin_capture(&capture);
+          BridgeResult status;
+          try {
+            status = opsqlite_execute(db, query, &params);
+          } catch (...) {
+            QueryCache::end_capture();
+            throw;
+          }
+          QueryCache::end_capture();
+
+          // Inside a transaction the result might contain uncommitted data.
+          // Writes to WITHOUT ROWID and virtual tables never reach the update
+          // hook, their results would never be invalidated.
+          if (capture.cacheable && sqlite3_get_autocommit(db) != 0 &&
+              std::all_of(capture.tables.begin(), capture.tables.end(),
+                          [this](const std::string &table) {
+                            return opsqlite_fires_update_hook(db, table);
+                          })) {
+            query_cache.put(key, status, std::move(capture.tables), epoch);
+          }
+
+          return status;
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto status = std::any_cast<BridgeResult>(std::move(prev));
+          return create_js_rows(rt, status);
+        },
+        priority, token, is_select_statement(query));
+  }));
+
+  js_object.setProperty(rt, "executeFast", HFN(this) {
+    throw_if_closed("executeFast");
+
+    const std::string query = args[0].asString(rt).utf8(rt);
+    std::vector<JSVariant> params = count >= 2 && args[1].isObject()
+                                        ? to_variant_vec(rt, args[1])
+                                        : std::vector<JSVariant>();
+
+    // A cheap read with nothing queued ahead of it runs right here, no
+    // promise, task or result boxing. The pool is held while it runs so no
+    // worker touches the connection at the same time.
+    if (is_fast_query(query)) {
+      BridgeResult status;
+      std::string error;
+      auto started = Clock::now();
+      bool ran = thread_pool->run_if_idle([&]() {
+        try {
+          status = opsqlite_execute(db, query, &params);
+        } catch (std::exception &e) {
+          error = e.what();
+        }
+      });
+
+      if (ran) {
+        classify_fast_query(query, Clock::now() - started);
+        if (!error.empty()) {
+          auto promise_ctr = rt.global().getPropertyAsFunction(rt, "Promise");
+          auto reject = promise_ctr.getPropertyAsFunction(rt, "reject");
+          auto error_ctr = rt.global().getPropertyAsFunction(rt, "Error");
+          return reject.callWithThis(
+              rt, promise_ctr,
+              error_ctr.callAsConstructor(
+                  rt, jsi::String::createFromUtf8(rt, error)));
+        }
+        return create_js_rows(rt, status);
+      }
+    }
+
+    return promisify(
+        rt, thread_pool,
+        [this, query, params]() {
+          auto started = Clock::now();
+          auto status = opsqlite_execute(db, query, &params);
+          classify_fast_query(query, Clock::now() - started);
+          return status;
+        },
+        [](jsi::Runtime &rt, std::any prev) {
+          auto status = std::any_cast<BridgeResult>(std::move(prev));
+          return create_js_rows(rt, status);
+        });
+  }));
+
+  js_object.setProperty(rt, "clearQueryCache", HFN(this) {
+    query_cache.clear();
+    return {};
+  }));
 #endif
 
   js_object.setProperty(rt, "prepareStatement", HFN(this) {
@@ -839,23 +2143,23 @@ void OPDatabase::invalidate() {
   // Native's module invalidation budget, after which the runtime is destroyed
   // anyway and the drain has bought nothing.
 #if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  stop_backups();
+  checkpoint_scheduler = nullptr;
+  untrack_memory();
   if (db != nullptr) {
     sqlite3_interrupt(db);
   }
 #endif
 
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+  // Waits for a running sync, it uses the connection too
+  sync_worker = nullptr;
+#endif
   // Drain in-flight thread pool work before closing the db handle.
   thread_pool->wait_finished();
   release_hooks();
 
-#ifdef OP_SQLITE_USE_LIBSQL
-  opsqlite_libsql_close(db);
-#else
-  if (db != nullptr) {
-    opsqlite_close(db);
-    db = nullptr;
-  }
-#endif
+  close_connection(db);
 }
 
 OPDatabase::~OPDatabase() { invalidate(); }
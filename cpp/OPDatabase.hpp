@@ -1,5 +1,8 @@
 #pragma once
 
+#include "OPCheckpointScheduler.hpp"
+#include "OPQueryCache.hpp"
+#include "OPSyncWorker.hpp"
 #include "OPThreadPool.hpp"
 #include "OPTypes.hpp"
 #include <ReactCommon/CallInvoker.h>
@@ -15,6 +18,8 @@
 #endif
 #endif
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace opsqlite {
@@ -41,6 +46,42 @@ struct ReactiveQuery {
   std::shared_ptr<jsi::Value> callback;
 };
 
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+// State of a running backup(). Every step is queued separately on the
+// database's thread pool, so the job carries everything a step needs instead
+// of pointing back at the OPDatabase.
+struct BackupJob {
+  // Held while a step runs, finish() from close() waits on it
+  std::mutex mutex;
+  sqlite3_backup *backup = nullptr;
+  sqlite3 *dest = nullptr;
+  bool finished = false;
+  std::atomic<bool> cancelled{false};
+  sqlite3 *source;
+  std::string schema;
+  std::string dest_path;
+  int pages_per_step;
+  int sleep_ms;
+  // SQLITE_BUSY/SQLITE_LOCKED steps in a row, see queue_backup_step
+  int busy_steps = 0;
+  std::shared_ptr<ThreadPool> thread_pool;
+  std::shared_ptr<react::CallInvoker> invoker;
+  std::shared_ptr<std::atomic<bool>> alive;
+  std::shared_ptr<jsi::Value> resolve;
+  std::shared_ptr<jsi::Value> reject;
+  std::shared_ptr<jsi::Value> on_progress;
+
+  // Releases the backup and the destination, safe to call more than once
+  void finish();
+};
+#endif
+
+#ifdef OP_SQLITE_USE_LIBSQL
+using DBConnection = DB;
+#else
+using DBConnection = sqlite3 *;
+#endif
+
 class JSI_EXPORT OPDatabase
     : public jsi::NativeState,
       public std::enable_shared_from_this<OPDatabase> {
@@ -49,7 +90,22 @@ public:
   OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
                std::string &base_path, std::string &db_name,
                std::string &path, bool readOnly, bool failOnCreate,
-               std::string &encryption_key);
+               std::string &encryption_key, PragmaList const &pragmas);
+
+  // Adopts a connection returned by open_connection, used by openAsync which
+  // opens it on a background thread
+  OPDatabase(jsi::Runtime &rt, jsi::Object &js_object,
+               std::string &base_path, std::string &db_name,
+               DBConnection connection);
+
+  // Opens the local connection used by the normal constructor and applies
+  // pragmas (open({ profile })) before returning it. Does not touch the JS
+  // runtime, so it is safe to call from any thread
+  static DBConnection open_connection(std::string &db_name, std::string &path,
+                                      bool readOnly, bool failOnCreate,
+                                      std::string &encryption_key,
+                                      PragmaList const &pragmas);
+  static void close_connection(DBConnection &connection);
 
 #ifdef OP_SQLITE_USE_LIBSQL
   // Constructor for remoteOpen, purely for remote databases
@@ -66,24 +122,40 @@ public:
   OPDatabase(jsi::Runtime &rt, jsi::Object &js_object, std::string &url,
                std::string &auth_token, std::string &base_path);
 
-  // Constructor for a local database with remote sync
+  // Constructor for a local database with remote sync, every sync_interval
+  // ms when above 0
   OPDatabase(jsi::Runtime &rt, jsi::Object &js_object, std::string &db_name,
                std::string &path, std::string &url, std::string &auth_token,
-               std::string &remote_encryption_key);
+               std::string &remote_encryption_key, int sync_interval);
 #endif
 
   void on_update(const std::string &table, const std::string &operation,
                  long long row_id);
   void on_commit();
   void on_rollback();
+  int on_authorize(int action, const char *arg1, const char *arg2);
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  // Used by open({ fromBuffer }), right after the connection is created
+  void deserialize(const uint8_t *data, size_t size, bool read_only);
+  // Platform memory warnings. Every open database releases its unused cache
+  // pages on its own thread, and the soft heap limit is lowered until a
+  // minute passes without another warning
+  static void on_memory_pressure(bool critical);
+#endif
   void invalidate();
   ~OPDatabase() override;
 
 private:
   std::set<std::shared_ptr<ReactiveQuery>> pending_reactive_queries;
   void sync_update_hook_registration();
+  void enable_query_cache();
+  std::function<void(const ImportProgress &)>
+  import_progress_callback(jsi::Runtime &rt, jsi::Object &options);
   void release_hooks();
   void throw_if_closed(const char *function_name) const;
+  // Stops the statement running on this connection, for QueryToken. Empty on
+  // backends without sqlite3_interrupt.
+  std::function<void()> interrupter();
   void create_jsi_functions(jsi::Runtime &rt, jsi::Object &js_object);
   void flush_pending_reactive_queries(const std::shared_ptr<jsi::Value> &resolve);
 
@@ -109,12 +181,43 @@ private:
   std::vector<std::shared_ptr<ReactiveQuery>> reactive_queries;
   std::vector<PendingReactiveInvocation> pending_reactive_invocations;
   bool is_update_hook_registered = false;
-  bool invalidated = false;
-#ifdef OP_SQLITE_USE_LIBSQL
-  DB db;
-#else
-  sqlite3 *db;
+  // Opt-in, enabled by the first executeCached call. Keeps the update hook
+  // and the authorizer registered so entries can be invalidated.
+  QueryCache query_cache;
+  bool is_query_cache_enabled = false;
+  // Set by a SQLITE_DROP_* authorization, the SQLITE_DELETE check SQLite does
+  // right after it belongs to the DROP. Only touched while SQLite prepares a
+  // statement, under the connection mutex.
+  bool is_authorizing_drop = false;
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  // Backups still running, stopped before the connection is closed
+  std::mutex backups_mutex;
+  std::vector<std::shared_ptr<BackupJob>> backups;
+  void stop_backups();
+  // Set by startCheckpointScheduler, reset before the connection is closed
+  std::unique_ptr<CheckpointScheduler> checkpoint_scheduler;
+  // Membership in the list on_memory_pressure walks
+  void track_memory();
+  void untrack_memory();
+  // executeFast: statements seen so far. Only single read only statements
+  // that ran within OP_SQLITE_FAST_PATH_MAX_US the last time are inlined.
+  struct FastQuery {
+    bool read_only;
+    bool cheap;
+  };
+  std::mutex fast_queries_mutex;
+  std::unordered_map<std::string, FastQuery> fast_queries;
+  bool is_fast_query(const std::string &query);
+  void classify_fast_query(const std::string &query, Clock::duration took);
 #endif
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+  // syncAsync, only for databases with a remote. Reset before the connection
+  // is closed.
+  std::unique_ptr<SyncWorker> sync_worker;
+  void start_sync_worker(int interval_ms);
+#endif
+  bool invalidated = false;
+  DBConnection db;
 };
 
 } // namespace opsqlite
@@ -0,0 +1,144 @@
+#include "OPQueryCache.hpp"
+#include <cstring>
+#include <variant>
+
+namespace opsqlite {
+
+namespace {
+thread_local QueryCacheCapture *current_capture = nullptr;
+}
+
+QueryCache::QueryCache(size_t capacity) : capacity(capacity) {}
+
+std::string QueryCache::make_key(const std::string &query,
+                                 const std::vector<JSVariant> &params) {
+  std::string key = query;
+  key.reserve(query.size() + params.size() * 16);
+
+  // Every param is prefixed with a type tag so "1" and 1 never collide, and
+  // variable length values carry their size so concatenations can't collide
+  // either.
+  for (const auto &param : params) {
+    key.push_back('\0');
+    std::visit(
+        [&](auto &&v) {
+          using T = std::decay_t<decltype(v)>;
+
+          if constexpr (std::is_same_v<T, bool>) {
+            key.push_back('b');
+            key.push_back(v ? '1' : '0');
+          } else if constexpr (std::is_same_v<T, int> ||
+                               std::is_same_v<T, long> ||
+                               std::is_same_v<T, long long>) {
+            key.push_back('i');
+            key += std::to_string(v);
+          } else if constexpr (std::is_same_v<T, double>) {
+            key.push_back('d');
+            char bytes[sizeof(double)];
+            memcpy(bytes, &v, sizeof(double));
+            key.append(bytes, sizeof(double));
+          } else if constexpr (std::is_same_v<T, std::string>) {
+            key.push_back('s');
+            key += std::to_string(v.size());
+            key.push_back(':');
+            key += v;
+          } else if constexpr (std::is_same_v<T, ArrayBuffer>) {
+            key.push_back('x');
+            key += std::to_string(v.size);
+            key.push_back(':');
+            key.append(reinterpret_cast<const char *>(v.data.get()), v.size);
+          } else {
+            key.push_back('n');
+          }
+        },
+        param);
+  }
+
+  return key;
+}
+
+std::shared_ptr<const BridgeResult> QueryCache::get(const std::string &key) {
+  std::lock_guard<std::mutex> g(mutex);
+
+  auto it = index.find(key);
+  if (it == index.end()) {
+    return nullptr;
+  }
+
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->result;
+}
+
+void QueryCache::put(const std::string &key, BridgeResult result,
+                     std::set<std::string> tables, uint64_t epoch) {
+  std::lock_guard<std::mutex> g(mutex);
+
+  if (epoch != _epoch.load() || capacity == 0) {
+    return;
+  }
+
+  auto existing = index.find(key);
+  if (existing != index.end()) {
+    entries.erase(existing->second);
+    index.erase(existing);
+  }
+
+  entries.push_front(
+      Entry{key, std::make_shared<const BridgeResult>(std::move(result)),
+            std::move(tables)});
+  index[key] = entries.begin();
+
+  while (entries.size() > capacity) {
+    index.erase(entries.back().key);
+    entries.pop_back();
+  }
+}
+
+void QueryCache::invalidate_table(const std::string &table) {
+  std::lock_guard<std::mutex> g(mutex);
+  _epoch++;
+
+  for (auto it = entries.begin(); it != entries.end();) {
+    bool reads_table = false;
+    for (const auto &read_table : it->tables) {
+      // Writes to a virtual table (e.g. FTS5) only reach the update hook
+      // through its shadow tables, which are named "<table>_<suffix>"
+      if (table == read_table ||
+          (table.size() > read_table.size() &&
+           table.compare(0, read_table.size(), read_table) == 0 &&
+           table[read_table.size()] == '_')) {
+        reads_table = true;
+        break;
+      }
+    }
+
+    if (reads_table) {
+      index.erase(it->key);
+      it = entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void QueryCache::clear() {
+  std::lock_guard<std::mutex> g(mutex);
+  _epoch++;
+  entries.clear();
+  index.clear();
+}
+
+bool QueryCache::empty() {
+  std::lock_guard<std::mutex> g(mutex);
+  return entries.empty();
+}
+
+void QueryCache::begin_capture(QueryCacheCapture *capture) {
+  current_capture = capture;
+}
+
+void QueryCache::end_capture() { current_capture = nullptr; }
+
+QueryCacheCapture *QueryCache::active_capture() { return current_capture; }
+
+} // namespace opsqlite
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "OPTypes.hpp"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opsqlite {
+
+// Tables touched while a cacheable query is being prepared. Filled by the
+// authorizer (see OPDatabase::on_authorize) on the thread that started the
+// capture, so concurrent prepares on other threads are never attributed to
+// the wrong query.
+struct QueryCacheCapture {
+  std::set<std::string> tables;
+  bool cacheable = true;
+};
+
+// Read-only query results keyed by SQL + bound params. Entries are dropped
+// when one of the tables they read changes (update hook) or when the schema
+// changes (authorizer). Everything here is pure C++, the JSI side lives in
+// OPDatabase.
+class QueryCache {
+public:
+  explicit QueryCache(size_t capacity = 128);
+
+  static std::string make_key(const std::string &query,
+                              const std::vector<JSVariant> &params);
+
+  std::shared_ptr<const BridgeResult> get(const std::string &key);
+
+  // Epoch is read before the query runs. If anything was invalidated while
+  // the query was in flight the result might already be stale, so it is
+  // silently dropped instead of stored.
+  void put(const std::string &key, BridgeResult result,
+           std::set<std::string> tables, uint64_t epoch);
+
+  void invalidate_table(const std::string &table);
+  void clear();
+
+  uint64_t epoch() const { return _epoch.load(); }
+  bool empty();
+
+  static void begin_capture(QueryCacheCapture *capture);
+  static void end_capture();
+  static QueryCacheCapture *active_capture();
+
+private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const BridgeResult> result;
+    std::set<std::string> tables;
+  };
+
+  size_t capacity;
+  std::mutex mutex;
+  // Most recently used entries at the front
+  std::list<Entry> entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  std::atomic<uint64_t> _epoch{0};
+};
+
+} // namespace opsqlite
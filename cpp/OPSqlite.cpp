@@ -1,4 +1,5 @@
 #include "OPSqlite.hpp"
+#include "OPAllocator.hpp"
 #include "OPDatabase.hpp"
 #include "OPDumbHostObject.hpp"
 #include "OPThreadPool.hpp"
@@ -10,6 +11,8 @@
 #include "OPLogs.h"
 #include "OPMacros.hpp"
 #include "OPUtils.hpp"
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <string>
@@ -25,6 +28,152 @@ std::string _base_path;
 std::string _sqlite_vec_path;
 std::shared_ptr<react::CallInvoker> invoker;
 std::shared_ptr<std::atomic<bool>> generation_alive;
+// Runs the blocking part of openAsync, shared by every runtime generation
+std::shared_ptr<ThreadPool> open_thread_pool;
+
+// Options shared by open and openAsync
+struct LocalOpenOptions {
+  std::string name;
+  std::string path;
+  std::string encryption_key;
+  bool read_only = false;
+  bool fail_on_create = false;
+  bool from_buffer = false;
+  PragmaList pragmas;
+};
+
+// Connection opened by openAsync. Closed again if it never reaches an
+// OPDatabase, e.g. when the runtime is torn down before the promise resolves
+struct PendingConnection {
+#ifdef OP_SQLITE_USE_LIBSQL
+  DBConnection connection{};
+#else
+  DBConnection connection = nullptr;
+#endif
+  bool adopted = false;
+
+  ~PendingConnection() {
+    if (!adopted) {
+      OPDatabase::close_connection(connection);
+    }
+  }
+};
+
+// open({ profile }) is either the name of a preset or an object of pragma
+// names to values
+static PragmaList parse_profile(jsi::Runtime &rt, jsi::Value const &profile,
+                                bool read_only) {
+  if (profile.isUndefined() || profile.isNull()) {
+    return {};
+  }
+
+#ifdef OP_SQLITE_USE_TURSO
+  throw std::runtime_error(
+      "[op-sqlite][open] profile is not supported with Turso");
+#endif
+
+  if (profile.isString()) {
+    return get_pragma_profile(profile.asString(rt).utf8(rt), read_only);
+  }
+
+  if (!profile.isObject()) {
+    throw std::runtime_error(
+        "[op-sqlite][open] profile must be a preset name or an object");
+  }
+
+  PragmaList pragmas;
+  auto object = profile.asObject(rt);
+  auto names = object.getPropertyNames(rt);
+  for (size_t i = 0; i < names.size(rt); i++) {
+    std::string name = names.getValueAtIndex(rt, i).asString(rt).utf8(rt);
+    jsi::Value value = object.getProperty(rt, name.c_str());
+
+    std::string text;
+    if (value.isNumber()) {
+      double number = value.asNumber();
+      text = number == static_cast<double>(static_cast<long long>(number))
+                 ? std::to_string(static_cast<long long>(number))
+                 : std::to_string(number);
+    } else if (value.isString()) {
+      text = value.asString(rt).utf8(rt);
+    } else if (value.isBool()) {
+      text = value.getBool() ? "1" : "0";
+    } else {
+      throw std::runtime_error("[op-sqlite][open] Invalid value for pragma " +
+                               name);
+    }
+
+    validate_pragma(name, text);
+    pragmas.emplace_back(std::move(name), std::move(text));
+  }
+
+  return pragmas;
+}
+
+static LocalOpenOptions parse_open_options(jsi::Runtime &rt,
+                                           jsi::Object &options) {
+  LocalOpenOptions params;
+  params.name = options.getProperty(rt, "name").asString(rt).utf8(rt);
+  params.path = std::string(_base_path);
+  std::string location;
+
+  if (options.hasProperty(rt, "location")) {
+    location = options.getProperty(rt, "location").asString(rt).utf8(rt);
+  }
+
+  if (options.hasProperty(rt, "encryptionKey")) {
+    params.encryption_key =
+        options.getProperty(rt, "encryptionKey").asString(rt).utf8(rt);
+  }
+
+  if (options.hasProperty(rt, "readOnly")) {
+    params.read_only = options.getProperty(rt, "readOnly").asBool();
+  }
+
+  if (options.hasProperty(rt, "failOnCreate")) {
+    params.fail_on_create = options.getProperty(rt, "failOnCreate").asBool();
+  }
+
+  if (!location.empty()) {
+    if (location == ":memory:") {
+      params.path = ":memory:";
+    } else if (location.rfind('/', 0) == 0) {
+      params.path = location;
+    } else {
+      params.path = params.path + "/" + location;
+    }
+  }
+
+  if (options.hasProperty(rt, "profile")) {
+    params.pragmas = parse_profile(rt, options.getProperty(rt, "profile"),
+                                   params.read_only);
+  }
+
+  // The image replaces main, so there is no file to open underneath it
+  params.from_buffer = options.hasProperty(rt, "fromBuffer") &&
+                       options.getProperty(rt, "fromBuffer").isObject();
+  if (params.from_buffer) {
+#if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
+    throw std::runtime_error(
+        "[op-sqlite][open] fromBuffer is only supported with SQLite");
+#endif
+    params.path = ":memory:";
+  }
+
+  return params;
+}
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+static jsi::ArrayBuffer get_from_buffer(jsi::Runtime &rt,
+                                        jsi::Object &options) {
+  auto buffer = options.getProperty(rt, "fromBuffer").asObject(rt);
+  if (!buffer.isArrayBuffer(rt)) {
+    throw std::runtime_error(
+        "[op-sqlite][open] fromBuffer must be an ArrayBuffer");
+  }
+  return buffer.getArrayBuffer(rt);
+}
+#endif
 
 // Each platform module calls its own invalidate() lifecycle hook when React
 // Native tears down the JS context (CodePush/Hot Reload, or any other
@@ -59,47 +208,85 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
   auto local_generation_alive = std::make_shared<std::atomic<bool>>(true);
   opsqlite::generation_alive = local_generation_alive;
 
-  auto open = HFN0 {
-    jsi::Object options = args[0].asObject(rt);
-    std::string name = options.getProperty(rt, "name").asString(rt).utf8(rt);
-    std::string path = std::string(_base_path);
-    std::string location;
-    std::string encryption_key;
-    bool readOnly = false;
-    bool failOnCreate = false;
+  if (open_thread_pool == nullptr) {
+    open_thread_pool = std::make_shared<ThreadPool>();
+  }
 
-    if (options.hasProperty(rt, "location")) {
-      location = options.getProperty(rt, "location").asString(rt).utf8(rt);
-    }
+#ifdef OP_SQLITE_USE_POOL_ALLOCATOR
+  // Only possible before SQLite initializes, i.e. before the first open
+  install_pool_allocator();
+#endif
 
-    if (options.hasProperty(rt, "encryptionKey")) {
-      encryption_key =
-          options.getProperty(rt, "encryptionKey").asString(rt).utf8(rt);
-    }
+  auto open = HFN0 {
+    jsi::Object options = args[0].asObject(rt);
+    LocalOpenOptions params = parse_open_options(rt, options);
 
-    if (options.hasProperty(rt, "readOnly")) {
-      readOnly = options.getProperty(rt, "readOnly").asBool();
+    jsi::Object js_db(rt);
+    std::shared_ptr<OPDatabase> db = std::make_shared<OPDatabase>(
+        rt, js_db, params.path, params.name, params.path, params.read_only,
+        params.fail_on_create, params.encryption_key, params.pragmas);
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+    if (params.from_buffer) {
+      auto array_buffer = get_from_buffer(rt, options);
+      db->deserialize(array_buffer.data(rt), array_buffer.size(rt),
+                      params.read_only);
     }
+#endif
 
-    if (options.hasProperty(rt, "failOnCreate")) {
-      failOnCreate = options.getProperty(rt, "failOnCreate").asBool();
-    }
+    js_db.setNativeState(rt, db);
+    return js_db;
+  });
 
-    if (!location.empty()) {
-      if (location == ":memory:") {
-        path = ":memory:";
-      } else if (location.rfind('/', 0) == 0) {
-        path = location;
-      } else {
-        path = path + "/" + location;
-      }
+  // Same as open, but sqlite3_open_v2, the SQLCipher key derivation and
+  // loading extensions happen on open_thread_pool instead of blocking the JS
+  // thread. The OPDatabase itself is created once the promise resolves.
+  auto open_async = HFN0 {
+    jsi::Object options = args[0].asObject(rt);
+    LocalOpenOptions params = parse_open_options(rt, options);
+
+    // The ArrayBuffer can only be read on the JS thread
+    std::shared_ptr<std::vector<uint8_t>> image;
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+    if (params.from_buffer) {
+      auto array_buffer = get_from_buffer(rt, options);
+      image = std::make_shared<std::vector<uint8_t>>(
+          array_buffer.data(rt), array_buffer.data(rt) + array_buffer.size(rt));
     }
+#endif
 
-    jsi::Object js_db(rt);
-    std::shared_ptr<OPDatabase> db = std::make_shared<OPDatabase>(
-        rt, js_db, path, name, path, readOnly, failOnCreate, encryption_key);
-    js_db.setNativeState(rt, db);
-    return js_db;
+    return promisify(
+        rt, open_thread_pool,
+        [params, image]() mutable {
+          auto pending = std::make_shared<PendingConnection>();
+          pending->connection = OPDatabase::open_connection(
+              params.name, params.path, params.read_only,
+              params.fail_on_create, params.encryption_key, params.pragmas);
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+          if (image != nullptr) {
+            opsqlite_deserialize(pending->connection, image->data(),
+                                 image->size(), params.read_only);
+          } else {
+            opsqlite_read_schema(pending->connection);
+          }
+#else
+          (void)image;
+#endif
+          return pending;
+        },
+        [params](jsi::Runtime &rt, std::any result) mutable {
+          auto pending =
+              std::any_cast<std::shared_ptr<PendingConnection>>(result);
+
+          jsi::Object js_db(rt);
+          std::shared_ptr<OPDatabase> db = std::make_shared<OPDatabase>(
+              rt, js_db, params.path, params.name, pending->connection);
+          pending->adopted = true;
+
+          js_db.setNativeState(rt, db);
+          return jsi::Value(std::move(js_db));
+        });
   });
 
   auto is_sqlcipher = HFN(=) {
@@ -134,6 +321,57 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
 #endif
   });
 
+  auto get_allocator_stats = HFN(=) {
+#ifdef OP_SQLITE_USE_POOL_ALLOCATOR
+    if (!is_pool_allocator_installed()) {
+      return jsi::Value::null();
+    }
+
+    AllocatorStats stats = get_pool_allocator_stats();
+    jsi::Object result(rt);
+    result.setProperty(rt, "allocations",
+                       static_cast<double>(stats.allocations));
+    result.setProperty(rt, "frees", static_cast<double>(stats.frees));
+    result.setProperty(rt, "threadCacheHits",
+                       static_cast<double>(stats.thread_cache_hits));
+    result.setProperty(rt, "sharedPoolHits",
+                       static_cast<double>(stats.shared_pool_hits));
+    result.setProperty(rt, "systemAllocations",
+                       static_cast<double>(stats.system_allocations));
+    result.setProperty(rt, "largeAllocations",
+                       static_cast<double>(stats.large_allocations));
+    result.setProperty(rt, "bytesInUse",
+                       static_cast<double>(stats.bytes_in_use));
+    result.setProperty(rt, "bytesCached",
+                       static_cast<double>(stats.bytes_cached));
+    return jsi::Value(std::move(result));
+#else
+    return jsi::Value::null();
+#endif
+  });
+
+  auto set_worker_threads_fn = HFN(=) {
+    // !(>= 1) also rejects NaN
+    double threads = count > 0 && args[0].isNumber() ? args[0].asNumber() : 0;
+    if (!(threads >= 1) || !std::isfinite(threads) ||
+        std::trunc(threads) != threads) {
+      throw std::runtime_error("[op-sqlite][setWorkerThreads] count must be "
+                               "an integer of at least 1");
+    }
+
+    set_worker_threads(static_cast<unsigned int>(std::min(
+        threads, static_cast<double>(OP_SQLITE_MAX_WORKER_THREADS))));
+    return {};
+  });
+
+  auto get_worker_threads_fn = HFN(=) {
+    return static_cast<double>(get_worker_threads());
+  });
+
+  auto get_worker_stats_fn = HFN(=) {
+    return create_queue_stats(rt, get_worker_stats(), true);
+  });
+
 #if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
   auto open_remote = HFN(=) {
     jsi::Object options = args[0].asObject(rt);
@@ -208,11 +446,11 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
       rt, js_db, name, path, url, auth_token, sync_interval, offline,
       encryption_key, remote_encryption_key);
   #else
-    (void)sync_interval;
     (void)offline;
 
     std::shared_ptr<OPDatabase> db = std::make_shared<OPDatabase>(
-      rt, js_db, name, path, url, auth_token, remote_encryption_key);
+      rt, js_db, name, path, url, auth_token, remote_encryption_key,
+      sync_interval);
   #endif
 
     js_db.setNativeState(rt, db);
@@ -222,10 +460,15 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
 
   jsi::Object module = jsi::Object(rt);
   module.setProperty(rt, "open", std::move(open));
+  module.setProperty(rt, "openAsync", std::move(open_async));
   module.setProperty(rt, "isSQLCipher", std::move(is_sqlcipher));
   module.setProperty(rt, "isLibsql", std::move(is_libsql));
   module.setProperty(rt, "isTurso", std::move(is_turso));
   module.setProperty(rt, "isIOSEmbedded", std::move(is_ios_embedded));
+  module.setProperty(rt, "getAllocatorStats", std::move(get_allocator_stats));
+  module.setProperty(rt, "setWorkerThreads", std::move(set_worker_threads_fn));
+  module.setProperty(rt, "getWorkerThreads", std::move(get_worker_threads_fn));
+  module.setProperty(rt, "getWorkerStats", std::move(get_worker_stats_fn));
 #if defined(OP_SQLITE_USE_LIBSQL) || defined(OP_SQLITE_USE_TURSO)
   module.setProperty(rt, "openRemote", std::move(open_remote));
   module.setProperty(rt, "openSync", std::move(open_sync));
@@ -236,6 +479,15 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
   return local_generation_alive;
 }
 
+void on_memory_pressure(bool critical) {
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+  OPDatabase::on_memory_pressure(critical);
+#else
+  // libsql and Turso don't expose their page caches
+  (void)critical;
+#endif
+}
+
 void expoUpdatesWorkaround(const char *base_path) {
 #ifdef OP_SQLITE_USE_LIBSQL
   std::string path = std::string(base_path);
@@ -20,5 +20,8 @@ install(jsi::Runtime &rt, const std::shared_ptr<react::CallInvoker> &invoker,
         const char *base_path, const char *sqlite_vec_path);
 void invalidate(const std::shared_ptr<std::atomic<bool>> &generation_alive);
 void expoUpdatesWorkaround(const char *base_path);
+// Called by the platform modules on memory warnings (didReceiveMemoryWarning
+// on iOS, onTrimMemory/onLowMemory on Android). Safe from any thread.
+void on_memory_pressure(bool critical);
 
 } // namespace opsqlite
@@ -0,0 +1,81 @@
+#include "OPSyncWorker.hpp"
+#include <exception>
+
+namespace opsqlite {
+
+SyncWorker::SyncWorker(SyncFunction sync, int interval_ms)
+    : sync(std::move(sync)),
+      interval(std::chrono::milliseconds(interval_ms > 0 ? interval_ms : 0)) {
+  thread = std::thread(&SyncWorker::run, this);
+}
+
+SyncWorker::~SyncWorker() {
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  for (auto &request : pending) {
+    request.on_done("[op-sqlite][syncAsync] Sync cancelled, the database was "
+                    "closed");
+  }
+}
+
+void SyncWorker::request(Progress on_progress, Callback on_done) {
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    pending.push_back({std::move(on_progress), std::move(on_done)});
+  }
+  wake.notify_all();
+}
+
+void SyncWorker::run() {
+  auto next_periodic = std::chrono::steady_clock::now() + interval;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (pending.empty()) {
+      if (interval.count() == 0) {
+        wake.wait(lock);
+        continue;
+      }
+      if (wake.wait_until(lock, next_periodic) != std::cv_status::timeout ||
+          stopping || !pending.empty()) {
+        continue;
+      }
+    }
+
+    // Everything requested up to here is served by this one sync
+    std::vector<Request> batch;
+    batch.swap(pending);
+    lock.unlock();
+
+    std::string error;
+    try {
+      sync([&batch](const std::string &phase) {
+        for (auto &request : batch) {
+          if (request.on_progress) {
+            request.on_progress(phase);
+          }
+        }
+      });
+    } catch (std::exception &e) {
+      error = e.what();
+    }
+
+    for (auto &request : batch) {
+      request.on_done(error);
+    }
+    batch.clear();
+
+    next_periodic = std::chrono::steady_clock::now() + interval;
+    lock.lock();
+  }
+}
+
+} // namespace opsqlite
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace opsqlite {
+
+// Runs the remote syncs of one database on a thread of its own, so neither
+// the JS thread nor the query workers wait for the network. A sync requested
+// while another one runs is not started alongside it: every request made in
+// the meantime shares the single sync that follows.
+class SyncWorker {
+public:
+  // Called on the sync thread as each phase of a sync starts
+  using Progress = std::function<void(const std::string &phase)>;
+  // Empty error on success
+  using Callback = std::function<void(const std::string &error)>;
+  using SyncFunction = std::function<void(const Progress &progress)>;
+
+  // interval_ms > 0 also syncs that long after the previous sync ended,
+  // errors of those syncs are dropped
+  SyncWorker(SyncFunction sync, int interval_ms);
+  // Waits for the running sync, requests still waiting get an error
+  ~SyncWorker();
+
+  void request(Progress on_progress, Callback on_done);
+
+private:
+  struct Request {
+    Progress on_progress;
+    Callback on_done;
+  };
+
+  void run();
+
+  SyncFunction sync;
+  std::chrono::milliseconds interval;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Request> pending;
+  bool stopping = false;
+  std::thread thread;
+};
+
+} // namespace opsqlite
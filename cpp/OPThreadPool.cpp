@@ -1,108 +1,486 @@
 #include "OPThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <deque>
 
 namespace opsqlite {
 
-ThreadPool::ThreadPool() : done(false) {
-  // This returns the number of threads supported by the system. If the
-  // function can't figure out this information, it returns 0. 0 is not good,
-  // so we create at least 1
-  //  auto number_of_threads = std::thread::hardware_concurrency();
-  //  if (number_of_threads == 0) {
-  //    number_of_threads = 1;
-  //  }
-
-  // To keep sqlite threading model working, we cannot access via multiple
-  // threads in the same process therefore we cap the number of off-threads
-  // to one per connection
-  //
-  // You can achieve more performance when using more threads but you run
-  // into race conditions. This request was brought forth by PowerSync.
-  auto number_of_threads = 1;
-  for (unsigned i = 0; i < number_of_threads; ++i) {
-    // The threads will execute the private member `do_work`. Note that we
-    // need to pass a reference to the function (namespaced with the class
-    // name) as the first argument, and the current object as second
-    // argument
-    threads.emplace_back(&ThreadPool::do_work, this);
+// Background work waits at most this many normal tasks
+constexpr unsigned int background_share = 4;
+
+// Recent queue waits kept for the percentiles
+constexpr size_t wait_samples = 512;
+
+struct Work {
+  std::function<void(void)> task;
+  std::function<void(void)> on_expired;
+  Clock::time_point queued_at;
+  Clock::time_point deadline;
+  bool read_only;
+};
+
+// Counters behind QueueStats. Not synchronized, the owner locks around it.
+class QueueMetrics {
+public:
+  void record_wait(Clock::duration wait) {
+    waits[wait_count % wait_samples] = wait;
+    wait_count++;
+    completed++;
+  }
+
+  void record_expired() { expired++; }
+
+  void record_busy(Clock::duration time) { busy += time; }
+
+  void fill(QueueStats &stats) const {
+    stats.completed = completed;
+    stats.expired = expired;
+    stats.busy_ms = to_ms(busy);
+
+    size_t count = std::min(wait_count, wait_samples);
+    if (count == 0) {
+      return;
+    }
+
+    std::vector<Clock::duration> sorted(waits.begin(), waits.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](size_t p) {
+      return to_ms(sorted[std::min(count - 1, count * p / 100)]);
+    };
+    stats.wait_p50_ms = percentile(50);
+    stats.wait_p95_ms = percentile(95);
+    stats.wait_p99_ms = percentile(99);
+    stats.wait_max_ms = to_ms(sorted.back());
+  }
+
+private:
+  static double to_ms(Clock::duration time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+  }
+
+  std::array<Clock::duration, wait_samples> waits{};
+  size_t wait_count = 0;
+  long long completed = 0;
+  long long expired = 0;
+  Clock::duration busy{};
+};
+
+namespace {
+
+// All strands together, see get_worker_stats()
+std::mutex total_mutex;
+QueueMetrics total_metrics;
+std::atomic<long long> total_queued{0};
+
+} // namespace
+
+struct Strand {
+  std::mutex mutex;
+  // Signalled whenever a task finishes, wait_finished() and the destructor
+  // wait on it
+  std::condition_variable changed;
+
+  // Requests waiting to be processed, one queue per Priority
+  std::queue<Work> work_queues[3];
+  QueueMetrics metrics;
+
+  // Normal tasks run in a row while background work was waiting
+  unsigned int normal_streak{};
+
+  // Handed to the executor, either waiting for a worker or running
+  bool scheduled = false;
+  // A task is running, on runner
+  bool running = false;
+  std::thread::id runner;
+  // The ThreadPool is gone, whatever is left must not run
+  bool done = false;
+
+  // All of these expect mutex to be held
+  bool has_work() const;
+  std::queue<Work> &next_lane();
+  // Pops the first task of lane, or its on_expired when it is past its
+  // deadline. Null when expired without an on_expired.
+  std::function<void(void)> take(std::queue<Work> &lane);
+};
+
+bool Strand::has_work() const {
+  for (auto const &lane : work_queues) {
+    if (!lane.empty()) {
+      return true;
+    }
   }
+  return false;
 }
 
-// The destructor joins all the threads so the process (or in our RN case, this
-// main-thread/runtime generation) can exit gracefully. This will be executed if
-// there is any exception (e.g. creating the threads)
-ThreadPool::~ThreadPool() {
-  // So threads know it's time to shut down
-  done = true;
+std::queue<Work> &Strand::next_lane() {
+  auto &interactive = work_queues[static_cast<int>(Priority::Interactive)];
+  auto &normal = work_queues[static_cast<int>(Priority::Normal)];
+  auto &background = work_queues[static_cast<int>(Priority::Background)];
+
+  std::queue<Work> *lane = &background;
+  if (!interactive.empty()) {
+    lane = &interactive;
+  } else if (!normal.empty()) {
+    if (background.empty() || normal_streak < background_share) {
+      lane = &normal;
+    }
+  }
+
+  if (lane == &normal && !background.empty()) {
+    normal_streak++;
+  } else if (lane != &interactive) {
+    normal_streak = 0;
+  }
+
+  return *lane;
+}
 
-  // Wake up all the threads, so they can finish and be joined
-  work_pending.notify_all();
+std::function<void(void)> Strand::take(std::queue<Work> &lane) {
+  Work work = std::move(lane.front());
+  lane.pop();
+  total_queued--;
 
-  for (auto &thread : threads) {
-    if (thread.joinable()) {
-      thread.join();
+  auto now = Clock::now();
+  bool expired = now > work.deadline;
+  std::lock_guard<std::mutex> g(total_mutex);
+  if (expired) {
+    metrics.record_expired();
+    total_metrics.record_expired();
+    return std::move(work.on_expired);
+  }
+  metrics.record_wait(now - work.queued_at);
+  total_metrics.record_wait(now - work.queued_at);
+  return std::move(work.task);
+}
+
+namespace {
+
+// Worker threads shared by every strand. A strand with work sits in the ready
+// queue once, runs a single task and goes back to the end of the queue if it
+// has more, so one busy database can't hold up the others for longer than a
+// task. Threads are only started while every existing one is busy. Leaked on
+// purpose, like the threads it detaches, so nothing has to be joined at exit.
+class Executor {
+public:
+  static Executor &instance() {
+    static Executor *executor = new Executor();
+    return *executor;
+  }
+
+  void schedule(std::shared_ptr<Strand> strand) {
+    {
+      std::lock_guard<std::mutex> g(mutex);
+      ready.push_back(std::move(strand));
+      if (ready.size() > idle_threads && thread_count < max_threads) {
+        thread_count++;
+        std::thread(&Executor::do_work, this).detach();
+      }
+    }
+    work_pending.notify_one();
+  }
+
+  void set_max_threads(unsigned int count) {
+    {
+      std::lock_guard<std::mutex> g(mutex);
+      max_threads = std::clamp(count, 1u,
+                               static_cast<unsigned>(OP_SQLITE_MAX_WORKER_THREADS));
+      // Start what the queued work can use right away
+      while (thread_count < max_threads && ready.size() > idle_threads) {
+        thread_count++;
+        std::thread(&Executor::do_work, this).detach();
+      }
+    }
+    work_pending.notify_all();
+  }
+
+  unsigned int get_max_threads() {
+    std::lock_guard<std::mutex> g(mutex);
+    return max_threads;
+  }
+
+  void fill(QueueStats &stats) {
+    std::lock_guard<std::mutex> g(mutex);
+    stats.threads = thread_count;
+    stats.busy_threads = busy_threads;
+    stats.waiting_databases = static_cast<long long>(ready.size());
+  }
+
+private:
+  void do_work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      idle_threads++;
+      work_pending.wait(lock, [&] {
+        return !ready.empty() || thread_count > max_threads;
+      });
+      idle_threads--;
+
+      if (thread_count > max_threads) {
+        thread_count--;
+        return;
+      }
+
+      auto strand = std::move(ready.front());
+      ready.pop_front();
+      busy_threads++;
+      lock.unlock();
+
+      run_next(strand);
+      strand = nullptr;
+
+      lock.lock();
+      busy_threads--;
     }
   }
 
-  threads.clear();
+  void run_next(const std::shared_ptr<Strand> &strand) {
+    std::function<void(void)> task;
+    {
+      std::lock_guard<std::mutex> g(strand->mutex);
+      // wait_finished() took the strand over, it runs what is left itself
+      if (strand->done || strand->running || !strand->has_work()) {
+        strand->scheduled = false;
+        strand->changed.notify_all();
+        return;
+      }
+      task = strand->take(strand->next_lane());
+      strand->running = true;
+      strand->runner = std::this_thread::get_id();
+    }
+
+    auto started = Clock::now();
+    if (task) {
+      task();
+    }
+
+    // Release the task (and everything it captured, e.g. JSI values) before
+    // signalling idle, so wait_finished()/close() can't observe an idle
+    // strand while task-owned resources are still pending destruction.
+    task = nullptr;
+
+    auto busy = Clock::now() - started;
+    {
+      std::lock_guard<std::mutex> g(total_mutex);
+      total_metrics.record_busy(busy);
+    }
+
+    bool more;
+    {
+      std::lock_guard<std::mutex> g(strand->mutex);
+      strand->metrics.record_busy(busy);
+      strand->running = false;
+      more = !strand->done && strand->has_work();
+      if (!more) {
+        strand->scheduled = false;
+      }
+    }
+    strand->changed.notify_all();
+
+    if (more) {
+      schedule(strand);
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable work_pending;
+  std::deque<std::shared_ptr<Strand>> ready;
+  unsigned int max_threads = std::max(1, OP_SQLITE_WORKER_THREADS);
+  unsigned int thread_count = 0;
+  unsigned int idle_threads = 0;
+  unsigned int busy_threads = 0;
+};
+
+} // namespace
+
+ThreadPool::ThreadPool() : strand(std::make_shared<Strand>()) {}
+
+// Queued work is dropped here, on the calling thread, so whatever it captured
+// is released where the pool was. The strand itself may stay in the
+// executor's queue a little longer, empty.
+ThreadPool::~ThreadPool() {
+  std::queue<Work> dropped[3];
+  {
+    std::unique_lock<std::mutex> g(strand->mutex);
+    strand->done = true;
+    for (int i = 0; i < 3; i++) {
+      total_queued -= static_cast<long long>(strand->work_queues[i].size());
+      std::swap(dropped[i], strand->work_queues[i]);
+    }
+
+    // Unless the pool is released by its own task
+    strand->changed.wait(g, [&] {
+      return !strand->running ||
+             strand->runner == std::this_thread::get_id();
+    });
+  }
 }
 
 // This function will be called by the server every time there is a request
 // that needs to be processed by the thread pool
-void ThreadPool::queue_work(const std::function<void(void)> &task) {
-  // Grab the mutex
-  std::lock_guard<std::mutex> g(work_queue_mutex);
+void ThreadPool::queue_work(const std::function<void(void)> &task,
+                            Priority priority, Clock::time_point deadline,
+                            const std::function<void(void)> &on_expired,
+                            bool read_only) {
+  bool schedule;
+  {
+    std::lock_guard<std::mutex> g(strand->mutex);
 
-  // Push the request to the queue
-  work_queue.push(task);
+    // Push the request to the queue of its lane
+    strand->work_queues[static_cast<int>(priority)].push(
+        {task, on_expired, Clock::now(), deadline, read_only});
+    total_queued++;
+
+    // A scheduled strand picks the task up itself when its turn comes
+    schedule = !strand->scheduled;
+    strand->scheduled = true;
+  }
 
-  // Wake every waiter. wait_finished() and do_work() share this condition
-  // so we force all conditions to check
-  work_pending.notify_all();
+  if (schedule) {
+    Executor::instance().schedule(strand);
+  }
 }
 
-// Function used by the threads to grab work from the queue
-void ThreadPool::do_work() {
-  // Loop while the queue is not destructing
-  while (!done) {
+void ThreadPool::run_interactive(bool only_reads) {
+  auto &lane = strand->work_queues[static_cast<int>(Priority::Interactive)];
+
+  while (true) {
     std::function<void(void)> task;
+    {
+      std::lock_guard<std::mutex> g(strand->mutex);
+      // A write would stop at the first one, keeping the lane's order
+      if (strand->done || lane.empty() ||
+          (only_reads && !lane.front().read_only)) {
+        return;
+      }
+      task = strand->take(lane);
+    }
 
-    // Create a scope, so we don't lock the queue for longer than necessary
+    // The calling task already counts as running, and as busy
+    if (task) {
+      task();
+    }
+    task = nullptr;
+    strand->changed.notify_all();
+  }
+}
+
+bool ThreadPool::run_if_idle(const std::function<void(void)> &task) {
+  {
+    std::lock_guard<std::mutex> g(strand->mutex);
+    // Not scheduled means nothing queued and nothing running
+    if (strand->done || strand->scheduled) {
+      return false;
+    }
+    // Work queued meanwhile waits for this task, it is scheduled below
+    strand->scheduled = true;
+    strand->running = true;
+    strand->runner = std::this_thread::get_id();
+  }
+
+  auto started = Clock::now();
+  auto finish = [&]() {
+    auto busy = Clock::now() - started;
     {
-      std::unique_lock<std::mutex> g(work_queue_mutex);
-      work_pending.wait(g, [&] {
-        // Only wake up if there are elements in the queue or the
-        // program is shutting down
-        return done || !work_queue.empty();
-      });
+      std::lock_guard<std::mutex> g(total_mutex);
+      total_metrics.record_wait(Clock::duration::zero());
+      total_metrics.record_busy(busy);
+    }
 
-      // If we are shutting down exit without trying to process more work
-      if (done) {
-        break;
+    bool more;
+    {
+      std::lock_guard<std::mutex> g(strand->mutex);
+      strand->metrics.record_wait(Clock::duration::zero());
+      strand->metrics.record_busy(busy);
+      strand->running = false;
+      more = !strand->done && strand->has_work();
+      if (!more) {
+        strand->scheduled = false;
       }
+    }
+    strand->changed.notify_all();
 
-      task = work_queue.front();
-      work_queue.pop();
-      ++busy;
+    if (more) {
+      Executor::instance().schedule(strand);
     }
+  };
 
+  try {
     task();
+  } catch (...) {
+    finish();
+    throw;
+  }
+  finish();
+  return true;
+}
 
-    // Release the task (and everything it captured, e.g. JSI values) before
-    // signalling idle, so wait_finished()/close() can't observe busy == 0
-    // while task-owned resources are still pending destruction.
-    task = nullptr;
+void ThreadPool::wait_finished() {
+  std::unique_lock<std::mutex> g(strand->mutex);
+  while (true) {
+    strand->changed.wait(g, [&] { return !strand->running; });
+    if (strand->done || !strand->has_work()) {
+      return;
+    }
+
+    // Queued work runs here instead of waiting for a worker, they may all be
+    // busy with other databases
+    auto task = strand->take(strand->next_lane());
+    strand->running = true;
+    strand->runner = std::this_thread::get_id();
+    g.unlock();
 
+    auto started = Clock::now();
+    if (task) {
+      task();
+    }
+    task = nullptr;
+    auto busy = Clock::now() - started;
     {
-      std::lock_guard<std::mutex> g(work_queue_mutex);
-      --busy;
+      std::lock_guard<std::mutex> total(total_mutex);
+      total_metrics.record_busy(busy);
     }
-    work_pending.notify_all();
+
+    g.lock();
+    strand->metrics.record_busy(busy);
+    strand->running = false;
+    strand->changed.notify_all();
   }
 }
 
-void ThreadPool::wait_finished() {
-  std::unique_lock<std::mutex> g(work_queue_mutex);
-  work_pending.wait(g, [&] { return work_queue.empty() && (busy == 0); });
+bool ThreadPool::is_idle() {
+  std::lock_guard<std::mutex> g(strand->mutex);
+  return !strand->has_work() && !strand->running;
+}
+
+QueueStats ThreadPool::get_stats() {
+  QueueStats stats;
+  std::lock_guard<std::mutex> g(strand->mutex);
+  for (auto const &lane : strand->work_queues) {
+    stats.queued += static_cast<long long>(lane.size());
+  }
+  stats.running = strand->running ? 1 : 0;
+  strand->metrics.fill(stats);
+  return stats;
+}
+
+void set_worker_threads(unsigned int count) {
+  Executor::instance().set_max_threads(count);
+}
+
+unsigned int get_worker_threads() {
+  return Executor::instance().get_max_threads();
+}
+
+QueueStats get_worker_stats() {
+  QueueStats stats;
+  {
+    std::lock_guard<std::mutex> g(total_mutex);
+    total_metrics.fill(stats);
+  }
+  stats.queued = total_queued;
+  Executor::instance().fill(stats);
+  stats.running = stats.busy_threads;
+  return stats;
 }
 
 } // namespace opsqlite
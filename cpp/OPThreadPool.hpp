@@ -1,46 +1,110 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <exception>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <stdio.h>
 #include <thread>
 #include <vector>
 
+// Worker threads shared by every database until setWorkerThreads changes it.
+// Can be overridden through sqliteFlags.
+#ifndef OP_SQLITE_WORKER_THREADS
+#define OP_SQLITE_WORKER_THREADS 2
+#endif
+
+// Upper bound of setWorkerThreads. Each database only ever uses one thread at
+// a time, more than this just adds threads waiting on the same disk.
+#ifndef OP_SQLITE_MAX_WORKER_THREADS
+#define OP_SQLITE_MAX_WORKER_THREADS 16
+#endif
+
 namespace opsqlite {
 
+// Lanes of a ThreadPool. Interactive work always goes first, background work
+// gets one turn for every few normal tasks so it can't starve. Order is only
+// kept within a lane.
+enum class Priority { Interactive = 0, Normal = 1, Background = 2 };
+
+using Clock = std::chrono::steady_clock;
+
+// Snapshot of the queue of one ThreadPool, or of all of them together
+struct QueueStats {
+  // Tasks waiting to run
+  long long queued = 0;
+  // Tasks running right now
+  long long running = 0;
+  long long completed = 0;
+  // Tasks rejected without running because they waited past their deadline
+  long long expired = 0;
+  // Time the last few hundred tasks waited in the queue before running
+  double wait_p50_ms = 0;
+  double wait_p95_ms = 0;
+  double wait_p99_ms = 0;
+  double wait_max_ms = 0;
+  // Time spent running tasks
+  double busy_ms = 0;
+
+  // Process wide only. Worker threads started and running a task, and
+  // databases with work waiting for a free thread.
+  long long threads = 0;
+  long long busy_threads = 0;
+  long long waiting_databases = 0;
+};
+
+struct Strand;
+
+// Serial queue of one database. It owns no thread: its tasks run one at a
+// time, in order, on the worker threads shared by the whole process, so a
+// connection is still only ever used by one thread at a time while an app
+// with many databases doesn't pay a thread for each of them.
 class ThreadPool {
 public:
   ThreadPool();
+  // Drops the work still queued and waits for the running task
   ~ThreadPool();
-  void queue_work(const std::function<void(void)> &task);
+  // A task still queued at its deadline doesn't run, on_expired runs in its
+  // place (on the worker) so whoever waits for it can be told. read_only
+  // tasks may run inside another task's transaction, see run_interactive.
+  void queue_work(const std::function<void(void)> &task,
+                  Priority priority = Priority::Normal,
+                  Clock::time_point deadline = Clock::time_point::max(),
+                  const std::function<void(void)> &on_expired = nullptr,
+                  bool read_only = false);
+  // Runs the interactive work queued so far on the calling thread. Only for
+  // tasks of this pool, which call it between the statements of long
+  // background work so a user facing query doesn't wait for all of it.
+  // only_reads stops at the first task not queued as read_only, for work
+  // that holds a transaction open a write must not join.
+  void run_interactive(bool only_reads = false);
+  // Runs task on the calling thread right away if nothing is queued or
+  // running, holding the pool as if it were one of its tasks. Returns false
+  // without running it otherwise.
+  bool run_if_idle(const std::function<void(void)> &task);
+  // Waits for the running task, then runs what is still queued on the
+  // calling thread. Never waits for a free worker, those may be busy with
+  // other databases.
   void wait_finished();
+  // True when nothing is queued or running. Work queued before this call has
+  // already finished, so it is safe to answer a read without going through
+  // the queue.
+  bool is_idle();
+  QueueStats get_stats();
 
 private:
-  unsigned int busy{};
-  // This condition variable is used for the threads to wait until there is
-  // work to do
-  std::condition_variable_any work_pending;
-
-  // We store the threads in a vector, so we can later stop them gracefully
-  std::vector<std::thread> threads;
-
-  // Mutex to protect work_queue
-  std::mutex work_queue_mutex;
-
-  // Queue of requests waiting to be processed
-  std::queue<std::function<void(void)>> work_queue;
-
-  // This will be set to true when the thread pool is shutting down. This
-  // tells the threads to stop looping and finish.
-  // Atomic because do_work() reads it in `while (!done)` outside the mutex.
-  std::atomic<bool> done;
-
-  // Function used by the threads to grab work from the queue
-  void do_work();
+  std::shared_ptr<Strand> strand;
 };
 
-} // namespace opsqlite
\ No newline at end of file
+// Number of shared worker threads, clamped to 1..OP_SQLITE_MAX_WORKER_THREADS.
+// Lowering it lets the extra threads exit once their current task is done.
+void set_worker_threads(unsigned int count);
+unsigned int get_worker_threads();
+// Every ThreadPool together, plus the state of the worker threads
+QueueStats get_worker_stats();
+
+} // namespace opsqlite
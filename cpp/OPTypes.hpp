@@ -5,6 +5,7 @@
 #include <memory>
 #include <sqlite3.h>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -47,6 +48,41 @@ struct BatchResult {
   int commands;
 };
 
+struct ImportProgress {
+  int affectedRows;
+  int commands;
+  size_t bytes_read;
+  size_t total_bytes;
+};
+
+enum class DataFileFormat { CSV, NDJSON };
+
+struct DataImportOptions {
+  DataFileFormat format;
+  std::string table;
+  // Empty means: CSV header / keys of the first NDJSON object
+  std::vector<std::string> columns;
+  bool header = true;
+  char delimiter = ',';
+  int chunk_size = 0;
+};
+
+struct VectorInsertOptions {
+  std::string table;
+  // Empty means the first column that is not part of the primary key
+  std::string column;
+  // Rowid of every vector, empty lets SQLite assign them
+  std::vector<long long> ids;
+  // rows * dimensions floats, not owned. Every row is bound in place.
+  const float *vectors = nullptr;
+  size_t rows = 0;
+  size_t dimensions = 0;
+  int chunk_size = 0;
+};
+
+// PRAGMA name and value pairs, applied in order when a connection is opened
+using PragmaList = std::vector<std::pair<std::string, std::string>>;
+
 struct BatchArguments {
   std::string sql;
   std::vector<JSVariant> params;
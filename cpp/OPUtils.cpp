@@ -7,7 +7,15 @@
 #endif
 #include "OPThreadPool.hpp"
 #include "OPMacros.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <string_view>
+#include <strings.h>
 #include <sys/stat.h>
 #include <unordered_map>
 #include <utility>
@@ -115,17 +123,20 @@ JSVariant to_variant(jsi::Runtime &rt, const jsi::Value &value) {
   } else if (value.isBool()) {
     return JSVariant(value.getBool());
   } else if (value.isNumber()) {
-    // Binding only ever emits sqlite3_bind_int (below) or sqlite3_bind_double
-    // (see opsqlite_bind_statement) — the long long alternative always fell
-    // through to sqlite3_bind_double anyway, so it added a redundant cast
-    // and comparison here for no behavioral difference.
+    // Whole numbers are bound as integers, up to the 2^53 a double holds
+    // exactly, everything else as REAL
+    constexpr double max_safe_integer = 9007199254740991.0;
     double doubleVal = value.asNumber();
-    int intVal = (int)doubleVal;
-    if (intVal == doubleVal) {
-      return JSVariant(intVal);
-    } else {
-      return JSVariant(doubleVal);
+    if (doubleVal >= INT_MIN && doubleVal <= INT_MAX) {
+      int intVal = static_cast<int>(doubleVal);
+      if (intVal == doubleVal) {
+        return JSVariant(intVal);
+      }
+    } else if (std::abs(doubleVal) <= max_safe_integer &&
+               std::trunc(doubleVal) == doubleVal) {
+      return JSVariant(static_cast<long long>(doubleVal));
     }
+    return JSVariant(doubleVal);
   } else if (value.isString()) {
     std::string strVal = value.asString(rt).utf8(rt);
     return JSVariant(std::move(strVal));
@@ -354,42 +365,1453 @@ void to_batch_arguments(jsi::Runtime &rt, jsi::Array const &tuples,
   }
 }
 
-#ifndef OP_SQLITE_USE_LIBSQL
-BatchResult import_sql_file(sqlite3 *db, std::string path) {
-  std::string line;
-  std::ifstream sqFile(path);
-  if (!sqFile.is_open()) {
-    throw std::runtime_error("Could not open file: " + path);
+namespace {
+
+long long to_row_id(double value) {
+  constexpr double max_safe_integer = 9007199254740991.0;
+  if (std::trunc(value) != value || std::abs(value) > max_safe_integer) {
+    throw std::runtime_error("[op-sqlite][insertVectors] row id " +
+                             std::to_string(value) +
+                             " is not a safe integer");
   }
+  return static_cast<long long>(value);
+}
 
-  try {
-    int affectedRows = 0;
-    int commands = 0;
-    opsqlite_execute(db, "BEGIN EXCLUSIVE TRANSACTION", nullptr);
-    while (std::getline(sqFile, line, '\n')) {
-      if (!line.empty()) {
-        try {
-          auto result = opsqlite_execute(db, line, nullptr);
-          affectedRows += result.affectedRows;
-          commands++;
-        } catch (std::exception &exc) {
-          opsqlite_execute(db, "ROLLBACK", nullptr);
-          sqFile.close();
-          throw exc;
+template <typename T>
+void read_row_ids(const uint8_t *data, size_t length,
+                  std::vector<long long> &ids) {
+  ids.reserve(length);
+  for (size_t i = 0; i < length; i++) {
+    T value;
+    memcpy(&value, data + i * sizeof(T), sizeof(T));
+    ids.push_back(to_row_id(static_cast<double>(value)));
+  }
+}
+
+} // namespace
+
+const uint8_t *typed_array_data(jsi::Runtime &rt, jsi::Object const &array,
+                                size_t element_size, size_t &length,
+                                std::string const &error_prefix) {
+  auto buffer_object = array.getPropertyAsObject(rt, "buffer");
+  // Engines with ArrayBuffer.prototype.transfer say so directly. The others
+  // leave a detached buffer empty, while the view may still report its old
+  // length.
+  auto detached = buffer_object.getProperty(rt, "detached");
+  auto buffer = buffer_object.getArrayBuffer(rt);
+  auto offset =
+      static_cast<size_t>(array.getProperty(rt, "byteOffset").asNumber());
+  length = static_cast<size_t>(array.getProperty(rt, "length").asNumber());
+  uint8_t *data = buffer.data(rt);
+  size_t size = buffer.size(rt);
+
+  if ((detached.isBool() && detached.getBool()) || offset > size ||
+      length > (size - offset) / element_size ||
+      (length > 0 && data == nullptr)) {
+    throw std::runtime_error(error_prefix +
+                             " buffer is detached, it was transferred or "
+                             "resized");
+  }
+  return data + offset;
+}
+
+std::vector<long long> to_row_ids(jsi::Runtime &rt, jsi::Value const &value) {
+  std::vector<long long> ids;
+  auto obj = value.asObject(rt);
+
+  if (obj.isArray(rt)) {
+    auto array = obj.asArray(rt);
+    size_t length = array.length(rt);
+    ids.reserve(length);
+    for (size_t i = 0; i < length; i++) {
+      ids.push_back(to_row_id(array.getValueAtIndex(rt, i).asNumber()));
+    }
+    return ids;
+  }
+
+  auto global = rt.global();
+  auto is_a = [&](const char *type) {
+    return obj.instanceOf(rt, global.getPropertyAsFunction(rt, type));
+  };
+
+  size_t element_size;
+  if (is_a("Int32Array") || is_a("Uint32Array")) {
+    element_size = 4;
+  } else if (is_a("Float64Array")) {
+    element_size = 8;
+  } else {
+    throw std::runtime_error(
+        "[op-sqlite][insertVectors] ids must be a number[], Int32Array, "
+        "Uint32Array or Float64Array");
+  }
+
+  size_t length;
+  const uint8_t *data = typed_array_data(rt, obj, element_size, length,
+                                         "[op-sqlite][insertVectors] ids");
+
+  if (element_size == 8) {
+    read_row_ids<double>(data, length, ids);
+  } else if (is_a("Int32Array")) {
+    read_row_ids<int32_t>(data, length, ids);
+  } else {
+    read_row_ids<uint32_t>(data, length, ids);
+  }
+  return ids;
+}
+
+namespace {
+
+bool is_identifier_char(char c) {
+  return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' ||
+         static_cast<unsigned char>(c) >= 0x80;
+}
+
+const char *skip_sql_trivia(const char *sql, const char *end) {
+  while (sql < end) {
+    if (isspace(static_cast<unsigned char>(*sql))) {
+      sql++;
+    } else if (sql + 1 < end && sql[0] == '-' && sql[1] == '-') {
+      while (sql < end && *sql != '\n') {
+        sql++;
+      }
+    } else if (sql + 1 < end && sql[0] == '/' && sql[1] == '*') {
+      sql += 2;
+      while (sql + 1 < end && !(sql[0] == '*' && sql[1] == '/')) {
+        sql++;
+      }
+      sql = std::min(sql + 2, end);
+    } else {
+      break;
+    }
+  }
+  return sql;
+}
+
+bool starts_with_keyword(const char *sql, const char *end,
+                         const char *keyword) {
+  size_t length = strlen(keyword);
+  return static_cast<size_t>(end - sql) >= length &&
+         strncasecmp(sql, keyword, length) == 0 &&
+         (sql + length == end || !is_identifier_char(sql[length]));
+}
+
+} // namespace
+
+bool is_select_statement(std::string const &sql) {
+  const char *end = sql.data() + sql.size();
+  const char *start = skip_sql_trivia(sql.data(), end);
+  if (!starts_with_keyword(start, end, "SELECT")) {
+    return false;
+  }
+  // Conservative, a ';' inside a literal also counts as a second statement
+  auto semicolon =
+      static_cast<const char *>(memchr(start, ';', end - start));
+  return semicolon == nullptr || skip_sql_trivia(semicolon + 1, end) == end;
+}
+
+#if !defined(OP_SQLITE_USE_LIBSQL) && !defined(OP_SQLITE_USE_TURSO)
+namespace {
+
+constexpr size_t FILE_READ_SIZE = 1 << 20;
+// Dumps usually repeat the same handful of INSERT shapes (one per table), a
+// small cache is enough to keep all of them prepared
+constexpr size_t SQL_FILE_STATEMENT_CACHE_SIZE = 32;
+// Rows between two insertVectors progress callbacks
+constexpr int VECTOR_PROGRESS_INTERVAL = 4096;
+
+struct SQLLiteral {
+  enum Kind { INTEGER, REAL, TEXT, BLOB } kind;
+  const char *start;
+  size_t length;
+};
+
+// Dumps generated by the sqlite3 CLI wrap everything in their own
+// BEGIN/COMMIT, the importer manages the transaction itself so those are
+// skipped
+bool is_transaction_statement(const char *sql, const char *end) {
+  sql = skip_sql_trivia(sql, end);
+  return starts_with_keyword(sql, end, "BEGIN") ||
+         starts_with_keyword(sql, end, "COMMIT") ||
+         starts_with_keyword(sql, end, "END");
+}
+
+// Rewrites the literals of an INSERT into "?" so rows of the same table share
+// a single prepared statement. Returns false whenever the statement is not
+// trivially safe to rewrite, the caller then prepares the original text.
+bool parameterize_insert(const char *sql, const char *end, std::string &shape,
+                         std::vector<SQLLiteral> &literals) {
+  shape.clear();
+  literals.clear();
+
+  const char *start = skip_sql_trivia(sql, end);
+  if (!starts_with_keyword(start, end, "INSERT") &&
+      !starts_with_keyword(start, end, "REPLACE")) {
+    return false;
+  }
+
+  const char *p = start;
+  while (p < end) {
+    char c = *p;
+
+    if (c == '\'' ||
+        ((c == 'x' || c == 'X') && p + 1 < end && p[1] == '\'')) {
+      bool is_blob = c != '\'';
+      const char *literal_start = is_blob ? p + 2 : p + 1;
+      const char *q = literal_start;
+      while (true) {
+        while (q < end && *q != '\'') {
+          q++;
+        }
+        if (q >= end) {
+          return false;
+        }
+        if (q + 1 < end && q[1] == '\'') {
+          q += 2;
+          continue;
+        }
+        break;
+      }
+      literals.push_back({is_blob ? SQLLiteral::BLOB : SQLLiteral::TEXT,
+                          literal_start,
+                          static_cast<size_t>(q - literal_start)});
+      shape.push_back('?');
+      p = q + 1;
+    } else if (isdigit(static_cast<unsigned char>(c)) ||
+               (c == '.' && p + 1 < end &&
+                isdigit(static_cast<unsigned char>(p[1])))) {
+      const char *q = p;
+      bool is_real = false;
+      if (c == '0' && q + 1 < end && (q[1] == 'x' || q[1] == 'X')) {
+        return false;
+      }
+      while (q < end && isdigit(static_cast<unsigned char>(*q))) {
+        q++;
+      }
+      if (q < end && *q == '.') {
+        is_real = true;
+        q++;
+        while (q < end && isdigit(static_cast<unsigned char>(*q))) {
+          q++;
+        }
+      }
+      if (q < end && (*q == 'e' || *q == 'E')) {
+        is_real = true;
+        q++;
+        if (q < end && (*q == '+' || *q == '-')) {
+          q++;
+        }
+        if (q >= end || !isdigit(static_cast<unsigned char>(*q))) {
+          return false;
+        }
+        while (q < end && isdigit(static_cast<unsigned char>(*q))) {
+          q++;
+        }
+      }
+      // Anything glued to the number (e.g. "1abc") is left for sqlite to
+      // complain about. Integers that don't fit in 64 bits are REAL for
+      // sqlite, they are kept in the text as well.
+      if ((q < end && is_identifier_char(*q)) || (!is_real && q - p > 18)) {
+        return false;
+      }
+      literals.push_back({is_real ? SQLLiteral::REAL : SQLLiteral::INTEGER, p,
+                          static_cast<size_t>(q - p)});
+      shape.push_back('?');
+      p = q;
+    } else if (is_identifier_char(c)) {
+      const char *q = p;
+      while (q < end && is_identifier_char(*q)) {
+        q++;
+      }
+      // Numbers in ORDER BY/GROUP BY of an INSERT ... SELECT are column
+      // indexes, not values
+      if (starts_with_keyword(p, q, "SELECT")) {
+        return false;
+      }
+      shape.append(p, q);
+      p = q;
+    } else if (c == '"' || c == '`' || c == '[') {
+      char closing = c == '[' ? ']' : c;
+      const char *q = p + 1;
+      while (q < end && *q != closing) {
+        q++;
+      }
+      if (q >= end) {
+        return false;
+      }
+      shape.append(p, q + 1);
+      p = q + 1;
+    } else if (c == '?' || c == ':' || c == '@' || c == '$') {
+      // Already has parameters, numbering would clash with ours
+      return false;
+    } else if (c == '-' && p + 1 < end && p[1] == '-') {
+      const char *q = skip_sql_trivia(p, end);
+      shape.append(p, q);
+      p = q;
+    } else if (c == '/' && p + 1 < end && p[1] == '*') {
+      const char *q = skip_sql_trivia(p, end);
+      shape.append(p, q);
+      p = q;
+    } else {
+      shape.push_back(c);
+      p++;
+    }
+  }
+
+  return !literals.empty();
+}
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Literal text still points into the read buffer, which is not touched until
+// the statement has been stepped, so unescaped strings are bound without a
+// copy
+bool bind_literals(sqlite3_stmt *statement,
+                   const std::vector<SQLLiteral> &literals,
+                   std::vector<std::string> &scratch) {
+  scratch.clear();
+  scratch.reserve(literals.size());
+
+  for (size_t i = 0; i < literals.size(); i++) {
+    const auto &literal = literals[i];
+    int index = static_cast<int>(i) + 1;
+    int status;
+
+    switch (literal.kind) {
+    case SQLLiteral::INTEGER:
+      status = sqlite3_bind_int64(statement, index,
+                                  strtoll(literal.start, nullptr, 10));
+      break;
+    case SQLLiteral::REAL:
+      status =
+          sqlite3_bind_double(statement, index, strtod(literal.start, nullptr));
+      break;
+    case SQLLiteral::TEXT: {
+      std::string_view text(literal.start, literal.length);
+      if (text.find('\'') == std::string_view::npos) {
+        status = sqlite3_bind_text(statement, index, literal.start,
+                                   static_cast<int>(literal.length),
+                                   SQLITE_STATIC);
+        break;
+      }
+      auto &unescaped = scratch.emplace_back();
+      unescaped.reserve(literal.length);
+      for (size_t j = 0; j < text.size(); j++) {
+        unescaped.push_back(text[j]);
+        if (text[j] == '\'') {
+          j++;
+        }
+      }
+      status = sqlite3_bind_text(statement, index, unescaped.data(),
+                                 static_cast<int>(unescaped.size()),
+                                 SQLITE_STATIC);
+      break;
+    }
+    case SQLLiteral::BLOB: {
+      if (literal.length % 2 != 0) {
+        return false;
+      }
+      auto &bytes = scratch.emplace_back();
+      bytes.resize(literal.length / 2);
+      for (size_t j = 0; j < bytes.size(); j++) {
+        int high = hex_value(literal.start[j * 2]);
+        int low = hex_value(literal.start[j * 2 + 1]);
+        if (high < 0 || low < 0) {
+          return false;
         }
+        bytes[j] = static_cast<char>((high << 4) | low);
       }
+      status = sqlite3_bind_blob(statement, index, bytes.data(),
+                                 static_cast<int>(bytes.size()),
+                                 SQLITE_STATIC);
+      break;
+    }
     }
-    sqFile.close();
+
+    if (status != SQLITE_OK) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Reads a file in FILE_READ_SIZE blocks, appended to a buffer owned by the
+// caller so records split across two blocks stay contiguous
+class BlockReader {
+public:
+  explicit BlockReader(std::string const &path)
+      : file(path, std::ios::binary), block(FILE_READ_SIZE) {
+    if (!file.is_open()) {
+      throw std::runtime_error("Could not open file: " + path);
+    }
+
+    file.seekg(0, std::ios::end);
+    total_bytes = static_cast<size_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+  }
+
+  // Returns false once the whole file has been read
+  bool read_into(std::string &buffer) {
+    if (!file) {
+      return false;
+    }
+
+    file.read(block.data(), block.size());
+    auto read = static_cast<size_t>(file.gcount());
+    if (read == 0) {
+      return false;
+    }
+
+    bytes_read += read;
+    buffer.append(block.data(), read);
+    return true;
+  }
+
+  size_t bytes_read = 0;
+  size_t total_bytes = 0;
+
+private:
+  std::ifstream file;
+  std::vector<char> block;
+};
+
+// Keeps an exclusive transaction open during an import and, when chunk_size
+// is set, commits every chunk_size statements
+class ChunkedTransaction {
+public:
+  ChunkedTransaction(sqlite3 *db, int chunk_size)
+      : db(db), chunk_size(chunk_size) {}
+
+  void begin() {
+    opsqlite_execute(db, "BEGIN EXCLUSIVE TRANSACTION", nullptr);
+    in_transaction = true;
+  }
+
+  void commit() {
     opsqlite_execute(db, "COMMIT", nullptr);
-    return {"", affectedRows, commands};
+    in_transaction = false;
+  }
+
+  void rollback() {
+    if (in_transaction && !sqlite3_get_autocommit(db)) {
+      sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    in_transaction = false;
+  }
+
+  void statement_done() {
+    done++;
+    if (chunk_size > 0 && done - committed >= chunk_size) {
+      commit();
+      committed = done;
+      begin();
+    }
+  }
+
+  // Rolls back and rethrows, mentioning how much of the import is
+  // already committed when chunking is on
+  [[noreturn]] void fail(std::exception const &exc) {
+    rollback();
+
+    std::string message = exc.what();
+    if (committed > 0) {
+      message += " (" + std::to_string(committed) +
+                 " statements were already committed)";
+    }
+    throw std::runtime_error(message);
+  }
+
+private:
+  sqlite3 *db;
+  int chunk_size;
+  bool in_transaction = false;
+  int done = 0;
+  int committed = 0;
+};
+
+class SQLFileImporter {
+public:
+  SQLFileImporter(sqlite3 *db, int chunk_size)
+      : transaction(db, chunk_size), db(db),
+        max_params(sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1)) {}
+
+  ~SQLFileImporter() {
+    for (auto &[_, statement] : statements) {
+      sqlite3_finalize(statement);
+    }
+  }
+
+  void execute(const char *sql, const char *end) {
+    if (is_transaction_statement(sql, end)) {
+      return;
+    }
+
+    sqlite3_stmt *statement = nullptr;
+    bool is_cached = false;
+
+    if (parameterize_insert(sql, end, shape, literals) &&
+        static_cast<int>(literals.size()) <= max_params) {
+      statement = cached_statement(shape);
+      if (statement != nullptr) {
+        is_cached = bind_literals(statement, literals, scratch);
+        if (!is_cached) {
+          sqlite3_clear_bindings(statement);
+          statement = nullptr;
+        }
+      }
+    }
+
+    if (statement == nullptr) {
+      if (sqlite3_prepare_v2(db, sql, static_cast<int>(end - sql), &statement,
+                             nullptr) != SQLITE_OK) {
+        throw std::runtime_error("[op-sqlite][loadFile] " +
+                                 std::string(sqlite3_errmsg(db)));
+      }
+
+      // Only comments or whitespace
+      if (statement == nullptr) {
+        return;
+      }
+    }
+
+    int status;
+    do {
+      status = sqlite3_step(statement);
+    } while (status == SQLITE_ROW);
+
+    bool is_write = !sqlite3_stmt_readonly(statement);
+
+    if (is_cached) {
+      sqlite3_reset(statement);
+      sqlite3_clear_bindings(statement);
+    } else {
+      sqlite3_finalize(statement);
+    }
+
+    if (status != SQLITE_DONE) {
+      throw std::runtime_error("[op-sqlite][loadFile] " +
+                               std::string(sqlite3_errmsg(db)));
+    }
+
+    if (is_write) {
+      affected_rows += sqlite3_changes(db);
+    }
+    commands++;
+    transaction.statement_done();
+  }
+
+  ChunkedTransaction transaction;
+  int affected_rows = 0;
+  int commands = 0;
+
+private:
+  sqlite3_stmt *cached_statement(const std::string &sql) {
+    auto it = statements.find(sql);
+    if (it != statements.end()) {
+      return it->second;
+    }
+
+    sqlite3_stmt *statement = nullptr;
+    if (sqlite3_prepare_v3(db, sql.c_str(), static_cast<int>(sql.size()),
+                           SQLITE_PREPARE_PERSISTENT, &statement,
+                           nullptr) != SQLITE_OK) {
+      // Let the original text produce the error message
+      return nullptr;
+    }
+
+    if (statements.size() >= SQL_FILE_STATEMENT_CACHE_SIZE) {
+      for (auto &[_, cached] : statements) {
+        sqlite3_finalize(cached);
+      }
+      statements.clear();
+    }
+
+    statements.emplace(sql, statement);
+    return statement;
+  }
+
+  sqlite3 *db;
+  int max_params;
+  std::unordered_map<std::string, sqlite3_stmt *> statements;
+  std::string shape;
+  std::vector<SQLLiteral> literals;
+  std::vector<std::string> scratch;
+};
+
+} // namespace
+
+bool is_transaction_control(std::string const &sql) {
+  const char *end = sql.data() + sql.size();
+  const char *start = skip_sql_trivia(sql.data(), end);
+  return is_transaction_statement(start, end) ||
+         starts_with_keyword(start, end, "ROLLBACK") ||
+         starts_with_keyword(start, end, "SAVEPOINT") ||
+         starts_with_keyword(start, end, "RELEASE");
+}
+
+BatchResult
+import_sql_file(sqlite3 *db, std::string const &path, int chunk_size,
+                std::function<void(const ImportProgress &)> const &on_progress) {
+  BlockReader reader(path);
+  SQLFileImporter importer(db, chunk_size);
+  // Unconsumed text, always starts at the beginning of a statement
+  std::string buffer;
+  size_t scanned = 0;
+  // Files without any semicolon in their first block hold one statement per
+  // line, the format loadFile always accepted
+  bool is_first_block = true;
+  bool by_line = false;
+
+  // Outside of the try, a failed BEGIN has nothing to roll back and its error
+  // must reach the caller as is
+  importer.transaction.begin();
+
+  try {
+    while (reader.read_into(buffer)) {
+      if (is_first_block) {
+        by_line = buffer.find(';') == std::string::npos;
+        is_first_block = false;
+      }
+
+      size_t statement_start = 0;
+      if (by_line) {
+        size_t newline;
+        while ((newline = buffer.find('\n', statement_start)) !=
+               std::string::npos) {
+          importer.execute(buffer.data() + statement_start,
+                           buffer.data() + newline);
+          statement_start = newline + 1;
+        }
+      } else {
+        size_t semicolon;
+        while ((semicolon = buffer.find(';', scanned)) != std::string::npos) {
+          scanned = semicolon + 1;
+
+          // sqlite3_complete needs a null terminated string, the buffer is
+          // patched in place instead of copying the statement out
+          char next = buffer[scanned];
+          buffer[scanned] = '\0';
+          bool is_complete = sqlite3_complete(buffer.data() + statement_start);
+          buffer[scanned] = next;
+
+          if (is_complete) {
+            importer.execute(buffer.data() + statement_start,
+                             buffer.data() + scanned);
+            statement_start = scanned;
+          }
+        }
+      }
+
+      buffer.erase(0, statement_start);
+      scanned = buffer.size();
+
+      if (on_progress) {
+        on_progress({importer.affected_rows, importer.commands,
+                     reader.bytes_read, reader.total_bytes});
+      }
+    }
+
+    // Last statement is allowed to omit the trailing semicolon
+    importer.execute(buffer.data(), buffer.data() + buffer.size());
+
+    importer.transaction.commit();
+
+    if (on_progress) {
+      on_progress({importer.affected_rows, importer.commands,
+                   reader.bytes_read, reader.total_bytes});
+    }
+
+    return {"", importer.affected_rows, importer.commands};
+  } catch (std::exception &exc) {
+    importer.transaction.fail(exc);
+  }
+}
+namespace {
+
+struct DataField {
+  enum Kind { NUL, INTEGER, REAL, TEXT } kind = NUL;
+  long long integer = 0;
+  double real = 0;
+  std::string_view text;
+};
+
+std::string quote_identifier(std::string const &name) {
+  std::string quoted = "\"";
+  for (char c : name) {
+    quoted.push_back(c);
+    if (c == '"') {
+      quoted.push_back('"');
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+const char *find_char(const char *p, const char *end, char c) {
+  return static_cast<const char *>(memchr(p, c, end - p));
+}
+
+// Empty unquoted fields are NULL, "" is an empty string
+DataField unquoted_field(const char *start, const char *end) {
+  if (start == end) {
+    return {};
+  }
+  return {DataField::TEXT, 0, 0, std::string_view(start, end - start)};
+}
+
+// Splits one CSV record (RFC 4180) starting at p. Returns the start of the
+// next record, or nullptr when the record continues past end and more data
+// has to be read first. Fields point into the buffer, quoted fields still
+// contain their doubled quotes and are flagged so the caller can unescape
+// them.
+const char *parse_csv_record(const char *p, const char *end, bool at_eof,
+                             char delimiter, std::vector<DataField> &fields,
+                             std::vector<bool> &escaped) {
+  fields.clear();
+  escaped.clear();
+
+  // Fast path, the record has no quotes: memchr (vectorized in libc) finds
+  // the end of the line and every delimiter
+  const char *line_end = find_char(p, end, '\n');
+  if (line_end == nullptr && !at_eof) {
+    return nullptr;
+  }
+  const char *line_stop = line_end == nullptr ? end : line_end;
+
+  if (find_char(p, line_stop, '"') == nullptr) {
+    const char *content_end = line_stop;
+    if (content_end > p && content_end[-1] == '\r') {
+      content_end--;
+    }
+
+    while (true) {
+      const char *next = find_char(p, content_end, delimiter);
+      const char *field_end = next == nullptr ? content_end : next;
+      fields.push_back(unquoted_field(p, field_end));
+      escaped.push_back(false);
+      if (next == nullptr) {
+        break;
+      }
+      p = next + 1;
+    }
+
+    return line_end == nullptr ? end : line_end + 1;
+  }
+
+  while (true) {
+    if (p < end && *p == '"') {
+      const char *q = p + 1;
+      bool has_quotes = false;
+      while (true) {
+        q = find_char(q, end, '"');
+        if (q == nullptr || (q + 1 == end && !at_eof)) {
+          if (at_eof) {
+            throw std::runtime_error("unterminated quoted field");
+          }
+          return nullptr;
+        }
+        if (q + 1 < end && q[1] == '"') {
+          has_quotes = true;
+          q += 2;
+          continue;
+        }
+        break;
+      }
+      fields.push_back({DataField::TEXT, 0, 0,
+                        std::string_view(p + 1, q - p - 1)});
+      escaped.push_back(has_quotes);
+      p = q + 1;
+    } else {
+      const char *q = p;
+      while (q < end && *q != delimiter && *q != '\n' && *q != '\r') {
+        q++;
+      }
+      if (q == end && !at_eof) {
+        return nullptr;
+      }
+      fields.push_back(unquoted_field(p, q));
+      escaped.push_back(false);
+      p = q;
+    }
+
+    if (p == end) {
+      return at_eof ? end : nullptr;
+    }
+    if (*p == delimiter) {
+      p++;
+      continue;
+    }
+    if (*p == '\r') {
+      p++;
+      if (p == end) {
+        return at_eof ? end : nullptr;
+      }
+      return *p == '\n' ? p + 1 : p;
+    }
+    if (*p == '\n') {
+      return p + 1;
+    }
+    throw std::runtime_error("unexpected character after quoted field");
+  }
+}
+
+void append_utf8(std::string &out, uint32_t code_point) {
+  if (code_point < 0x80) {
+    out.push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Minimal parser for the flat objects found in NDJSON seed files. Nested
+// objects and arrays are kept as their JSON text so json_* functions can
+// still be used on them.
+class JSONLineParser {
+public:
+  JSONLineParser(const char *p, const char *end, std::deque<std::string> &scratch)
+      : p(p), end(end), scratch(scratch) {}
+
+  template <typename OnField> void parse_object(OnField on_field) {
+    skip_whitespace();
+    expect('{');
+    skip_whitespace();
+    if (peek() == '}') {
+      p++;
+      return;
+    }
+
+    while (true) {
+      skip_whitespace();
+      std::string_view key = parse_string();
+      skip_whitespace();
+      expect(':');
+      skip_whitespace();
+      on_field(key, parse_value());
+      skip_whitespace();
+      if (peek() == ',') {
+        p++;
+        continue;
+      }
+      expect('}');
+      break;
+    }
+
+    skip_whitespace();
+    if (p != end) {
+      throw std::runtime_error("unexpected data after JSON object");
+    }
+  }
+
+private:
+  char peek() const { return p < end ? *p : '\0'; }
+
+  void expect(char c) {
+    if (peek() != c) {
+      throw std::runtime_error(std::string("invalid JSON, expected '") + c +
+                               "'");
+    }
+    p++;
+  }
+
+  void skip_whitespace() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+      p++;
+    }
+  }
+
+  uint32_t parse_hex4() {
+    if (end - p < 4) {
+      throw std::runtime_error("invalid JSON unicode escape");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+      int digit = hex_value(p[i]);
+      if (digit < 0) {
+        throw std::runtime_error("invalid JSON unicode escape");
+      }
+      value = (value << 4) | digit;
+    }
+    p += 4;
+    return value;
+  }
+
+  std::string_view parse_string() {
+    expect('"');
+    const char *start = p;
+    while (p < end && *p != '"' && *p != '\\') {
+      p++;
+    }
+    if (p < end && *p == '"') {
+      return std::string_view(start, p++ - start);
+    }
+
+    // Escapes present, decode into an owned string
+    auto &decoded = scratch.emplace_back(start, p - start);
+    while (true) {
+      if (p >= end) {
+        throw std::runtime_error("unterminated JSON string");
+      }
+      char c = *p++;
+      if (c == '"') {
+        break;
+      }
+      if (c != '\\') {
+        decoded.push_back(c);
+        continue;
+      }
+      if (p >= end) {
+        throw std::runtime_error("unterminated JSON string");
+      }
+      switch (char escape = *p++) {
+      case 'b':
+        decoded.push_back('\b');
+        break;
+      case 'f':
+        decoded.push_back('\f');
+        break;
+      case 'n':
+        decoded.push_back('\n');
+        break;
+      case 'r':
+        decoded.push_back('\r');
+        break;
+      case 't':
+        decoded.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code_point = parse_hex4();
+        if (code_point >= 0xD800 && code_point <= 0xDBFF && end - p >= 6 &&
+            p[0] == '\\' && p[1] == 'u') {
+          p += 2;
+          uint32_t low = parse_hex4();
+          if (low >= 0xDC00 && low <= 0xDFFF) {
+            code_point =
+                0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+          } else {
+            append_utf8(decoded, code_point);
+            code_point = low;
+          }
+        }
+        append_utf8(decoded, code_point);
+        break;
+      }
+      default:
+        decoded.push_back(escape);
+      }
+    }
+    return decoded;
+  }
+
+  // Skips a nested object/array, strings included so brackets inside them
+  // are not counted
+  void skip_nested() {
+    int depth = 0;
+    do {
+      if (p >= end) {
+        throw std::runtime_error("unterminated JSON value");
+      }
+      char c = *p;
+      if (c == '"') {
+        parse_string();
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+      }
+      p++;
+    } while (depth > 0);
+  }
+
+  bool consume_literal(const char *literal) {
+    size_t length = strlen(literal);
+    if (static_cast<size_t>(end - p) >= length &&
+        memcmp(p, literal, length) == 0) {
+      p += length;
+      return true;
+    }
+    return false;
+  }
+
+  DataField parse_value() {
+    char c = peek();
+
+    if (c == '"') {
+      return {DataField::TEXT, 0, 0, parse_string()};
+    }
+
+    if (c == '{' || c == '[') {
+      const char *start = p;
+      skip_nested();
+      return {DataField::TEXT, 0, 0, std::string_view(start, p - start)};
+    }
+
+    if (c == '-' || isdigit(static_cast<unsigned char>(c))) {
+      const char *start = p;
+      bool is_real = false;
+      while (p < end && (isdigit(static_cast<unsigned char>(*p)) ||
+                         *p == '-' || *p == '+' || *p == '.' || *p == 'e' ||
+                         *p == 'E')) {
+        is_real |= *p == '.' || *p == 'e' || *p == 'E';
+        p++;
+      }
+      if (!is_real) {
+        errno = 0;
+        long long value = strtoll(start, nullptr, 10);
+        if (errno != ERANGE) {
+          return {DataField::INTEGER, value, 0, {}};
+        }
+      }
+      return {DataField::REAL, 0, strtod(start, nullptr), {}};
+    }
+
+    if (consume_literal("true")) {
+      return {DataField::INTEGER, 1, 0, {}};
+    }
+    if (consume_literal("false")) {
+      return {DataField::INTEGER, 0, 0, {}};
+    }
+    if (consume_literal("null")) {
+      return {};
+    }
+
+    throw std::runtime_error("invalid JSON value");
+  }
+
+  const char *p;
+  const char *end;
+  std::deque<std::string> &scratch;
+};
+
+std::string unescape_csv_field(std::string_view field) {
+  std::string unescaped;
+  unescaped.reserve(field.size());
+  for (size_t i = 0; i < field.size(); i++) {
+    unescaped.push_back(field[i]);
+    if (field[i] == '"') {
+      i++;
+    }
+  }
+  return unescaped;
+}
+
+// Binds a whole row and steps the reused insert. Text still points into the
+// read buffer (or the per row scratch strings), which outlive the step.
+void insert_row(sqlite3 *db, sqlite3_stmt *statement,
+                const std::vector<DataField> &row) {
+  for (size_t i = 0; i < row.size(); i++) {
+    const auto &field = row[i];
+    int index = static_cast<int>(i) + 1;
+
+    switch (field.kind) {
+    case DataField::NUL:
+      sqlite3_bind_null(statement, index);
+      break;
+    case DataField::INTEGER:
+      sqlite3_bind_int64(statement, index, field.integer);
+      break;
+    case DataField::REAL:
+      sqlite3_bind_double(statement, index, field.real);
+      break;
+    case DataField::TEXT:
+      sqlite3_bind_text(statement, index, field.text.data(),
+                        static_cast<int>(field.text.size()), SQLITE_STATIC);
+      break;
+    }
+  }
+
+  int status = sqlite3_step(statement);
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+
+  if (status != SQLITE_DONE) {
+    throw std::runtime_error(sqlite3_errmsg(db));
+  }
+}
+
+} // namespace
+
+BatchResult
+import_data_file(sqlite3 *db, std::string const &path,
+                 DataImportOptions const &options,
+                 std::function<void(const ImportProgress &)> const &on_progress) {
+  BlockReader reader(path);
+  ChunkedTransaction transaction(db, options.chunk_size);
+  std::string buffer;
+  sqlite3_stmt *statement = nullptr;
+
+  std::vector<std::string> columns = options.columns;
+  // For CSV: position of every target column inside a record
+  std::vector<size_t> field_indexes;
+  bool is_header_pending =
+      options.format == DataFileFormat::CSV && options.header;
+  size_t expected_fields = 0;
+
+  std::vector<DataField> fields;
+  std::vector<bool> escaped;
+  std::vector<DataField> row;
+  // Unescaped text of the current row, a deque so growing it never moves
+  // the strings already bound
+  std::deque<std::string> scratch;
+  int rows = 0;
+  int record = 0;
+
+  auto prepare_insert = [&](size_t column_count) {
+    std::string sql = "INSERT INTO " + quote_identifier(options.table);
+    if (!columns.empty()) {
+      sql += " (";
+      for (size_t i = 0; i < columns.size(); i++) {
+        sql += (i == 0 ? "" : ", ") + quote_identifier(columns[i]);
+      }
+      sql += ")";
+    }
+    sql += " VALUES (";
+    for (size_t i = 0; i < column_count; i++) {
+      sql += i == 0 ? "?" : ", ?";
+    }
+    sql += ")";
+
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr) !=
+        SQLITE_OK) {
+      throw std::runtime_error(sqlite3_errmsg(db));
+    }
+    row.resize(column_count);
+  };
+
+  // Returns false for the header, which is not inserted
+  auto handle_csv_record = [&]() {
+    if (is_header_pending) {
+      is_header_pending = false;
+      std::vector<std::string> header;
+      for (size_t i = 0; i < fields.size(); i++) {
+        header.emplace_back(escaped[i] ? unescape_csv_field(fields[i].text)
+                                       : std::string(fields[i].text));
+      }
+
+      if (columns.empty()) {
+        columns = header;
+      }
+      for (const auto &column : columns) {
+        auto it = std::find(header.begin(), header.end(), column);
+        if (it == header.end()) {
+          throw std::runtime_error("column \"" + column +
+                                   "\" not found in the CSV header");
+        }
+        field_indexes.push_back(it - header.begin());
+      }
+      expected_fields = header.size();
+      prepare_insert(columns.size());
+      return false;
+    }
+
+    if (statement == nullptr) {
+      expected_fields = columns.empty() ? fields.size() : columns.size();
+      for (size_t i = 0; i < expected_fields; i++) {
+        field_indexes.push_back(i);
+      }
+      prepare_insert(expected_fields);
+    }
+
+    if (fields.size() != expected_fields) {
+      throw std::runtime_error("expected " + std::to_string(expected_fields) +
+                               " fields, found " +
+                               std::to_string(fields.size()));
+    }
+
+    for (size_t i = 0; i < field_indexes.size(); i++) {
+      size_t field_index = field_indexes[i];
+      if (escaped[field_index]) {
+        scratch.push_back(unescape_csv_field(fields[field_index].text));
+        row[i] = {DataField::TEXT, 0, 0, scratch.back()};
+      } else {
+        row[i] = fields[field_index];
+      }
+    }
+    return true;
+  };
+
+  auto handle_json_line = [&](const char *start, const char *stop) {
+    if (statement == nullptr && columns.empty()) {
+      // Keys of the first object decide the columns
+      std::deque<std::string> first_scratch;
+      JSONLineParser(start, stop, first_scratch)
+          .parse_object([&](std::string_view key, DataField const &) {
+            columns.emplace_back(key);
+          });
+    }
+    if (statement == nullptr) {
+      prepare_insert(columns.size());
+    }
+
+    std::fill(row.begin(), row.end(), DataField{});
+    size_t hint = 0;
+    JSONLineParser(start, stop, scratch)
+        .parse_object([&](std::string_view key, DataField const &value) {
+          // Keys usually come in the same order on every line
+          if (hint < columns.size() && columns[hint] == key) {
+            row[hint++] = value;
+            return;
+          }
+          for (size_t i = 0; i < columns.size(); i++) {
+            if (columns[i] == key) {
+              row[i] = value;
+              hint = i + 1;
+              return;
+            }
+          }
+        });
+  };
+
+  try {
+    transaction.begin();
+
+    bool at_eof = false;
+    bool is_first_block = true;
+    while (!at_eof) {
+      at_eof = !reader.read_into(buffer);
+
+      const char *p = buffer.data();
+      const char *end = buffer.data() + buffer.size();
+
+      if (is_first_block && buffer.size() >= 3 &&
+          memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+      }
+      is_first_block = false;
+
+      while (p < end) {
+        const char *next;
+        scratch.clear();
+
+        if (options.format == DataFileFormat::CSV) {
+          record++;
+          next = parse_csv_record(p, end, at_eof, options.delimiter, fields,
+                                  escaped);
+          if (next == nullptr) {
+            record--;
+            break;
+          }
+          // Blank line
+          if ((fields.size() == 1 && fields[0].kind == DataField::NUL) ||
+              !handle_csv_record()) {
+            p = next;
+            continue;
+          }
+        } else {
+          const char *line_end = find_char(p, end, '\n');
+          if (line_end == nullptr && !at_eof) {
+            break;
+          }
+          next = line_end == nullptr ? end : line_end + 1;
+          record++;
+
+          const char *content = p;
+          const char *stop = line_end == nullptr ? end : line_end;
+          while (content < stop && isspace(static_cast<unsigned char>(*content))) {
+            content++;
+          }
+          if (content == stop) {
+            p = next;
+            continue;
+          }
+          handle_json_line(content, stop);
+        }
+
+        insert_row(db, statement, row);
+        rows++;
+        transaction.statement_done();
+        p = next;
+      }
+
+      buffer.erase(0, p - buffer.data());
+
+      if (on_progress) {
+        on_progress({rows, rows, reader.bytes_read, reader.total_bytes});
+      }
+    }
+
+    transaction.commit();
+    sqlite3_finalize(statement);
+    return {"", rows, rows};
   } catch (std::exception &exc) {
-    sqFile.close();
-    opsqlite_execute(db, "ROLLBACK", nullptr);
-    throw exc;
+    sqlite3_finalize(statement);
+    transaction.fail(std::runtime_error("[op-sqlite][importFile] row " +
+                                        std::to_string(record) + ": " +
+                                        exc.what()));
+  }
+}
+
+BatchResult
+insert_vectors(sqlite3 *db, VectorInsertOptions const &options,
+               std::function<void(const ImportProgress &)> const &on_progress) {
+  std::string column = options.column;
+  if (column.empty()) {
+    sqlite3_stmt *info = nullptr;
+    // vec0 tables declare their rowid as a regular column
+    if (sqlite3_prepare_v2(db,
+                           "SELECT name FROM pragma_table_info(?) WHERE pk = 0 "
+                           "AND lower(name) <> 'rowid' LIMIT 1",
+                           -1, &info, nullptr) == SQLITE_OK) {
+      sqlite3_bind_text(info, 1, options.table.c_str(), -1, SQLITE_STATIC);
+      if (sqlite3_step(info) == SQLITE_ROW) {
+        column = reinterpret_cast<const char *>(sqlite3_column_text(info, 0));
+      }
+    }
+    sqlite3_finalize(info);
+
+    if (column.empty()) {
+      throw std::runtime_error("[op-sqlite][insertVectors] no column to insert "
+                               "into found in table " +
+                               options.table);
+    }
+  }
+
+  bool has_ids = !options.ids.empty();
+  std::string sql = "INSERT INTO " + quote_identifier(options.table) + " (" +
+                    (has_ids ? "rowid, " : "") + quote_identifier(column) +
+                    ") VALUES (" + (has_ids ? "?, ?)" : "?)");
+
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr) !=
+      SQLITE_OK) {
+    throw std::runtime_error("[op-sqlite][insertVectors] " +
+                             std::string(sqlite3_errmsg(db)));
+  }
+
+  ChunkedTransaction transaction(db, options.chunk_size);
+  const int vector_index = has_ids ? 2 : 1;
+  const size_t row_bytes = options.dimensions * sizeof(float);
+  const size_t total_bytes = options.rows * row_bytes;
+  int rows = 0;
+
+  try {
+    transaction.begin();
+
+    for (size_t i = 0; i < options.rows; i++) {
+      if (has_ids) {
+        sqlite3_bind_int64(statement, 1, options.ids[i]);
+      }
+      // SQLite only reads the slice during the step, no need for a copy
+      sqlite3_bind_blob(statement, vector_index,
+                        options.vectors + i * options.dimensions,
+                        static_cast<int>(row_bytes), SQLITE_STATIC);
+
+      int status = sqlite3_step(statement);
+      sqlite3_reset(statement);
+      if (status != SQLITE_DONE) {
+        throw std::runtime_error(sqlite3_errmsg(db));
+      }
+
+      rows++;
+      transaction.statement_done();
+      if (on_progress && rows % VECTOR_PROGRESS_INTERVAL == 0) {
+        on_progress({rows, rows, rows * row_bytes, total_bytes});
+      }
+    }
+
+    transaction.commit();
+    sqlite3_finalize(statement);
+    if (on_progress && rows % VECTOR_PROGRESS_INTERVAL != 0) {
+      on_progress({rows, rows, total_bytes, total_bytes});
+    }
+    return {"", rows, rows};
+  } catch (std::exception &exc) {
+    sqlite3_finalize(statement);
+    transaction.fail(std::runtime_error("[op-sqlite][insertVectors] row " +
+                                        std::to_string(rows) + ": " +
+                                        exc.what()));
   }
 }
 #endif
 
+PragmaList get_pragma_profile(std::string const &name, bool read_only) {
+  PragmaList pragmas;
+  // busy_timeout goes first so switching to WAL waits for other connections
+  // instead of failing with SQLITE_BUSY
+  if (name == "read-heavy") {
+    pragmas = {{"busy_timeout", "5000"},     {"journal_mode", "WAL"},
+               {"synchronous", "NORMAL"},    {"cache_size", "-16000"},
+               {"mmap_size", "268435456"},   {"temp_store", "MEMORY"}};
+  } else if (name == "write-heavy") {
+    // Fewer, larger checkpoints and a cap on how big the WAL file stays
+    pragmas = {{"busy_timeout", "5000"},        {"journal_mode", "WAL"},
+               {"synchronous", "NORMAL"},       {"cache_size", "-8000"},
+               {"mmap_size", "67108864"},       {"temp_store", "MEMORY"},
+               {"wal_autocheckpoint", "2000"}, {"journal_size_limit", "67108864"}};
+  } else if (name == "low-memory") {
+    pragmas = {{"busy_timeout", "5000"},  {"journal_mode", "WAL"},
+               {"synchronous", "NORMAL"}, {"cache_size", "-512"},
+               {"mmap_size", "0"},        {"temp_store", "FILE"}};
+  } else {
+    throw std::runtime_error(
+        "[op-sqlite][open] Unknown profile: " + name +
+        ", expected read-heavy, write-heavy or low-memory");
+  }
+
+  // A read-only connection can't change the journal mode of the file and
+  // never syncs it
+  if (read_only) {
+    pragmas.erase(std::remove_if(pragmas.begin(), pragmas.end(),
+                                 [](auto const &pragma) {
+                                   return pragma.first == "journal_mode" ||
+                                          pragma.first == "synchronous";
+                                 }),
+                  pragmas.end());
+  }
+
+  return pragmas;
+}
+
+void validate_pragma(std::string const &name, std::string const &value) {
+  auto is_name_char = [](char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  };
+  auto is_value_char = [&](char c) {
+    return is_name_char(c) || (c >= '0' && c <= '9') || c == '-' ||
+           c == '+' || c == '.';
+  };
+
+  if (name.empty() || !std::all_of(name.begin(), name.end(), is_name_char)) {
+    throw std::runtime_error("[op-sqlite][open] Invalid pragma name: " + name);
+  }
+
+  if (value.empty() ||
+      !std::all_of(value.begin(), value.end(), is_value_char)) {
+    throw std::runtime_error("[op-sqlite][open] Invalid value for pragma " +
+                             name + ": " + value);
+  }
+}
+
+std::vector<std::string> const &get_settings_pragmas() {
+  static const std::vector<std::string> pragmas = {
+      "busy_timeout", "journal_mode",       "synchronous",
+      "cache_size",   "mmap_size",          "temp_store",
+      "page_size",    "wal_autocheckpoint", "journal_size_limit"};
+  return pragmas;
+}
+
 bool folder_exists(const std::string &name) {
   struct stat buffer;
   return (stat(name.c_str(), &buffer) == 0);
@@ -400,22 +1822,177 @@ bool file_exists(const std::string &path) {
   return (stat(path.c_str(), &buffer) == 0);
 }
 
+Priority to_priority(jsi::Runtime &rt, jsi::Value const &options,
+                     std::string const &function_name) {
+  if (!options.isObject()) {
+    return Priority::Normal;
+  }
+
+  auto value = options.asObject(rt).getProperty(rt, "priority");
+  if (value.isUndefined()) {
+    return Priority::Normal;
+  }
+
+  std::string priority = value.isString() ? value.asString(rt).utf8(rt) : "";
+  if (priority == "interactive") {
+    return Priority::Interactive;
+  }
+  if (priority == "normal") {
+    return Priority::Normal;
+  }
+  if (priority == "background") {
+    return Priority::Background;
+  }
+
+  throw std::runtime_error("[op-sqlite][" + function_name +
+                           "] priority must be interactive, normal or "
+                           "background");
+}
+
+std::shared_ptr<QueryToken> to_query_token(jsi::Runtime &rt,
+                                           jsi::Value const &options,
+                                           std::string const &function_name,
+                                           std::function<void()> interrupt) {
+  if (!options.isObject()) {
+    return nullptr;
+  }
+
+  auto object = options.asObject(rt);
+  auto signal = object.getProperty(rt, "signal");
+  auto timeout = object.getProperty(rt, "timeoutMs");
+  auto deadline = object.getProperty(rt, "deadlineMs");
+  bool has_signal = signal.isObject();
+  bool has_timeout = !timeout.isUndefined() && !timeout.isNull();
+  bool has_deadline = !deadline.isUndefined() && !deadline.isNull();
+  if (!has_signal && !has_timeout && !has_deadline) {
+    return nullptr;
+  }
+
+  auto token =
+      std::make_shared<QueryToken>(function_name, std::move(interrupt));
+
+  // Rejects NaN too. Anything past INT_MAX (about 24 days) waits that long,
+  // the cast of a bigger double is undefined.
+  auto to_ms = [&](jsi::Value const &value, const char *name) {
+    if (!value.isNumber() || !(value.asNumber() >= 1)) {
+      throw std::runtime_error("[op-sqlite][" + function_name + "] " + name +
+                               " must be a positive number");
+    }
+    return static_cast<int>(
+        std::min(value.asNumber(), static_cast<double>(INT_MAX)));
+  };
+
+  if (has_timeout) {
+    QueryToken::schedule_timeout(token, to_ms(timeout, "timeoutMs"));
+  }
+
+  if (has_deadline) {
+    token->set_deadline(to_ms(deadline, "deadlineMs"));
+  }
+
+  if (has_signal) {
+    auto signal_object = signal.asObject(rt);
+    auto aborted = signal_object.getProperty(rt, "aborted");
+    if (aborted.isBool() && aborted.getBool()) {
+      token->cancel(QueryToken::Reason::Aborted);
+    } else {
+      // Weak so an AbortSignal that outlives the query doesn't keep its token
+      auto on_abort = std::make_shared<jsi::Function>(
+          HFN(weak_token = std::weak_ptr<QueryToken>(token)) {
+            if (auto token = weak_token.lock()) {
+              token->cancel(QueryToken::Reason::Aborted);
+            }
+            return {};
+          }));
+      auto listened = std::make_shared<jsi::Object>(std::move(signal_object));
+      listened->getPropertyAsFunction(rt, "addEventListener")
+          .callWithThis(rt, *listened,
+                        jsi::String::createFromAscii(rt, "abort"), *on_abort);
+      // A signal reused across many calls would otherwise collect a
+      // listener per call
+      token->on_settled([listened, on_abort](jsi::Runtime &rt) {
+        listened->getPropertyAsFunction(rt, "removeEventListener")
+            .callWithThis(rt, *listened,
+                          jsi::String::createFromAscii(rt, "abort"),
+                          *on_abort);
+      });
+    }
+  }
+
+  return token;
+}
+
 void log_to_console(jsi::Runtime &runtime, const std::string &message) {
   auto console = runtime.global().getPropertyAsObject(runtime, "console");
   auto log = console.getPropertyAsFunction(runtime, "log");
   log.call(runtime, jsi::String::createFromUtf8(runtime, message));
 }
 
+jsi::Object create_queue_stats(jsi::Runtime &rt, QueueStats const &stats,
+                               bool process_wide) {
+  jsi::Object result(rt);
+  result.setProperty(rt, "queued", static_cast<double>(stats.queued));
+  result.setProperty(rt, "running", static_cast<double>(stats.running));
+  result.setProperty(rt, "completed", static_cast<double>(stats.completed));
+  result.setProperty(rt, "expired", static_cast<double>(stats.expired));
+  result.setProperty(rt, "waitP50Ms", stats.wait_p50_ms);
+  result.setProperty(rt, "waitP95Ms", stats.wait_p95_ms);
+  result.setProperty(rt, "waitP99Ms", stats.wait_p99_ms);
+  result.setProperty(rt, "waitMaxMs", stats.wait_max_ms);
+  result.setProperty(rt, "busyMs", stats.busy_ms);
+  if (process_wide) {
+    result.setProperty(rt, "threads", static_cast<double>(stats.threads));
+    result.setProperty(rt, "busyThreads",
+                       static_cast<double>(stats.busy_threads));
+    result.setProperty(rt, "waitingDatabases",
+                       static_cast<double>(stats.waiting_databases));
+  }
+  return result;
+}
+
+// Skips lambda when the token is already cancelled. Once lambda ran, its
+// result stands: a cancellation only replaces the error of a lambda that
+// failed, most likely because it was interrupted. Reporting work that
+// completed (a committed write) as cancelled would invite a retry that
+// repeats it.
+std::any run_with_token(std::function<std::any()> const &lambda,
+                        std::shared_ptr<QueryToken> const &token) {
+  if (token == nullptr) {
+    return lambda();
+  }
+
+  if (!token->start()) {
+    throw std::runtime_error(token->error());
+  }
+
+  std::any result;
+  try {
+    result = lambda();
+  } catch (std::exception &) {
+    token->finish();
+    // Most likely SQLITE_INTERRUPT, report why it was interrupted instead
+    if (token->is_cancelled()) {
+      throw std::runtime_error(token->error());
+    }
+    throw;
+  }
+  token->finish();
+  return result;
+}
+
 jsi::Value
 promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
           std::function<std::any()> lambda,
           std::function<jsi::Value(jsi::Runtime &rt, std::any result)>
-              resolve_callback) {
+              resolve_callback,
+          Priority priority, std::shared_ptr<QueryToken> token,
+          bool read_only) {
   auto promise_constructor = rt.global().getPropertyAsFunction(rt, "Promise");
 
   auto executor =
-      HFN3(lambda = std::move(lambda),
-           resolve_callback = std::move(resolve_callback), thread_pool) {
+      HFN6(lambda = std::move(lambda),
+           resolve_callback = std::move(resolve_callback), thread_pool,
+           priority, token, read_only) {
     auto resolve = std::make_shared<jsi::Value>(rt, args[0]);
     auto reject = std::make_shared<jsi::Value>(rt, args[1]);
 
@@ -429,13 +2006,13 @@ promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
 
     auto task = [lambda = lambda, resolve_callback = resolve_callback,
                  resolve = std::move(resolve), reject = std::move(reject),
-                 invoker, alive]() {
+                 invoker, alive, token = token]() {
       if (invoker == nullptr) {
         return;
       }
 
       try {
-        std::any result = lambda();
+        std::any result = run_with_token(lambda, token);
 
         // This generation is gone. Posting now would schedule onto a runtime
         // that is being torn down, where asFunction() sees an already
@@ -448,7 +2025,11 @@ promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
         // so it can be safely disposed on the JS thread
         invoker->invokeAsync(
             [result = std::move(result), resolve = resolve, reject = reject,
-             resolve_callback = resolve_callback](jsi::Runtime &rt) mutable {
+             resolve_callback = resolve_callback,
+             token = token](jsi::Runtime &rt) mutable {
+              if (token != nullptr) {
+                token->settled(rt);
+              }
               auto jsi_result = resolve_callback(rt, std::move(result));
               resolve->asObject(rt).asFunction(rt).call(rt, jsi_result);
             });
@@ -465,7 +2046,10 @@ promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
           return;
         }
         invoker->invokeAsync([what = std::string(what), resolve = resolve,
-                              reject = reject](jsi::Runtime &rt) {
+                              reject = reject, token = token](jsi::Runtime &rt) {
+          if (token != nullptr) {
+            token->settled(rt);
+          }
           auto errorCtr = rt.global().getPropertyAsFunction(rt, "Error");
           auto error = errorCtr.callAsConstructor(
               rt, jsi::String::createFromAscii(rt, what));
@@ -479,7 +2063,10 @@ promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
         // resolve is also captured in the invokeAsync lambda
         // so it can be safely disposed on the JS thread
         invoker->invokeAsync([what = std::string(what), resolve = resolve,
-                              reject = reject](jsi::Runtime &rt) {
+                              reject = reject, token = token](jsi::Runtime &rt) {
+          if (token != nullptr) {
+            token->settled(rt);
+          }
           auto errorCtr = rt.global().getPropertyAsFunction(rt, "Error");
           auto error = errorCtr.callAsConstructor(
               rt, jsi::String::createFromAscii(rt, what));
@@ -488,7 +2075,19 @@ promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool,
       }
     };
 
-    thread_pool->queue_work(task);
+    if (token == nullptr) {
+      thread_pool->queue_work(task, priority, Clock::time_point::max(), nullptr,
+                              read_only);
+    } else {
+      // Past its deadline the task only rejects, with the token's error
+      thread_pool->queue_work(
+          task, priority, token->deadline(),
+          [task, token = token]() {
+            token->cancel(QueryToken::Reason::Expired);
+            task();
+          },
+          read_only);
+    }
 
     return jsi::Value(nullptr);
   });
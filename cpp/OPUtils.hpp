@@ -10,8 +10,10 @@
 #include <sqlite3.h>
 #endif
 #include <ReactCommon/CallInvoker.h>
+#include <functional>
 #include <string>
 #include <vector>
+#include "OPCancellation.hpp"
 #include "OPThreadPool.hpp"
 
 namespace opsqlite {
@@ -43,7 +45,48 @@ create_raw_result(jsi::Runtime &rt, const BridgeResult &status,
 void to_batch_arguments(jsi::Runtime &rt, jsi::Array const &batch_params,
                         std::vector<BatchArguments> *commands);
 
-BatchResult import_sql_file(sqlite3 *db, std::string path);
+// A single SELECT statement, judged from the text alone. Those are the
+// interactive queries a background batch lets run inside its transaction.
+bool is_select_statement(std::string const &sql);
+
+// BEGIN, COMMIT, END, ROLLBACK, SAVEPOINT or RELEASE, which
+// sqlite3_stmt_readonly reports as read only
+bool is_transaction_control(std::string const &sql);
+
+// Streams a SQL dump from disk. chunk_size > 0 commits every chunk_size
+// statements, 0 keeps the whole import in a single transaction.
+BatchResult import_sql_file(
+    sqlite3 *db, std::string const &path, int chunk_size = 0,
+    std::function<void(const ImportProgress &)> const &on_progress = nullptr);
+
+BatchResult import_data_file(
+    sqlite3 *db, std::string const &path, DataImportOptions const &options,
+    std::function<void(const ImportProgress &)> const &on_progress = nullptr);
+
+// Inserts every row of options.vectors as a float32 blob, e.g. into a
+// sqlite-vec table, through a single prepared statement
+BatchResult insert_vectors(
+    sqlite3 *db, VectorInsertOptions const &options,
+    std::function<void(const ImportProgress &)> const &on_progress = nullptr);
+
+// Row ids from a number[], Int32Array, Uint32Array or Float64Array
+std::vector<long long> to_row_ids(jsi::Runtime &rt, jsi::Value const &value);
+
+// First element of a typed array, its element count goes to length. Throws
+// when the underlying ArrayBuffer was detached or transferred.
+const uint8_t *typed_array_data(jsi::Runtime &rt, jsi::Object const &array,
+                                size_t element_size, size_t &length,
+                                std::string const &error_prefix);
+
+// Pragmas of one of the named open({ profile }) presets, without
+// journal_mode and synchronous for a read_only connection
+PragmaList get_pragma_profile(std::string const &name, bool read_only);
+
+// Throws unless name and value are safe to splice into a PRAGMA statement
+void validate_pragma(std::string const &name, std::string const &value);
+
+// Pragmas reported by getSettings, in the order profiles apply them
+std::vector<std::string> const &get_settings_pragmas();
 
 bool folder_exists(const std::string &name);
 
@@ -51,9 +94,28 @@ bool file_exists(const std::string &path);
 
 void log_to_console(jsi::Runtime &rt, const std::string &message);
 
+// getQueueStats / getWorkerStats result, the worker fields only when
+// process_wide
+jsi::Object create_queue_stats(jsi::Runtime &rt, QueueStats const &stats,
+                               bool process_wide);
+
+// Parses the priority option of an execute call. Missing or undefined is
+// Priority::Normal.
+Priority to_priority(jsi::Runtime &rt, jsi::Value const &options,
+                     std::string const &function_name);
+
+// Token for the signal, timeoutMs and deadlineMs options of an execute call,
+// nullptr when none is given
+std::shared_ptr<QueryToken> to_query_token(jsi::Runtime &rt,
+                                           jsi::Value const &options,
+                                           std::string const &function_name,
+                                           std::function<void()> interrupt);
+
 jsi::Value
 promisify(jsi::Runtime &rt, std::shared_ptr<ThreadPool> thread_pool, std::function<std::any()> lambda,
           std::function<jsi::Value(jsi::Runtime &rt, std::any result)>
-              resolve_callback);
+              resolve_callback,
+          Priority priority = Priority::Normal,
+          std::shared_ptr<QueryToken> token = nullptr, bool read_only = false);
 
 } // namespace opsqlite
@@ -4,6 +4,9 @@
 #include "libsql.h"
 #include "OPLogs.h"
 #include "OPUtils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <unordered_map>
@@ -211,30 +214,39 @@ void opsqlite_libsql_bind_statement(libsql_stmt_t statement,
 
   for (int ii = 0; ii < size; ii++) {
     int index = ii + 1;
-    JSVariant value = values->at(ii);
-    int status;
-
-    if (std::holds_alternative<bool>(value)) {
-      status = libsql_bind_int(statement, index,
-                               static_cast<int>(std::get<bool>(value)), &err);
-    } else if (std::holds_alternative<int>(value)) {
-      status = libsql_bind_int(statement, index, std::get<int>(value), &err);
-    } else if (std::holds_alternative<long long>(value)) {
-      status =
-          libsql_bind_int(statement, index, std::get<long long>(value), &err);
-    } else if (std::holds_alternative<double>(value)) {
-      status =
-          libsql_bind_float(statement, index, std::get<double>(value), &err);
-    } else if (std::holds_alternative<std::string>(value)) {
-      std::string str = std::get<std::string>(value);
-      status = libsql_bind_string(statement, index, str.c_str(), &err);
-    } else if (std::holds_alternative<ArrayBuffer>(value)) {
-      ArrayBuffer buffer = std::get<ArrayBuffer>(value);
-      status = libsql_bind_blob(statement, index, buffer.data.get(),
-                                static_cast<int>(buffer.size), &err);
-    } else {
-      status = libsql_bind_null(statement, index, &err);
-    }
+    // Bound straight from the variant, libsql copies what it needs
+    const JSVariant &value = values->at(ii);
+
+    int status = std::visit(
+        [&](auto &&v) {
+          using T = std::decay_t<decltype(v)>;
+
+          if constexpr (std::is_same_v<T, bool>) {
+            return libsql_bind_int(statement, index, v ? 1 : 0, &err);
+          } else if constexpr (std::is_same_v<T, int> ||
+                               std::is_same_v<T, long> ||
+                               std::is_same_v<T, long long>) {
+            return libsql_bind_int(statement, index, static_cast<long long>(v),
+                                   &err);
+          } else if constexpr (std::is_same_v<T, double>) {
+            return libsql_bind_float(statement, index, v, &err);
+          } else if constexpr (std::is_same_v<T, std::string>) {
+            // libsql only takes text as a C string, a zero byte would
+            // silently cut it short
+            if (v.find('\0') != std::string::npos) {
+              throw std::runtime_error(
+                  "[op-sqlite] libsql can't bind text containing a zero "
+                  "byte, pass it as an ArrayBuffer instead");
+            }
+            return libsql_bind_string(statement, index, v.c_str(), &err);
+          } else if constexpr (std::is_same_v<T, ArrayBuffer>) {
+            return libsql_bind_blob(statement, index, v.data.get(),
+                                    static_cast<int>(v.size), &err);
+          } else {
+            return libsql_bind_null(statement, index, &err);
+          }
+        },
+        value);
 
     if (status != 0) {
       throw std::runtime_error(err);
@@ -742,6 +754,29 @@ opsqlite_libsql_execute_raw(DB const &db, std::string const &query,
           .column_names = std::move(column_names)};
 }
 
+namespace {
+
+// Commands that can produce rows. Everything else runs through
+// libsql_execute_stmt, which doesn't build a result set at all.
+bool may_return_rows(std::string const &sql) {
+  std::string upper(sql);
+  std::transform(upper.begin(), upper.end(), upper.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+
+  auto start = upper.find_first_not_of(" \t\r\n(");
+  if (start == std::string::npos) {
+    return false;
+  }
+  for (const char *keyword : {"SELECT", "WITH", "VALUES", "PRAGMA", "EXPLAIN"}) {
+    if (upper.compare(start, strlen(keyword), keyword) == 0) {
+      return true;
+    }
+  }
+  return upper.find("RETURNING") != std::string::npos;
+}
+
+} // namespace
+
 BatchResult
 opsqlite_libsql_execute_batch(DB const &db,
                               const std::vector<BatchArguments> *commands) {
@@ -750,26 +785,69 @@ opsqlite_libsql_execute_batch(DB const &db,
     throw std::runtime_error("No SQL commands provided");
   }
 
+  // Commands repeating the same SQL (the usual bulk insert) share one
+  // prepared statement, reset between runs
+  std::unordered_map<std::string, libsql_stmt_t> statements;
+  auto free_statements = [&statements]() {
+    for (auto &entry : statements) {
+      if (entry.second != nullptr) {
+        libsql_free_stmt(entry.second);
+      }
+    }
+    statements.clear();
+  };
+
   try {
     int affectedRows = 0;
-    // opsqlite_libsql_execute(db, "BEGIN EXCLUSIVE TRANSACTION", nullptr);
+    const char *err = nullptr;
     for (int i = 0; i < commandCount; i++) {
-      auto command = commands->at(i);
-      // We do not provide a datastructure to receive query data because
-      // we don't need/want to handle this results in a batch execution
-      auto result = opsqlite_libsql_execute(db, command.sql, &command.params);
-      affectedRows += result.affectedRows;
+      const auto &command = commands->at(i);
+
+      auto &stmt = statements[command.sql];
+      if (stmt == nullptr) {
+        stmt = opsqlite_libsql_prepare_statement(db, command.sql);
+      }
+
+      if (!command.params.empty()) {
+        opsqlite_libsql_bind_statement(stmt, &command.params);
+      }
+
+      // Rows of a batch are never returned, they are only stepped through
+      // (e.g. for INSERT ... RETURNING) and dropped
+      if (may_return_rows(command.sql)) {
+        libsql_rows_t rows;
+        if (libsql_query_stmt(stmt, &rows, &err) != 0) {
+          throw std::runtime_error(err);
+        }
+        libsql_row_t row = nullptr;
+        int status;
+        while ((status = libsql_next_row(rows, &row, &err)) == 0 &&
+               row != nullptr) {
+          libsql_free_row(row);
+          row = nullptr;
+        }
+        libsql_free_rows(rows);
+        // A statement failing while it steps (a constraint hit by a later
+        // row of INSERT ... RETURNING) only shows up here
+        if (status != 0) {
+          throw std::runtime_error(err != nullptr ? err : "libsql error");
+        }
+      } else if (libsql_execute_stmt(stmt, &err) != 0) {
+        throw std::runtime_error(err);
+      }
+
+      affectedRows += static_cast<int>(libsql_changes(db.c));
+      libsql_reset_stmt(stmt, &err);
     }
-    // opsqlite_libsql_execute(db, "COMMIT", nullptr);
+
+    free_statements();
     return BatchResult{
         .affectedRows = affectedRows,
         .commands = static_cast<int>(commandCount),
     };
-  } catch (std::exception &exc) {
-    // opsqlite_libsql_execute(db, "ROLLBACK", nullptr);
-    return BatchResult{
-        .message = exc.what(),
-    };
+  } catch (...) {
+    free_statements();
+    throw;
   }
 }
 
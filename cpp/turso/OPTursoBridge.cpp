@@ -3,6 +3,7 @@
 #include "OPSmartHostObject.hpp"
 #include "OPBridge.hpp"
 #include "OPUtils.hpp"
+#include "OPTursoHttp.hpp"
 
 #ifdef __APPLE__
 extern "C" {
@@ -16,25 +17,112 @@ extern "C" {
 }
 #endif
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
-#include <fstream>
 #include <functional>
+#include <list>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
+// Prepared statements kept per connection by execute(). Can be overridden
+// through sqliteFlags, 0 disables the cache.
+#ifndef OP_SQLITE_TURSO_STATEMENT_CACHE_SIZE
+#define OP_SQLITE_TURSO_STATEMENT_CACHE_SIZE 64
+#endif
+
 namespace opsqlite {
 
 namespace {
 
+// Statements of single statement queries, kept prepared between executions
+// and keyed by their SQL. The least recently used one goes once it is full.
+// A statement is taken out while it runs, so one that fails is simply not
+// put back. The JS thread (executeSync) and the worker share it.
+class StatementCache {
+public:
+  StatementCache() = default;
+  StatementCache(const StatementCache &) = delete;
+  StatementCache &operator=(const StatementCache &) = delete;
+  ~StatementCache() { clear(); }
+
+  // Null on a miss. generation is what put expects back, with it a statement
+  // that ran across a clear() is not cached again.
+  turso_statement_t *take(const std::string &sql, uint64_t &generation) {
+    std::lock_guard<std::mutex> g(mutex);
+    generation = current_generation;
+    auto entry = index.find(sql);
+    if (entry == index.end()) {
+      return nullptr;
+    }
+    auto *statement = entry->second->second;
+    entries.erase(entry->second);
+    index.erase(entry);
+    return statement;
+  }
+
+  // Expects a reset statement
+  void put(const std::string &sql, turso_statement_t *statement,
+           uint64_t generation) {
+    std::lock_guard<std::mutex> g(mutex);
+    if (OP_SQLITE_TURSO_STATEMENT_CACHE_SIZE <= 0 ||
+        generation != current_generation || index.count(sql) > 0) {
+      turso_statement_deinit(statement);
+      return;
+    }
+    if (entries.size() >= OP_SQLITE_TURSO_STATEMENT_CACHE_SIZE) {
+      turso_statement_deinit(entries.back().second);
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+    entries.emplace_front(sql, statement);
+    index[sql] = entries.begin();
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> g(mutex);
+    current_generation++;
+    for (auto &entry : entries) {
+      turso_statement_deinit(entry.second);
+    }
+    entries.clear();
+    index.clear();
+  }
+
+private:
+  using Entries = std::list<std::pair<std::string, turso_statement_t *>>;
+
+  std::mutex mutex;
+  // Bumped by every clear()
+  uint64_t current_generation = 0;
+  // Most recently used first
+  Entries entries;
+  std::unordered_map<std::string, Entries::iterator> index;
+};
+
 struct TursoDbHandle {
   const turso_database_t *database = nullptr;
   const turso_sync_database_t *sync_database = nullptr;
   const turso_connection_t *connection = nullptr;
   bool is_sync = false;
   std::string path;
+  // Remote of a sync database, where its HTTP requests go
+  std::string url;
+  std::string auth_token;
+  HttpClient http;
+  StatementCache statements;
 };
 
 struct TursoStmtHandle {
@@ -70,60 +158,149 @@ void throw_if_turso_error(turso_status_code_t code, const char *error,
                            (error != nullptr ? ": " + std::string(error) : ""));
 }
 
-std::vector<char> read_binary_file(const std::string &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file.is_open()) {
-    return {};
+// Files of a sync are passed on in slices of this size, so memory use doesn't
+// grow with the size of the database
+constexpr size_t file_slice_size = 4 * 1024 * 1024;
+
+std::string errno_message() { return std::strerror(errno); }
+
+// Hands the content of path to on_slice piece by piece. Reads go through
+// pread rather than an mmap, a file truncated while mapped would raise SIGBUS.
+// A missing file reads as empty, one that shrinks during the read throws.
+void read_file_slices(
+    const std::string &path,
+    const std::function<void(const char *data, size_t size)> &on_slice) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return;
+    }
+    throw std::runtime_error("[op-sqlite][turso] failed to open " + path +
+                             ": " + errno_message());
+  }
+
+  struct stat info = {};
+  if (::fstat(fd, &info) != 0) {
+    const auto message = errno_message();
+    ::close(fd);
+    throw std::runtime_error("[op-sqlite][turso] failed to stat " + path +
+                             ": " + message);
+  }
+  if (info.st_size <= 0) {
+    ::close(fd);
+    return;
   }
+  const auto size = static_cast<size_t>(info.st_size);
+
+  std::vector<char> buffer(std::min(file_slice_size, size));
+  size_t offset = 0;
+  while (offset < size) {
+    // Fill the whole slice, pread may return less than asked
+    const size_t length = std::min(buffer.size(), size - offset);
+    size_t filled = 0;
+    while (filled < length) {
+      const auto read =
+          ::pread(fd, buffer.data() + filled, length - filled,
+                  static_cast<off_t>(offset + filled));
+      if (read < 0 && errno == EINTR) {
+        continue;
+      }
+      if (read <= 0) {
+        const auto message =
+            read == 0 ? std::string("file was truncated while reading")
+                      : errno_message();
+        ::close(fd);
+        throw std::runtime_error("[op-sqlite][turso] failed to read " + path +
+                                 ": " + message);
+      }
+      filled += static_cast<size_t>(read);
+    }
 
-  file.seekg(0, std::ios::end);
-  const auto size = file.tellg();
-  if (size <= 0) {
-    return {};
+    try {
+      on_slice(buffer.data(), length);
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+    offset += length;
   }
+  ::close(fd);
+}
 
-  std::vector<char> content(static_cast<size_t>(size));
-  file.seekg(0, std::ios::beg);
-  file.read(content.data(), size);
-  return content;
+// Flushes fd to storage. On Apple fsync only reaches the drive cache.
+bool sync_fd(int fd) {
+#ifdef __APPLE__
+  if (::fcntl(fd, F_FULLFSYNC) == 0) {
+    return true;
+  }
+#endif
+  int result;
+  do {
+    result = ::fsync(fd);
+  } while (result != 0 && errno == EINTR);
+  return result == 0;
 }
 
+// Written to a temp file next to path, flushed, renamed over path, and the
+// rename flushed through the directory, so a crash leaves either the old or
+// the new content.
 void write_binary_file_atomic(const std::string &path, const char *data,
                               size_t size) {
   std::filesystem::path target(path);
-  std::filesystem::create_directories(target.parent_path());
+  if (target.has_parent_path()) {
+    std::filesystem::create_directories(target.parent_path());
+  }
 
-  const std::filesystem::path temp = target.string() + ".opsqlite.tmp";
+  const std::string temp = target.string() + ".opsqlite.tmp";
 
-  {
-    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
-    if (!file.is_open()) {
-      throw std::runtime_error(
-          "[op-sqlite][turso] failed to open temp file for write: " +
-          temp.string());
-    }
+  int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error(
+        "[op-sqlite][turso] failed to open temp file for write: " + temp +
+        ": " + errno_message());
+  }
 
-    if (size > 0) {
-      file.write(data, static_cast<std::streamsize>(size));
-    }
+  auto fail = [&](const std::string &message) {
+    const auto reason = errno_message();
+    ::close(fd);
+    ::unlink(temp.c_str());
+    throw std::runtime_error("[op-sqlite][turso] " + message + ": " + temp +
+                             ": " + reason);
+  };
 
-    if (!file.good()) {
-      throw std::runtime_error("[op-sqlite][turso] failed writing temp file: " +
-                               temp.string());
+  size_t offset = 0;
+  while (offset < size) {
+    const size_t length = std::min(file_slice_size, size - offset);
+    const auto written =
+        ::pwrite(fd, data + offset, length, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      fail("failed writing temp file");
     }
+    offset += static_cast<size_t>(written);
   }
 
-  std::error_code ec;
-  std::filesystem::rename(temp, target, ec);
-  if (ec) {
-    std::filesystem::remove(target, ec);
-    ec.clear();
-    std::filesystem::rename(temp, target, ec);
+  if (!sync_fd(fd)) {
+    fail("failed to flush temp file");
   }
+  ::close(fd);
 
-  if (ec) {
+  if (::rename(temp.c_str(), path.c_str()) != 0) {
+    const auto reason = errno_message();
+    ::unlink(temp.c_str());
     throw std::runtime_error(
-        "[op-sqlite][turso] failed to atomically replace file: " + path);
+        "[op-sqlite][turso] failed to atomically replace file: " + path +
+        ": " + reason);
+  }
+
+  const auto directory =
+      target.has_parent_path() ? target.parent_path().string() : ".";
+  int directory_fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+  if (directory_fd >= 0) {
+    sync_fd(directory_fd);
+    ::close(directory_fd);
   }
 }
 
@@ -161,17 +338,88 @@ void setup_turso_temp_dir(const std::string &db_path) {
   setenv("TEMP", temp_dir.c_str(), 1);
 }
 
-void process_sync_io_item(const turso_sync_io_item_t *item) {
-  const auto kind = turso_sync_database_io_request_kind(item);
+// HTTP requests of one drain served at the same time
+constexpr size_t max_concurrent_http = 4;
 
-  if (kind == TURSO_SYNC_IO_HTTP) {
-    std::string message = "[op-sqlite][turso] sync HTTP IO request is not "
-                          "supported by native op-sqlite Turso bridge yet";
+std::string slice_string(turso_slice_ref_t slice) {
+  return std::string(static_cast<const char *>(slice.ptr), slice.len);
+}
+
+// libsql:// and https:// remotes are the same server, the sync engine leaves
+// the scheme to whoever runs its requests
+std::string to_http_url(std::string url) {
+  const std::string libsql = "libsql://";
+  if (url.compare(0, libsql.size(), libsql) == 0) {
+    url = "https://" + url.substr(libsql.size());
+  }
+  while (!url.empty() && url.back() == '/') {
+    url.pop_back();
+  }
+  return url;
+}
+
+void process_http_item(TursoDbHandle *handle,
+                       const turso_sync_io_item_t *item) {
+  auto poison = [item](const std::string &message) {
     turso_slice_ref_t error = {.ptr = message.c_str(), .len = message.size()};
     turso_sync_database_io_poison(item, &error);
+  };
+
+  turso_sync_io_http_request_t request = {};
+  if (turso_sync_database_io_request_http(item, &request) != TURSO_OK) {
+    poison("failed to decode HTTP request");
     return;
   }
 
+  HttpRequest http_request;
+  http_request.method = slice_string(request.method);
+  auto base = request.url.len > 0 ? slice_string(request.url) : handle->url;
+  http_request.url = to_http_url(base) + slice_string(request.path);
+  http_request.body = static_cast<const char *>(request.body.ptr);
+  http_request.body_size = request.body.len;
+
+  bool has_authorization = false;
+  for (int32_t i = 0; i < request.headers; i++) {
+    turso_sync_io_http_header_t header = {};
+    if (turso_sync_database_io_request_http_header(item, i, &header) !=
+        TURSO_OK) {
+      poison("failed to decode HTTP request header");
+      return;
+    }
+    auto key = slice_string(header.key);
+    has_authorization = has_authorization || key == "Authorization" ||
+                        key == "authorization";
+    http_request.headers.emplace_back(std::move(key),
+                                      slice_string(header.value));
+  }
+  if (!has_authorization && !handle->auth_token.empty()) {
+    http_request.headers.emplace_back("Authorization",
+                                      "Bearer " + handle->auth_token);
+  }
+
+  try {
+    handle->http.send(
+        http_request,
+        [item](int status) {
+          if (turso_sync_database_io_status(item, status) != TURSO_OK) {
+            throw std::runtime_error("failed to set HTTP status");
+          }
+        },
+        [item](const char *data, size_t size) {
+          turso_slice_ref_t slice = {.ptr = data, .len = size};
+          if (turso_sync_database_io_push_buffer(item, &slice) != TURSO_OK) {
+            throw std::runtime_error("failed to push HTTP response data");
+          }
+        });
+    turso_sync_database_io_done(item);
+  } catch (const std::exception &e) {
+    poison(e.what());
+  }
+}
+
+void process_sync_io_item(const turso_sync_io_item_t *item) {
+  const auto kind = turso_sync_database_io_request_kind(item);
+
   if (kind == TURSO_SYNC_IO_FULL_READ) {
     turso_sync_io_full_read_request_t request = {};
     if (turso_sync_database_io_request_full_read(item, &request) != TURSO_OK) {
@@ -183,19 +431,21 @@ void process_sync_io_item(const turso_sync_io_item_t *item) {
 
     std::string path(static_cast<const char *>(request.path.ptr),
                      request.path.len);
-    auto buffer = read_binary_file(path);
-    if (!buffer.empty()) {
-      turso_slice_ref_t slice = {.ptr = buffer.data(), .len = buffer.size()};
-      if (turso_sync_database_io_push_buffer(item, &slice) != TURSO_OK) {
-        std::string message = "failed to push FULL_READ data";
-        turso_slice_ref_t error = {.ptr = message.c_str(),
-                                   .len = message.size()};
-        turso_sync_database_io_poison(item, &error);
-        return;
-      }
+
+    try {
+      read_file_slices(path, [item](const char *data, size_t size) {
+        turso_slice_ref_t slice = {.ptr = data, .len = size};
+        if (turso_sync_database_io_push_buffer(item, &slice) != TURSO_OK) {
+          throw std::runtime_error("failed to push FULL_READ data");
+        }
+      });
+      turso_sync_database_io_done(item);
+    } catch (const std::exception &e) {
+      const std::string message = e.what();
+      turso_slice_ref_t error = {.ptr = message.c_str(), .len = message.size()};
+      turso_sync_database_io_poison(item, &error);
     }
 
-    turso_sync_database_io_done(item);
     return;
   }
 
@@ -228,27 +478,62 @@ void process_sync_io_item(const turso_sync_io_item_t *item) {
   turso_sync_database_io_done(item);
 }
 
-void drain_sync_io(const turso_sync_database_t *db) {
+// Files are handled inline, HTTP requests several at a time since the sync
+// engine queues them independently of each other (e.g. the pages of a pull)
+void drain_sync_io(TursoDbHandle *handle) {
+  const auto *db = handle->sync_database;
   const char *error = nullptr;
+  std::vector<const turso_sync_io_item_t *> http_items;
+
+  auto serve_http = [handle, &http_items]() {
+    if (http_items.size() == 1) {
+      process_http_item(handle, http_items.front());
+    } else {
+      std::vector<std::thread> threads;
+      threads.reserve(http_items.size());
+      for (auto *item : http_items) {
+        threads.emplace_back(process_http_item, handle, item);
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+    for (auto *item : http_items) {
+      turso_sync_database_io_item_deinit(item);
+    }
+    http_items.clear();
+  };
 
   while (true) {
     const turso_sync_io_item_t *item = nullptr;
     const auto status = turso_sync_database_io_take_item(db, &item, &error);
+    if (status != TURSO_OK) {
+      serve_http();
+    }
     throw_if_turso_error(status, error, "take sync io item");
 
     if (item == nullptr) {
       break;
     }
 
+    if (turso_sync_database_io_request_kind(item) == TURSO_SYNC_IO_HTTP) {
+      http_items.push_back(item);
+      if (http_items.size() == max_concurrent_http) {
+        serve_http();
+      }
+      continue;
+    }
+
     process_sync_io_item(item);
     turso_sync_database_io_item_deinit(item);
   }
+  serve_http();
 
   throw_if_turso_error(turso_sync_database_io_step_callbacks(db, &error), error,
                        "step sync io callbacks");
 }
 
-void run_sync_operation(const turso_sync_database_t *db,
+void run_sync_operation(TursoDbHandle *handle,
                         const turso_sync_operation_t *operation) {
   const char *error = nullptr;
 
@@ -256,7 +541,7 @@ void run_sync_operation(const turso_sync_database_t *db,
     const auto status = turso_sync_operation_resume(operation, &error);
 
     if (status == TURSO_IO) {
-      drain_sync_io(db);
+      drain_sync_io(handle);
       continue;
     }
 
@@ -270,41 +555,87 @@ void run_sync_operation(const turso_sync_database_t *db,
 
 void bind_value(turso_statement_t *statement, size_t position,
                 const JSVariant &value) {
-  turso_status_code_t code = TURSO_OK;
-
-  if (std::holds_alternative<bool>(value)) {
-    code = turso_statement_bind_positional_int(statement, position,
-                                               std::get<bool>(value) ? 1 : 0);
-  } else if (std::holds_alternative<int>(value)) {
-    code = turso_statement_bind_positional_int(statement, position,
-                                               std::get<int>(value));
-  } else if (std::holds_alternative<long>(value)) {
-    code = turso_statement_bind_positional_int(statement, position,
-                                               std::get<long>(value));
-  } else if (std::holds_alternative<long long>(value)) {
-    code = turso_statement_bind_positional_int(statement, position,
-                                               std::get<long long>(value));
-  } else if (std::holds_alternative<double>(value)) {
-    code = turso_statement_bind_positional_double(statement, position,
-                                                  std::get<double>(value));
-  } else if (std::holds_alternative<std::string>(value)) {
-    const auto &str = std::get<std::string>(value);
-    code = turso_statement_bind_positional_text(statement, position,
-                                                str.c_str(), str.size());
-  } else if (std::holds_alternative<ArrayBuffer>(value)) {
-    const auto &blob = std::get<ArrayBuffer>(value);
-    code = turso_statement_bind_positional_blob(
-        statement, position, reinterpret_cast<const char *>(blob.data.get()),
-        blob.size);
-  } else {
-    code = turso_statement_bind_positional_null(statement, position);
-  }
+  auto code = std::visit(
+      [&](auto &&v) {
+        using T = std::decay_t<decltype(v)>;
+
+        if constexpr (std::is_same_v<T, bool>) {
+          return turso_statement_bind_positional_int(statement, position,
+                                                     v ? 1 : 0);
+        } else if constexpr (std::is_same_v<T, int> ||
+                             std::is_same_v<T, long> ||
+                             std::is_same_v<T, long long>) {
+          return turso_statement_bind_positional_int(
+              statement, position, static_cast<int64_t>(v));
+        } else if constexpr (std::is_same_v<T, double>) {
+          return turso_statement_bind_positional_double(statement, position,
+                                                        v);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          return turso_statement_bind_positional_text(statement, position,
+                                                      v.c_str(), v.size());
+        } else if constexpr (std::is_same_v<T, ArrayBuffer>) {
+          return turso_statement_bind_positional_blob(
+              statement, position, reinterpret_cast<const char *>(v.data.get()),
+              v.size);
+        } else {
+          return turso_statement_bind_positional_null(statement, position);
+        }
+      },
+      value);
 
   throw_if_turso_error(code, nullptr, "bind parameter");
 }
 
-void run_step_loop(turso_statement_t *statement,
-                   const std::function<void()> &on_row) {
+// A reused statement still holds the values of its previous run, parameters
+// past the given ones are set back to null
+void bind_params(turso_statement_t *statement,
+                 const std::vector<JSVariant> *params, bool reused) {
+  size_t count = params == nullptr ? 0 : params->size();
+  for (size_t i = 0; i < count; i++) {
+    bind_value(statement, i + 1, params->at(i));
+  }
+
+  if (reused) {
+    auto total = turso_statement_parameters_count(statement);
+    for (auto i = static_cast<int64_t>(count); i < total; i++) {
+      throw_if_turso_error(
+          turso_statement_bind_positional_null(statement, i + 1), nullptr,
+          "bind parameter");
+    }
+  }
+}
+
+// Value of column i of the current row. Integers come out as doubles, like
+// on every other backend.
+inline JSVariant read_column(turso_statement_t *statement, int i) {
+  switch (turso_statement_row_value_kind(statement, i)) {
+  case TURSO_TYPE_INTEGER:
+    return static_cast<double>(turso_statement_row_value_int(statement, i));
+  case TURSO_TYPE_REAL:
+    return turso_statement_row_value_double(statement, i);
+  case TURSO_TYPE_TEXT: {
+    auto size = turso_statement_row_value_bytes_count(statement, i);
+    auto ptr = turso_statement_row_value_bytes_ptr(statement, i);
+    return std::string(ptr, static_cast<size_t>(size));
+  }
+  case TURSO_TYPE_BLOB: {
+    auto size = static_cast<size_t>(
+        turso_statement_row_value_bytes_count(statement, i));
+    auto ptr = turso_statement_row_value_bytes_ptr(statement, i);
+    auto *data = new uint8_t[size];
+    memcpy(data, ptr, size);
+    return ArrayBuffer{.data = std::shared_ptr<uint8_t[]>{data}, .size = size};
+  }
+  case TURSO_TYPE_NULL:
+  case TURSO_TYPE_UNKNOWN:
+  default:
+    return nullptr;
+  }
+}
+
+// Templated on the row callback so the per row call can be inlined
+template <typename OnRow>
+void run_step_loop(turso_statement_t *statement, OnRow &&on_row) {
   const char *error = nullptr;
 
   while (true) {
@@ -342,6 +673,35 @@ void reset_statement(turso_statement_t *statement) {
   throw_if_turso_error(code, error, "reset statement");
 }
 
+bool is_blank(const std::string &query, size_t offset) {
+  return query.find_first_not_of(" \t\r\n;", offset) == std::string::npos;
+}
+
+// First word of the statement at offset, upper cased
+std::string leading_keyword(const std::string &query, size_t offset) {
+  std::string keyword;
+  auto i = query.find_first_not_of(" \t\r\n;(", offset);
+  while (i < query.size() &&
+         std::isalpha(static_cast<unsigned char>(query[i]))) {
+    keyword += static_cast<char>(
+        std::toupper(static_cast<unsigned char>(query[i])));
+    i++;
+  }
+  return keyword;
+}
+
+// Statements worth keeping prepared, plain reads and writes
+bool is_cacheable_keyword(const std::string &keyword) {
+  return keyword == "SELECT" || keyword == "INSERT" || keyword == "UPDATE" ||
+         keyword == "DELETE" || keyword == "REPLACE" || keyword == "WITH" ||
+         keyword == "VALUES";
+}
+
+bool changes_schema(const std::string &keyword) {
+  return keyword == "CREATE" || keyword == "DROP" || keyword == "ALTER" ||
+         keyword == "ATTACH" || keyword == "DETACH";
+}
+
 } // namespace
 
 void opsqlite_bind_statement(sqlite3_stmt *statement,
@@ -433,10 +793,12 @@ sqlite3 *opsqlite_open(std::string const &name, std::string const &path,
 
 sqlite3 *opsqlite_open_sync(std::string const &name, std::string const &path,
                             std::string const &url,
-                            [[maybe_unused]] std::string const &auth_token,
+                            std::string const &auth_token,
                             std::string const &remote_encryption_key) {
   auto *handle = new TursoDbHandle();
   handle->path = opsqlite_get_db_path(name, path);
+  handle->url = url;
+  handle->auth_token = auth_token;
   setup_turso_temp_dir(handle->path);
 
   turso_database_config_t db_config = {
@@ -473,19 +835,20 @@ sqlite3 *opsqlite_open_sync(std::string const &name, std::string const &path,
     throw_if_turso_error(turso_sync_database_new(&db_config, &sync_config,
                                                  &sync_database, &error),
                          error, "create sync database at " + handle->path);
+    handle->sync_database = sync_database;
 
     const turso_sync_operation_t *open_operation = nullptr;
     throw_if_turso_error(
         turso_sync_database_create(sync_database, &open_operation, &error),
         error, "open/create sync database at " + handle->path);
-    run_sync_operation(sync_database, open_operation);
+    run_sync_operation(handle, open_operation);
     turso_sync_operation_deinit(open_operation);
 
     const turso_sync_operation_t *connect_operation = nullptr;
     throw_if_turso_error(
         turso_sync_database_connect(sync_database, &connect_operation, &error),
         error, "connect sync database at " + handle->path);
-    run_sync_operation(sync_database, connect_operation);
+    run_sync_operation(handle, connect_operation);
 
     if (turso_sync_operation_result_kind(connect_operation) !=
         TURSO_ASYNC_RESULT_CONNECTION) {
@@ -501,7 +864,6 @@ sqlite3 *opsqlite_open_sync(std::string const &name, std::string const &path,
     turso_sync_operation_deinit(connect_operation);
 
     handle->database = nullptr;
-    handle->sync_database = sync_database;
     handle->connection = connection;
     handle->is_sync = true;
   } catch (...) {
@@ -536,6 +898,9 @@ void opsqlite_close(sqlite3 *db) {
     return;
   }
 
+  // Statements go before the connection they belong to
+  handle->statements.clear();
+
   if (handle->connection != nullptr) {
     turso_connection_deinit(handle->connection);
     handle->connection = nullptr;
@@ -554,7 +919,15 @@ void opsqlite_close(sqlite3 *db) {
   delete handle;
 }
 
-void opsqlite_sync(sqlite3 *db) {
+void opsqlite_sync(
+    sqlite3 *db,
+    std::function<void(const std::string &phase)> const &on_phase) {
+  auto report = [&on_phase](const char *phase) {
+    if (on_phase) {
+      on_phase(phase);
+    }
+  };
+
   auto *handle = to_turso_db(db);
   if (handle == nullptr || handle->sync_database == nullptr) {
     throw std::runtime_error(
@@ -563,18 +936,20 @@ void opsqlite_sync(sqlite3 *db) {
 
   const char *error = nullptr;
 
+  report("push");
   const turso_sync_operation_t *push_operation = nullptr;
   throw_if_turso_error(turso_sync_database_push_changes(
                            handle->sync_database, &push_operation, &error),
                        error, "push sync changes");
-  run_sync_operation(handle->sync_database, push_operation);
+  run_sync_operation(handle, push_operation);
   turso_sync_operation_deinit(push_operation);
 
+  report("pull");
   const turso_sync_operation_t *wait_operation = nullptr;
   throw_if_turso_error(turso_sync_database_wait_changes(
                            handle->sync_database, &wait_operation, &error),
                        error, "wait sync changes");
-  run_sync_operation(handle->sync_database, wait_operation);
+  run_sync_operation(handle, wait_operation);
 
   const turso_sync_changes_t *changes = nullptr;
   throw_if_turso_error(
@@ -583,12 +958,13 @@ void opsqlite_sync(sqlite3 *db) {
   turso_sync_operation_deinit(wait_operation);
 
   if (changes != nullptr) {
+    report("apply");
     const turso_sync_operation_t *apply_operation = nullptr;
     throw_if_turso_error(
         turso_sync_database_apply_changes(handle->sync_database, changes,
                                           &apply_operation, &error),
         error, "apply sync changes");
-    run_sync_operation(handle->sync_database, apply_operation);
+    run_sync_operation(handle, apply_operation);
     turso_sync_operation_deinit(apply_operation);
   }
 }
@@ -657,52 +1033,21 @@ BridgeResult opsqlite_execute_prepared_statement(
   auto *db_handle = to_turso_db(db);
   auto *stmt = to_turso_stmt(statement);
   int changes = 0;
+  const int col_count =
+      static_cast<int>(turso_statement_column_count(stmt->statement));
 
   run_step_loop(stmt->statement, [&]() {
     if (results == nullptr) {
       return;
     }
 
-    int col_count =
-        static_cast<int>(turso_statement_column_count(stmt->statement));
     DumbHostObject row = DumbHostObject(metadatas);
-
+    row.values.reserve(static_cast<size_t>(col_count));
     for (int i = 0; i < col_count; i++) {
-      auto kind = turso_statement_row_value_kind(stmt->statement, i);
-
-      switch (kind) {
-      case TURSO_TYPE_INTEGER:
-        row.values.emplace_back(static_cast<double>(
-            turso_statement_row_value_int(stmt->statement, i)));
-        break;
-      case TURSO_TYPE_REAL:
-        row.values.emplace_back(
-            turso_statement_row_value_double(stmt->statement, i));
-        break;
-      case TURSO_TYPE_TEXT: {
-        auto size = turso_statement_row_value_bytes_count(stmt->statement, i);
-        auto ptr = turso_statement_row_value_bytes_ptr(stmt->statement, i);
-        row.values.emplace_back(std::string(ptr, static_cast<size_t>(size)));
-        break;
-      }
-      case TURSO_TYPE_BLOB: {
-        auto size = turso_statement_row_value_bytes_count(stmt->statement, i);
-        auto ptr = turso_statement_row_value_bytes_ptr(stmt->statement, i);
-        auto *data = new uint8_t[static_cast<size_t>(size)];
-        memcpy(data, ptr, static_cast<size_t>(size));
-        row.values.emplace_back(
-            ArrayBuffer{.data = std::shared_ptr<uint8_t[]>{data},
-                        .size = static_cast<size_t>(size)});
-        break;
-      }
-      case TURSO_TYPE_NULL:
-      case TURSO_TYPE_UNKNOWN:
-      default:
-        row.values.emplace_back(nullptr);
-      }
+      row.values.emplace_back(read_column(stmt->statement, i));
     }
 
-    results->emplace_back(row);
+    results->emplace_back(std::move(row));
   });
 
   if (metadatas != nullptr && metadatas->empty()) {
@@ -749,86 +1094,83 @@ BridgeResult opsqlite_execute(sqlite3 *db, std::string const &query,
 
   while (offset < query.size()) {
     const char *error = nullptr;
-    turso_statement_t *statement = nullptr;
-    size_t tail = 0;
-
-    auto code = turso_connection_prepare_first(
-        require_turso_connection(db_handle,
-                                 "prepare statement in batch execute"),
-        query.c_str() + offset, &statement, &tail, &error);
-    throw_if_turso_error(code, error, "prepare statement in batch execute");
-
-    if (tail == 0) {
-      break;
-    }
-
-    offset += tail;
+    const auto keyword = leading_keyword(query, offset);
+    const bool cacheable = offset == 0 && is_cacheable_keyword(keyword);
+
+    uint64_t generation = 0;
+    turso_statement_t *statement =
+        cacheable ? db_handle->statements.take(query, generation) : nullptr;
+    const bool reused = statement != nullptr;
+    // Only a query that is one statement as a whole goes back to the cache
+    bool single = reused;
+
+    if (reused) {
+      offset = query.size();
+    } else {
+      size_t tail = 0;
+      auto code = turso_connection_prepare_first(
+          require_turso_connection(db_handle,
+                                   "prepare statement in batch execute"),
+          query.c_str() + offset, &statement, &tail, &error);
+      throw_if_turso_error(code, error, "prepare statement in batch execute");
+
+      if (tail == 0) {
+        break;
+      }
 
-    if (statement == nullptr) {
-      continue;
-    }
+      offset += tail;
+      single = cacheable && is_blank(query, offset);
 
-    if (params != nullptr && !params->empty()) {
-      for (size_t i = 0; i < params->size(); i++) {
-        bind_value(statement, i + 1, params->at(i));
+      if (statement == nullptr) {
+        continue;
       }
     }
 
-    int col_count = static_cast<int>(turso_statement_column_count(statement));
-    if (column_names.empty() && col_count > 0) {
-      column_names.reserve(col_count);
-      for (int i = 0; i < col_count; i++) {
-        const char *name = turso_statement_column_name(statement, i);
-        column_names.emplace_back(name == nullptr ? "" : name);
-        if (name != nullptr) {
-          turso_str_deinit(name);
+    try {
+      bind_params(statement, params, reused);
+
+      int col_count =
+          static_cast<int>(turso_statement_column_count(statement));
+      if (column_names.empty() && col_count > 0) {
+        column_names.reserve(col_count);
+        for (int i = 0; i < col_count; i++) {
+          const char *name = turso_statement_column_name(statement, i);
+          column_names.emplace_back(name == nullptr ? "" : name);
+          if (name != nullptr) {
+            turso_str_deinit(name);
+          }
         }
       }
-    }
 
-    run_step_loop(statement, [&]() {
-      std::vector<JSVariant> row;
-      row.reserve(col_count);
-
-      for (int i = 0; i < col_count; i++) {
-        auto kind = turso_statement_row_value_kind(statement, i);
-        switch (kind) {
-        case TURSO_TYPE_INTEGER:
-          row.emplace_back(
-              static_cast<double>(turso_statement_row_value_int(statement, i)));
-          break;
-        case TURSO_TYPE_REAL:
-          row.emplace_back(turso_statement_row_value_double(statement, i));
-          break;
-        case TURSO_TYPE_TEXT: {
-          auto size = turso_statement_row_value_bytes_count(statement, i);
-          auto ptr = turso_statement_row_value_bytes_ptr(statement, i);
-          row.emplace_back(std::string(ptr, static_cast<size_t>(size)));
-          break;
-        }
-        case TURSO_TYPE_BLOB: {
-          auto size = turso_statement_row_value_bytes_count(statement, i);
-          auto ptr = turso_statement_row_value_bytes_ptr(statement, i);
-          auto *data = new uint8_t[static_cast<size_t>(size)];
-          memcpy(data, ptr, static_cast<size_t>(size));
-          row.emplace_back(ArrayBuffer{.data = std::shared_ptr<uint8_t[]>{data},
-                                       .size = static_cast<size_t>(size)});
-          break;
-        }
-        case TURSO_TYPE_NULL:
-        case TURSO_TYPE_UNKNOWN:
-        default:
-          row.emplace_back(nullptr);
-          break;
+      run_step_loop(statement, [&]() {
+        std::vector<JSVariant> row;
+        row.reserve(col_count);
+        for (int i = 0; i < col_count; i++) {
+          row.emplace_back(read_column(statement, i));
         }
-      }
+        rows.emplace_back(std::move(row));
+      });
 
-      rows.emplace_back(std::move(row));
-    });
+      changes = static_cast<int>(turso_statement_n_change(statement));
 
-    changes = static_cast<int>(turso_statement_n_change(statement));
+      if (single) {
+        reset_statement(statement);
+      }
+    } catch (...) {
+      turso_statement_deinit(statement);
+      throw;
+    }
+
+    if (single) {
+      db_handle->statements.put(query, statement, generation);
+    } else {
+      turso_statement_deinit(statement);
+    }
 
-    turso_statement_deinit(statement);
+    // Cached statements may point at what the schema change just altered
+    if (changes_schema(keyword)) {
+      db_handle->statements.clear();
+    }
   }
 
   return {.affectedRows = changes,
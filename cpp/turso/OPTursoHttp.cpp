@@ -0,0 +1,475 @@
+#include "OPTursoHttp.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+namespace opsqlite {
+
+namespace {
+
+// Attempts of one request, the waits between them double from the first
+constexpr int max_attempts = 3;
+constexpr int first_backoff_ms = 100;
+
+constexpr int send_timeout_s = 30;
+constexpr int receive_timeout_s = 60;
+
+// Idle connections kept per host
+constexpr size_t max_idle = 4;
+
+constexpr size_t read_size = 64 * 1024;
+
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+// A failure before the request was fully sent, worth another attempt. Once
+// it is out the server may have acted on it, so nothing after that is
+// retried but the statuses that say it was not processed.
+struct RetryableError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+bool is_loopback(const sockaddr *address) {
+  if (address->sa_family == AF_INET) {
+    auto ip = ntohl(reinterpret_cast<const sockaddr_in *>(address)->sin_addr.s_addr);
+    return (ip >> 24) == 127;
+  }
+  if (address->sa_family == AF_INET6) {
+    return IN6_IS_ADDR_LOOPBACK(
+        &reinterpret_cast<const sockaddr_in6 *>(address)->sin6_addr);
+  }
+  return false;
+}
+
+// The server closed an idle connection, or sent something unasked
+bool is_stale(int fd) {
+  char byte;
+  ssize_t received;
+  do {
+    received = ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  } while (received < 0 && errno == EINTR);
+  return received >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+// 429 and 503 mean the request was turned away. A gateway error (502, 504)
+// can come after the server applied it, so only requests that are safe to
+// repeat are retried then, never a sync push.
+bool is_retryable_status(int status, std::string const &method) {
+  if (status == 429 || status == 503) {
+    return true;
+  }
+  bool idempotent = method == "GET" || method == "HEAD" || method == "PUT" ||
+                    method == "DELETE" || method == "OPTIONS";
+  return idempotent && (status == 502 || status == 504);
+}
+
+std::string lowercase(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return text;
+}
+
+void send_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t sent = ::send(fd, data, size, send_flags);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      throw RetryableError(std::string("[op-sqlite][turso] HTTP send failed: ") +
+                           strerror(errno));
+    }
+    data += sent;
+    size -= static_cast<size_t>(sent);
+  }
+}
+
+// Buffered reads of one response
+class Reader {
+public:
+  explicit Reader(int fd) : fd(fd) {}
+
+  // False at the end of the stream
+  bool fill() {
+    if (pos == buffer.size()) {
+      buffer.clear();
+      pos = 0;
+    }
+    size_t old_size = buffer.size();
+    buffer.resize(old_size + read_size);
+    ssize_t received;
+    do {
+      received = ::recv(fd, &buffer[old_size], read_size, 0);
+    } while (received < 0 && errno == EINTR);
+    if (received < 0) {
+      buffer.resize(old_size);
+      throw std::runtime_error(std::string("[op-sqlite][turso] HTTP receive "
+                                           "failed: ") +
+                               strerror(errno));
+    }
+    buffer.resize(old_size + static_cast<size_t>(received));
+    return received > 0;
+  }
+
+  std::string read_line() {
+    while (true) {
+      auto end = buffer.find("\r\n", pos);
+      if (end != std::string::npos) {
+        std::string line = buffer.substr(pos, end - pos);
+        pos = end + 2;
+        return line;
+      }
+      if (!fill()) {
+        throw std::runtime_error("[op-sqlite][turso] HTTP connection closed "
+                                 "mid-response");
+      }
+    }
+  }
+
+  // Hands exactly size bytes to on_data, as they arrive
+  void read_body(size_t size,
+                 const std::function<void(const char *, size_t)> &on_data) {
+    while (size > 0) {
+      if (pos == buffer.size() && !fill()) {
+        throw std::runtime_error("[op-sqlite][turso] HTTP connection closed "
+                                 "mid-body");
+      }
+      size_t piece = std::min(size, buffer.size() - pos);
+      on_data(buffer.data() + pos, piece);
+      pos += piece;
+      size -= piece;
+    }
+  }
+
+  void read_to_end(const std::function<void(const char *, size_t)> &on_data) {
+    while (true) {
+      if (pos < buffer.size()) {
+        on_data(buffer.data() + pos, buffer.size() - pos);
+        pos = buffer.size();
+      }
+      if (!fill()) {
+        return;
+      }
+    }
+  }
+
+  // Bytes read past the response, a connection with any can't be reused
+  bool has_leftover() const { return pos < buffer.size(); }
+
+private:
+  int fd;
+  std::string buffer;
+  size_t pos = 0;
+};
+
+} // namespace
+
+HttpClient::~HttpClient() {
+  for (auto &entry : idle) {
+    for (int fd : entry.second) {
+      ::close(fd);
+    }
+  }
+}
+
+HttpClient::Endpoint HttpClient::parse_url(const std::string &url) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) {
+    throw std::runtime_error(
+        "[op-sqlite][turso] sync HTTP IO request is not supported by native "
+        "op-sqlite Turso bridge yet, TLS is not available. Only http:// urls "
+        "of this device (e.g. a local TLS terminating proxy) are served: " +
+        url);
+  }
+
+  Endpoint endpoint;
+  auto authority_end = url.find('/', scheme.size());
+  std::string authority = url.substr(scheme.size(), authority_end == std::string::npos
+                                                        ? std::string::npos
+                                                        : authority_end - scheme.size());
+  endpoint.path =
+      authority_end == std::string::npos ? "/" : url.substr(authority_end);
+
+  // [v6]:port, host:port or host
+  auto port_sep = authority.rfind(':');
+  auto bracket = authority.rfind(']');
+  if (port_sep != std::string::npos &&
+      (bracket == std::string::npos || port_sep > bracket)) {
+    endpoint.host = authority.substr(0, port_sep);
+    endpoint.port = authority.substr(port_sep + 1);
+  } else {
+    endpoint.host = authority;
+    endpoint.port = "80";
+  }
+  if (endpoint.host.size() > 1 && endpoint.host.front() == '[') {
+    endpoint.host = endpoint.host.substr(1, endpoint.host.size() - 2);
+  }
+  if (endpoint.host.empty()) {
+    throw std::runtime_error("[op-sqlite][turso] Invalid sync url: " + url);
+  }
+
+  endpoint.key = authority;
+  return endpoint;
+}
+
+int HttpClient::connect_to(const Endpoint &endpoint) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo *addresses = nullptr;
+  int status = getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(),
+                           &hints, &addresses);
+  if (status != 0) {
+    throw RetryableError("[op-sqlite][turso] Could not resolve " +
+                         endpoint.host + ": " + gai_strerror(status));
+  }
+
+  int fd = -1;
+  int error = 0;
+  bool any_loopback = false;
+  for (auto *address = addresses; address != nullptr;
+       address = address->ai_next) {
+    // Without TLS the bearer token must not leave the device
+    if (!is_loopback(address->ai_addr)) {
+      continue;
+    }
+    any_loopback = true;
+    fd = ::socket(address->ai_family, address->ai_socktype,
+                  address->ai_protocol);
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    error = errno;
+    ::close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+
+  if (!any_loopback) {
+    throw std::runtime_error(
+        "[op-sqlite][turso] " + endpoint.host +
+        " is not a loopback address, plain http is only used on this device "
+        "since TLS is not available");
+  }
+  if (fd < 0) {
+    throw RetryableError("[op-sqlite][turso] Could not connect to " +
+                         endpoint.key + ": " + strerror(error));
+  }
+
+  timeval send_timeout{send_timeout_s, 0};
+  timeval receive_timeout{receive_timeout_s, 0};
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout,
+             sizeof(receive_timeout));
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+  return fd;
+}
+
+int HttpClient::take_idle(const Endpoint &endpoint) {
+  std::lock_guard<std::mutex> g(mutex);
+  auto entry = idle.find(endpoint.key);
+  if (entry == idle.end() || entry->second.empty()) {
+    return -1;
+  }
+  while (!entry->second.empty()) {
+    int fd = entry->second.back();
+    entry->second.pop_back();
+    if (!is_stale(fd)) {
+      return fd;
+    }
+    ::close(fd);
+  }
+  return -1;
+}
+
+void HttpClient::put_idle(const Endpoint &endpoint, int fd) {
+  {
+    std::lock_guard<std::mutex> g(mutex);
+    auto &connections = idle[endpoint.key];
+    if (connections.size() < max_idle) {
+      connections.push_back(fd);
+      return;
+    }
+  }
+  ::close(fd);
+}
+
+void HttpClient::send(
+    const HttpRequest &request,
+    const std::function<void(int status)> &on_status,
+    const std::function<void(const char *data, size_t size)> &on_body) {
+  auto endpoint = parse_url(request.url);
+
+  std::string head = request.method + " " + endpoint.path + " HTTP/1.1\r\n";
+  head += "Host: " + endpoint.key + "\r\n";
+  bool has_length = false;
+  for (auto const &header : request.headers) {
+    auto key = lowercase(header.first);
+    // Framing is ours to decide
+    if (key == "connection" || key == "host" || key == "transfer-encoding") {
+      continue;
+    }
+    has_length = has_length || key == "content-length";
+    head += header.first + ": " + header.second + "\r\n";
+  }
+  if (!has_length && (request.body_size > 0 || request.method == "POST" ||
+                      request.method == "PUT")) {
+    head += "Content-Length: " + std::to_string(request.body_size) + "\r\n";
+  }
+  head += "Connection: keep-alive\r\n\r\n";
+
+  int backoff_ms = first_backoff_ms;
+  int attempt = 1;
+  while (true) {
+    bool reused = true;
+    int fd = take_idle(endpoint);
+
+    try {
+      if (fd < 0) {
+        reused = false;
+        fd = connect_to(endpoint);
+      }
+
+      send_all(fd, head.data(), head.size());
+      if (request.body_size > 0) {
+        send_all(fd, request.body, request.body_size);
+      }
+
+      Reader reader(fd);
+      int status = 0;
+      long long content_length = -1;
+      bool chunked = false;
+      bool keep_alive = true;
+
+      // 1xx responses are followed by the real one
+      do {
+        auto status_line = reader.read_line();
+        auto first_space = status_line.find(' ');
+        if (status_line.compare(0, 5, "HTTP/") != 0 ||
+            first_space == std::string::npos) {
+          throw std::runtime_error(
+              "[op-sqlite][turso] Invalid HTTP status line: " + status_line);
+        }
+        status = std::atoi(status_line.c_str() + first_space + 1);
+        if (status_line.compare(0, 8, "HTTP/1.0") == 0) {
+          keep_alive = false;
+        }
+
+        content_length = -1;
+        chunked = false;
+        for (auto line = reader.read_line(); !line.empty();
+             line = reader.read_line()) {
+          auto colon = line.find(':');
+          if (colon == std::string::npos) {
+            continue;
+          }
+          auto key = lowercase(line.substr(0, colon));
+          auto value_start = line.find_first_not_of(" \t", colon + 1);
+          std::string value = value_start == std::string::npos
+                                  ? ""
+                                  : line.substr(value_start);
+          if (key == "content-length") {
+            content_length = std::atoll(value.c_str());
+          } else if (key == "transfer-encoding") {
+            chunked = lowercase(value).find("chunked") != std::string::npos;
+          } else if (key == "connection") {
+            auto lowered = lowercase(value);
+            if (lowered.find("close") != std::string::npos) {
+              keep_alive = false;
+            } else if (lowered.find("keep-alive") != std::string::npos) {
+              keep_alive = true;
+            }
+          }
+        }
+      } while (status >= 100 && status < 200);
+
+      bool no_body = request.method == "HEAD" || status == 204 || status == 304;
+
+      if (is_retryable_status(status, request.method) &&
+          attempt < max_attempts) {
+        ::close(fd);
+        fd = -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+        backoff_ms *= 2;
+        attempt++;
+        continue;
+      }
+
+      on_status(status);
+
+      if (no_body) {
+        // Nothing to read
+      } else if (chunked) {
+        while (true) {
+          auto size_line = reader.read_line();
+          size_t size = std::strtoull(size_line.c_str(), nullptr, 16);
+          if (size == 0) {
+            // Trailers up to the closing empty line
+            while (!reader.read_line().empty()) {
+            }
+            break;
+          }
+          reader.read_body(size, on_body);
+          reader.read_line();
+        }
+      } else if (content_length >= 0) {
+        reader.read_body(static_cast<size_t>(content_length), on_body);
+      } else {
+        reader.read_to_end(on_body);
+        keep_alive = false;
+      }
+
+      if (keep_alive && !reader.has_leftover()) {
+        put_idle(endpoint, fd);
+      } else {
+        ::close(fd);
+      }
+      return;
+    } catch (RetryableError &e) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      // The server dropped a pooled connection while it sat idle, that
+      // doesn't count as an attempt
+      if (reused) {
+        continue;
+      }
+      if (attempt >= max_attempts) {
+        throw std::runtime_error(e.what());
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+      backoff_ms *= 2;
+      attempt++;
+    } catch (...) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw;
+    }
+  }
+}
+
+} // namespace opsqlite
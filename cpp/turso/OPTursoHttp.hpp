@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace opsqlite {
+
+struct HttpRequest {
+  std::string method;
+  // http://host[:port]/path
+  std::string url;
+  std::vector<std::pair<std::string, std::string>> headers;
+  const char *body = nullptr;
+  size_t body_size = 0;
+};
+
+// HTTP/1.1 client for the requests of the Turso sync engine. Connections are
+// kept alive and reused per host, concurrent sends each take a connection of
+// their own. Plain http to loopback addresses only, there is no TLS library in
+// the build and the bearer token must not leave the device in the clear.
+class HttpClient {
+public:
+  HttpClient() = default;
+  HttpClient(const HttpClient &) = delete;
+  HttpClient &operator=(const HttpClient &) = delete;
+  // Closes the idle connections
+  ~HttpClient();
+
+  // on_status runs once the response headers arrived, on_body with every
+  // piece of the body as it is read. Failures to resolve, connect or send and
+  // 429/503 responses are retried with backoff, 502/504 only for idempotent
+  // methods. Nothing else is retried once the request went out, the server
+  // may have applied it.
+  // Throws once the retries are exhausted.
+  void send(const HttpRequest &request,
+            const std::function<void(int status)> &on_status,
+            const std::function<void(const char *data, size_t size)> &on_body);
+
+private:
+  struct Endpoint {
+    std::string host;
+    std::string port;
+    std::string path;
+    // host:port, key of the idle pool
+    std::string key;
+  };
+
+  static Endpoint parse_url(const std::string &url);
+  int connect_to(const Endpoint &endpoint);
+  // An idle connection to endpoint, or -1
+  int take_idle(const Endpoint &endpoint);
+  void put_idle(const Endpoint &endpoint, int fd);
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::vector<int>> idle;
+};
+
+} // namespace opsqlite
@@ -0,0 +1,4 @@
+CREATE TABLE LoadFileBroken (id INTEGER PRIMARY KEY);
+INSERT INTO LoadFileBroken (id) VALUES (1);
+INSERT INTO LoadFileMissing (id) VALUES (2);
+INSERT INTO LoadFileBroken (id) VALUES (3);
@@ -0,0 +1,5 @@
+CREATE TABLE LoadFileLines (id INTEGER PRIMARY KEY, name TEXT)
+INSERT INTO LoadFileLines (id, name) VALUES (1, 'one')
+INSERT INTO LoadFileLines (id, name) VALUES (2, 'two')
+
+INSERT INTO LoadFileLines (id, name) VALUES (3, 'three')
@@ -0,0 +1,14 @@
+-- Written by hand: a trigger, a statement over several lines, the dump's own
+-- transaction and a last statement without its semicolon
+BEGIN TRANSACTION;
+CREATE TABLE LoadFileItems (id INTEGER PRIMARY KEY, name TEXT, note TEXT);
+CREATE TABLE LoadFileLog (item_id INTEGER);
+CREATE TRIGGER LoadFileItemsInsert AFTER INSERT ON LoadFileItems
+BEGIN
+  INSERT INTO LoadFileLog (item_id) VALUES (new.id);
+END;
+INSERT INTO LoadFileItems (id, name, note) VALUES (1, 'semi;colon', 'it''s quoted');
+INSERT INTO LoadFileItems (id, name, note)
+VALUES (2, 'two', NULL);
+COMMIT;
+INSERT INTO LoadFileItems (id, name, note) VALUES (3, 'last', 'no semicolon')
@@ -1,7 +1,18 @@
 #include "tokenizers.h"
-#include <cctype>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <string_view>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OP_TOKENIZER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OP_TOKENIZER_SSE2 1
+#endif
 
 namespace opsqlite {
 
@@ -17,16 +28,527 @@ fts5_api *fts5_api_from_db(sqlite3 *db) {
   return pRet;
 }
 
+namespace {
+
+// Code point classification and folding
+
+struct Range {
+  char32_t first;
+  char32_t last;
+};
+
+// Code points above ASCII that separate tokens: punctuation, spaces, symbols,
+// arrows, box drawing, emoji... Letters, digits and marks of every script are
+// token characters. Sorted, looked up with a binary search.
+constexpr Range separator_ranges[] = {
+    {0x0080, 0x00A9},   {0x00AB, 0x00B1},   {0x00B4, 0x00B4},
+    {0x00B6, 0x00B8},   {0x00BB, 0x00BB},   {0x00BF, 0x00BF},
+    {0x00D7, 0x00D7},   {0x00F7, 0x00F7},   {0x037E, 0x037E},
+    {0x0387, 0x0387},   {0x055A, 0x055F},   {0x0589, 0x058A},
+    {0x05BE, 0x05BE},   {0x05C0, 0x05C0},   {0x05C3, 0x05C3},
+    {0x05C6, 0x05C6},   {0x05F3, 0x05F4},   {0x060C, 0x060D},
+    {0x061B, 0x061B},   {0x061D, 0x061F},   {0x066A, 0x066D},
+    {0x06D4, 0x06D4},   {0x0964, 0x0965},   {0x0970, 0x0970},
+    {0x0E4F, 0x0E4F},   {0x0E5A, 0x0E5B},   {0x2000, 0x200B},
+    {0x200E, 0x206F},   {0x20A0, 0x20CF},   {0x2190, 0x2BFF},
+    {0x2E00, 0x2E7F},   {0x3000, 0x3004},   {0x3008, 0x3020},
+    {0x3030, 0x3030},   {0x303D, 0x303F},   {0x30FB, 0x30FB},
+    {0xD800, 0xDFFF},   {0xFE10, 0xFE1F},   {0xFE30, 0xFE6F},
+    {0xFEFF, 0xFEFF},   {0xFF00, 0xFF0F},   {0xFF1A, 0xFF20},
+    {0xFF3B, 0xFF40},   {0xFF5B, 0xFF65},   {0xFFF0, 0xFFFF},
+    {0x1F000, 0x1FAFF}, {0xE0000, 0xE007F},
+};
+
+// Marks only ever extend a token, they never start one
+constexpr Range mark_ranges[] = {
+    {0x0300, 0x036F}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200C, 0x200D},
+    {0x20D0, 0x20FF}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F},
+};
+
+// The marks dropped along with the diacritics
+constexpr Range diacritic_ranges[] = {
+    {0x0300, 0x036F},
+    {0x1AB0, 0x1AFF},
+    {0x1DC0, 0x1DFF},
+    {0xFE20, 0xFE2F},
+};
+
+template <size_t N>
+bool in_ranges(const Range (&ranges)[N], char32_t c) {
+  auto it = std::upper_bound(
+      ranges, ranges + N, c,
+      [](char32_t value, const Range &range) { return value < range.first; });
+  return it != ranges && c <= (it - 1)->last;
+}
+
+// Base letters of U+00C0 to U+017F, '.' where there is none
+constexpr char latin_bases[] = "aaaaaa.ceeeeiiii"
+                               "dnooooo.ouuuuy.."
+                               "aaaaaa.ceeeeiiii"
+                               "dnooooo.ouuuuy.y"
+                               "aaaaaaccccccccdd"
+                               "ddeeeeeeeeeegggg"
+                               "gggghhhhiiiiiiii"
+                               "ii..jjkkklllllll"
+                               "lllnnnnnnn..oooo"
+                               "oo..rrrrrrssssss"
+                               "sstttttt"
+                               "uuuuuuuu"
+                               "uuuuwwyyyzzzzzzs";
+
+// Base letters of U+1EA0 to U+1EF9, the Vietnamese block
+constexpr char vietnamese_bases[] = "aaaaaaaaaaaaaaaaaaaaaaaa"
+                                    "eeeeeeeeeeeeeeee"
+                                    "iiii"
+                                    "oooooooooooooooooooooooo"
+                                    "uuuuuuuuuuuuuu"
+                                    "yyyyyyyy";
+
+// Simple case folding of the scripts written with case
+char32_t fold_case(char32_t c) {
+  if (c < 0x80) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+  }
+  if ((c >= 0x00C0 && c <= 0x00DE && c != 0x00D7)) {
+    return c + 32;
+  }
+  if (c >= 0x0100 && c <= 0x017F) {
+    if (c == 0x0130) {
+      return 'i';
+    }
+    if (c == 0x0178) {
+      return 0x00FF;
+    }
+    if (c == 0x017F) {
+      return 's';
+    }
+    bool even_upper = (c <= 0x0137) || (c >= 0x014A && c <= 0x0177);
+    bool odd_upper = (c >= 0x0139 && c <= 0x0148) || (c >= 0x0179);
+    if ((even_upper && c % 2 == 0) || (odd_upper && c % 2 == 1)) {
+      return c + 1;
+    }
+    return c;
+  }
+  if (c == 0x01A0 || c == 0x01AF) {
+    return c + 1;
+  }
+  if (c >= 0x0386 && c <= 0x03AB) {
+    if (c == 0x0386) {
+      return 0x03AC;
+    }
+    if (c >= 0x0388 && c <= 0x038A) {
+      return c + 37;
+    }
+    if (c == 0x038C) {
+      return 0x03CC;
+    }
+    if (c == 0x038E || c == 0x038F) {
+      return c + 63;
+    }
+    if (c >= 0x0391 && c != 0x03A2) {
+      return c + 32;
+    }
+    return c;
+  }
+  if (c == 0x03C2) {
+    return 0x03C3;
+  }
+  if (c >= 0x0400 && c <= 0x040F) {
+    return c + 80;
+  }
+  if (c >= 0x0410 && c <= 0x042F) {
+    return c + 32;
+  }
+  if ((c >= 0x0460 && c <= 0x0481) || (c >= 0x048A && c <= 0x04BF) ||
+      (c >= 0x04D0 && c <= 0x052F)) {
+    return c % 2 == 0 ? c + 1 : c;
+  }
+  if (c == 0x04C0) {
+    return 0x04CF;
+  }
+  if (c >= 0x04C1 && c <= 0x04CE) {
+    return c % 2 == 1 ? c + 1 : c;
+  }
+  if (c >= 0x0531 && c <= 0x0556) {
+    return c + 48;
+  }
+  if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF)) {
+    return c % 2 == 0 ? c + 1 : c;
+  }
+  if (c == 0x1E9E) {
+    return 0x00DF;
+  }
+  if (c >= 0xFF21 && c <= 0xFF3A) {
+    return c + 32;
+  }
+  return c;
+}
+
+// Base letter of an already folded code point, or the code point itself
+char32_t remove_diacritic(char32_t c) {
+  if (c >= 0x00C0 && c <= 0x017F) {
+    char base = latin_bases[c - 0x00C0];
+    return base == '.' ? c : static_cast<char32_t>(base);
+  }
+  if (c == 0x01A1) {
+    return 'o';
+  }
+  if (c == 0x01B0) {
+    return 'u';
+  }
+  if (c >= 0x1EA0 && c <= 0x1EF9) {
+    return static_cast<char32_t>(vietnamese_bases[c - 0x1EA0]);
+  }
+  switch (c) {
+  case 0x03AC:
+    return 0x03B1;
+  case 0x03AD:
+    return 0x03B5;
+  case 0x03AE:
+    return 0x03B7;
+  case 0x03AF:
+  case 0x0390:
+  case 0x03CA:
+    return 0x03B9;
+  case 0x03CC:
+    return 0x03BF;
+  case 0x03CD:
+  case 0x03B0:
+  case 0x03CB:
+    return 0x03C5;
+  case 0x03CE:
+    return 0x03C9;
+  case 0x0451:
+    return 0x0435;
+  case 0x0439:
+    return 0x0438;
+  default:
+    return c;
+  }
+}
+
+// Decodes the code point at text[i], advancing i. Malformed sequences come
+// out as U+FFFD one byte at a time, which separates tokens.
+char32_t decode_utf8(const unsigned char *text, int length, int &i) {
+  unsigned char lead = text[i];
+  int count;
+  char32_t c;
+  char32_t min;
+  if (lead >= 0xF0 && lead <= 0xF4) {
+    count = 3;
+    c = lead & 0x07;
+    min = 0x10000;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    count = 2;
+    c = lead & 0x0F;
+    min = 0x800;
+  } else if (lead >= 0xC2 && lead <= 0xDF) {
+    count = 1;
+    c = lead & 0x1F;
+    min = 0x80;
+  } else {
+    i++;
+    return 0xFFFD;
+  }
+
+  for (int k = 1; k <= count; k++) {
+    if (i + k >= length || (text[i + k] & 0xC0) != 0x80) {
+      i++;
+      return 0xFFFD;
+    }
+    c = (c << 6) | (text[i + k] & 0x3F);
+  }
+  if (c < min || c > 0x10FFFF) {
+    i++;
+    return 0xFFFD;
+  }
+  i += count + 1;
+  return c;
+}
+
+void append_utf8(std::string &out, char32_t c) {
+  if (c < 0x80) {
+    out.push_back(static_cast<char>(c));
+  } else if (c < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+    out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  } else if (c < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+}
+
+// ASCII fast path
+
+inline bool is_ascii_word(unsigned char c) {
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
+
+// Bit i of each mask describes byte i of the 16 bytes at p
+struct AsciiMasks {
+  uint32_t word;
+  uint32_t upper;
+  uint32_t ascii;
+};
+
+inline AsciiMasks classify16(const unsigned char *p) {
+#if defined(OP_TOKENIZER_SSE2)
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  // Unsigned x - low < n, done on signed bytes by flipping the top bit
+  auto in_range = [&](__m128i x, char low, char n) {
+    __m128i shifted = _mm_xor_si128(_mm_sub_epi8(x, _mm_set1_epi8(low)), bias);
+    return _mm_cmplt_epi8(shifted,
+                          _mm_set1_epi8(static_cast<char>(n ^ 0x80)));
+  };
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i letter = in_range(lower, 'a', 26);
+  __m128i digit = in_range(v, '0', 10);
+  __m128i upper = in_range(v, 'A', 26);
+  return {static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(letter, digit))),
+          static_cast<uint32_t>(_mm_movemask_epi8(upper)),
+          static_cast<uint32_t>(~_mm_movemask_epi8(v)) & 0xFFFF};
+#elif defined(OP_TOKENIZER_NEON)
+  const uint8x16_t v = vld1q_u8(p);
+  auto in_range = [](uint8x16_t x, uint8_t low, uint8_t n) {
+    return vcltq_u8(vsubq_u8(x, vdupq_n_u8(low)), vdupq_n_u8(n));
+  };
+  uint8x16_t letter = in_range(vorrq_u8(v, vdupq_n_u8(0x20)), 'a', 26);
+  uint8x16_t digit = in_range(v, '0', 10);
+  uint8x16_t upper = in_range(v, 'A', 26);
+  uint8x16_t ascii = vcltq_u8(v, vdupq_n_u8(0x80));
+  // Movemask: keep one bit per byte and add each half up
+  static const uint8_t bit_values[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                         1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t bits = vld1q_u8(bit_values);
+  auto movemask = [&](uint8x16_t mask) {
+    uint8x16_t masked = vandq_u8(mask, bits);
+    return static_cast<uint32_t>(vaddv_u8(vget_low_u8(masked))) |
+           (static_cast<uint32_t>(vaddv_u8(vget_high_u8(masked))) << 8);
+  };
+  return {movemask(vorrq_u8(letter, digit)), movemask(upper), movemask(ascii)};
+#else
+  AsciiMasks masks = {0, 0, 0};
+  for (int k = 0; k < 16; k++) {
+    if (is_ascii_word(p[k])) {
+      masks.word |= 1u << k;
+    }
+    if (p[k] >= 'A' && p[k] <= 'Z') {
+      masks.upper |= 1u << k;
+    }
+    if (p[k] < 0x80) {
+      masks.ascii |= 1u << k;
+    }
+  }
+  return masks;
+#endif
+}
+
+// Trailing zero count of a non zero mask
+inline int first_bit(uint32_t mask) { return __builtin_ctz(mask); }
+
+// Tokenizer
+
+enum class Diacritics { Keep, Remove, Colocated };
+
+using TokenCallback = int (*)(void *, int, const char *, int, int, int);
+
+} // namespace
+
+// Splits on everything that isn't a letter, digit or mark of any script,
+// case folds, and by default drops diacritics ("Café" -> "cafe"). ASCII is
+// classified 16 bytes at a time. Arguments:
+//   remove_diacritics 0|1|colocated  colocated keeps the accented form and
+//                                    adds the plain one at the same position,
+//                                    so "café" finds only café while "cafe"
+//                                    finds both
+// Prefix queries (and prefix= indexes) need nothing special, the prefix is
+// folded like any other token.
 class WordTokenizer {
 public:
   WordTokenizer() = default;
   ~WordTokenizer() = default;
+
+  Diacritics diacritics = Diacritics::Remove;
+
+  int tokenize(void *ctx, int flags, const char *text, int length,
+               TokenCallback on_token);
+
+private:
+  // Folded token, and the one without diacritics in colocated mode
+  std::string folded;
+  std::string plain;
 };
 
+int WordTokenizer::tokenize(void *ctx, int flags, const char *text, int length,
+                            TokenCallback on_token) {
+  const auto *p = reinterpret_cast<const unsigned char *>(text);
+  // Only documents get the colocated form, queries match either one anyway
+  const bool colocate = diacritics == Diacritics::Colocated &&
+                        (flags & FTS5_TOKENIZE_DOCUMENT) != 0;
+  const bool strip = diacritics == Diacritics::Remove;
+
+  int i = 0;
+  while (i < length) {
+    // Skip separators, whole ASCII chunks at once
+    if (p[i] < 0x80) {
+      if (!is_ascii_word(p[i])) {
+        while (i + 16 <= length) {
+          auto masks = classify16(p + i);
+          uint32_t separators = masks.ascii & ~masks.word;
+          if (separators != 0xFFFF) {
+            i += first_bit(~separators);
+            break;
+          }
+          i += 16;
+        }
+        while (i < length && p[i] < 0x80 && !is_ascii_word(p[i])) {
+          i++;
+        }
+        continue;
+      }
+    } else {
+      int next = i;
+      char32_t c = decode_utf8(p, length, next);
+      if (in_ranges(separator_ranges, c) || in_ranges(mark_ranges, c)) {
+        i = next;
+        continue;
+      }
+    }
+
+    // A token starts at i. While it is lowercase ASCII it is passed to FTS5
+    // straight from the text, it is only copied once something changes.
+    const int start = i;
+    bool copied = false;
+    bool differs = false;
+    auto copy = [&](int end) {
+      if (!copied) {
+        folded.assign(text + start, static_cast<size_t>(end - start));
+        plain.assign(folded);
+        copied = true;
+      }
+    };
+
+    while (i < length) {
+      if (p[i] < 0x80) {
+        if (!is_ascii_word(p[i])) {
+          break;
+        }
+        int run_start = i;
+        uint32_t upper = 0;
+        while (i + 16 <= length) {
+          auto masks = classify16(p + i);
+          if (masks.word == 0xFFFF) {
+            upper |= masks.upper;
+            i += 16;
+            if (upper != 0) {
+              break;
+            }
+            continue;
+          }
+          int run = first_bit(~masks.word);
+          upper |= masks.upper & ((1u << run) - 1);
+          i += run;
+          break;
+        }
+        if (i + 16 > length) {
+          while (i < length && is_ascii_word(p[i])) {
+            upper |= static_cast<uint32_t>(p[i] >= 'A' && p[i] <= 'Z');
+            i++;
+          }
+        }
+
+        if (upper == 0 && !copied) {
+          continue;
+        }
+        copy(run_start);
+        for (int k = run_start; k < i; k++) {
+          char c = static_cast<char>(p[k] >= 'A' && p[k] <= 'Z' ? p[k] + 32
+                                                                  : p[k]);
+          folded.push_back(c);
+          plain.push_back(c);
+        }
+        continue;
+      }
+
+      int next = i;
+      char32_t c = decode_utf8(p, length, next);
+      bool is_mark = in_ranges(mark_ranges, c);
+      if (!is_mark && in_ranges(separator_ranges, c)) {
+        break;
+      }
+
+      copy(i);
+      if (is_mark) {
+        if (in_ranges(diacritic_ranges, c)) {
+          differs = true;
+          if (!strip) {
+            append_utf8(folded, c);
+          }
+        } else {
+          append_utf8(folded, c);
+          append_utf8(plain, c);
+        }
+      } else {
+        char32_t lower = fold_case(c);
+        char32_t base = remove_diacritic(lower);
+        differs = differs || base != lower;
+        append_utf8(folded, strip ? base : lower);
+        append_utf8(plain, base);
+      }
+      i = next;
+    }
+
+    const char *token = copied ? folded.data() : text + start;
+    int token_length =
+        copied ? static_cast<int>(folded.size()) : i - start;
+    if (token_length == 0) {
+      // Only marks dropped with the diacritics
+      continue;
+    }
+
+    int rc = on_token(ctx, 0, token, token_length, start, i);
+    if (rc != SQLITE_OK) {
+      return rc;
+    }
+    if (colocate && differs && !plain.empty()) {
+      rc = on_token(ctx, FTS5_TOKEN_COLOCATED, plain.data(),
+                    static_cast<int>(plain.size()), start, i);
+      if (rc != SQLITE_OK) {
+        return rc;
+      }
+    }
+  }
+  return SQLITE_OK;
+}
+
 // Define `xCreate`, which initializes the tokenizer
 int wordTokenizerCreate(void *pUnused, const char **azArg, int nArg,
                         Fts5Tokenizer **ppOut) {
   auto tokenizer = std::make_unique<WordTokenizer>();
+
+  for (int i = 0; i < nArg; i += 2) {
+    if (i + 1 >= nArg || strcmp(azArg[i], "remove_diacritics") != 0) {
+      return SQLITE_ERROR;
+    }
+    const char *value = azArg[i + 1];
+    if (strcmp(value, "0") == 0) {
+      tokenizer->diacritics = Diacritics::Keep;
+    } else if (strcmp(value, "1") == 0) {
+      tokenizer->diacritics = Diacritics::Remove;
+    } else if (strcmp(value, "colocated") == 0) {
+      tokenizer->diacritics = Diacritics::Colocated;
+    } else {
+      return SQLITE_ERROR;
+    }
+  }
+
   *ppOut = reinterpret_cast<Fts5Tokenizer *>(
       tokenizer.release()); // Cast to Fts5Tokenizer*
   return SQLITE_OK;
@@ -42,23 +564,437 @@ int wordTokenizerTokenize(Fts5Tokenizer *pTokenizer, void *pCtx, int flags,
                           const char *pText, int nText,
                           int (*xToken)(void *, int, const char *, int, int,
                                         int)) {
-  int start = 0;
-  int i = 0;
+  return reinterpret_cast<WordTokenizer *>(pTokenizer)
+      ->tokenize(pCtx, flags, pText, nText, xToken);
+}
+
+namespace {
+
+// Stemming
+
+namespace english {
+
+// The Snowball English stemmer (Porter2), https://snowballstem.org. Works on
+// lowercase ASCII, a 'Y' marks a y that is a consonant.
+
+bool is_vowel(char c) {
+  return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u' || c == 'y';
+}
+
+// Most suffixes are ruled out by their last letter alone
+inline bool ends_with(const std::string &word, std::string_view suffix) {
+  size_t n = word.size();
+  size_t k = suffix.size();
+  return n >= k && word[n - 1] == suffix[k - 1] &&
+         memcmp(word.data() + n - k, suffix.data(), k) == 0;
+}
 
-  while (i <= nText) {
-    if (i == nText || !std::isalnum(static_cast<unsigned char>(pText[i]))) {
-      if (start < i) { // Found a token
-        int rc = xToken(pCtx, 0, pText + start, i - start, start, i);
-        if (rc != SQLITE_OK)
-          return rc;
+bool has_vowel(const std::string &word, size_t end) {
+  return std::any_of(word.begin(), word.begin() + end, is_vowel);
+}
+
+// Start of the region after the first non vowel following a vowel, looking
+// from `from` on
+size_t region_after(const std::string &word, size_t from) {
+  for (size_t i = from + 1; i < word.size(); i++) {
+    if (is_vowel(word[i - 1]) && !is_vowel(word[i])) {
+      return i + 1;
+    }
+  }
+  return word.size();
+}
+
+// Whether word[0, end) ends in a short syllable
+bool ends_short(const std::string &word, size_t end) {
+  if (end >= 3) {
+    char last = word[end - 1];
+    if (!is_vowel(word[end - 3]) && is_vowel(word[end - 2]) &&
+        !is_vowel(last) && last != 'w' && last != 'x' && last != 'Y') {
+      return true;
+    }
+  }
+  if (end == 2 && is_vowel(word[0]) && !is_vowel(word[1])) {
+    return true;
+  }
+  return end >= 4 && word.compare(end - 4, 4, "past") == 0;
+}
+
+enum class Condition { None, AfterL, AfterValidLi, AfterSOrT, InR2 };
+
+struct Rule {
+  std::string_view suffix;
+  std::string_view replacement;
+  Condition condition = Condition::None;
+};
+
+// Each table is sorted longest suffix first, only the longest suffix that
+// matches is considered
+constexpr Rule step2_rules[] = {
+    {"ational", "ate"}, {"fulness", "ful"}, {"iveness", "ive"},
+    {"ization", "ize"}, {"ousness", "ous"}, {"biliti", "ble"},
+    {"lessli", "less"}, {"tional", "tion"}, {"alism", "al"},
+    {"aliti", "al"},    {"ation", "ate"},   {"entli", "ent"},
+    {"fulli", "ful"},   {"iviti", "ive"},   {"ogist", "og"},
+    {"ousli", "ous"},   {"abli", "able"},   {"alli", "al"},
+    {"anci", "ance"},   {"ator", "ate"},    {"enci", "ence"},
+    {"izer", "ize"},    {"bli", "ble"},     {"ogi", "og", Condition::AfterL},
+    {"li", "", Condition::AfterValidLi},
+};
+
+constexpr Rule step3_rules[] = {
+    {"ational", "ate"}, {"tional", "tion"}, {"alize", "al"},
+    {"ative", "", Condition::InR2},         {"icate", "ic"},
+    {"iciti", "ic"},    {"ical", "ic"},     {"ness", ""},
+    {"ful", ""},
+};
+
+constexpr Rule step4_rules[] = {
+    {"ement", ""}, {"able", ""}, {"ance", ""}, {"ence", ""},
+    {"ible", ""},  {"ment", ""}, {"ant", ""},  {"ate", ""},
+    {"ent", ""},   {"ion", "", Condition::AfterSOrT},
+    {"ism", ""},   {"iti", ""},  {"ive", ""},  {"ize", ""},
+    {"ous", ""},   {"al", ""},   {"er", ""},   {"ic", ""},
+};
+
+struct Exception {
+  std::string_view word;
+  std::string_view stem;
+};
+
+constexpr Exception exceptions[] = {
+    {"andes", "andes"}, {"atlas", "atlas"},   {"bias", "bias"},
+    {"cosmos", "cosmos"}, {"early", "earli"}, {"gently", "gentl"},
+    {"howe", "howe"},   {"idly", "idl"},      {"news", "news"},
+    {"only", "onli"},   {"singly", "singl"},  {"skies", "sky"},
+    {"skis", "ski"},    {"sky", "sky"},       {"ugly", "ugli"},
+};
+
+// R1 starts right after these
+constexpr std::string_view region_prefixes[] = {
+    "arsen", "commun", "emerg", "gener", "inter",
+    "later", "organ",  "past",  "univers",
+};
+
+// Bit c - 'a' is set when one of the suffixes ends with c
+template <size_t N> constexpr uint32_t last_letters(const Rule (&rules)[N]) {
+  uint32_t mask = 0;
+  for (const auto &rule : rules) {
+    mask |= 1u << (rule.suffix.back() - 'a');
+  }
+  return mask;
+}
+
+// Replaces the longest suffix of the rules if it starts at or after region
+template <const auto &rules>
+void replace_longest(std::string &word, size_t region, size_t r2) {
+  constexpr uint32_t mask = last_letters(rules);
+  char last = word.empty() ? '\0' : word.back();
+  if (last < 'a' || last > 'z' || (mask & (1u << (last - 'a'))) == 0) {
+    return;
+  }
+  for (const auto &rule : rules) {
+    if (!ends_with(word, rule.suffix)) {
+      continue;
+    }
+    size_t start = word.size() - rule.suffix.size();
+    if (start < region) {
+      return;
+    }
+    char before = start > 0 ? word[start - 1] : '\0';
+    switch (rule.condition) {
+    case Condition::None:
+      break;
+    case Condition::AfterL:
+      if (before != 'l') {
+        return;
+      }
+      break;
+    case Condition::AfterValidLi:
+      if (before == '\0' || strchr("cdeghkmnrt", before) == nullptr) {
+        return;
+      }
+      break;
+    case Condition::AfterSOrT:
+      if (before != 's' && before != 't') {
+        return;
       }
-      start = i + 1;
+      break;
+    case Condition::InR2:
+      if (start < r2) {
+        return;
+      }
+      break;
+    }
+    word.replace(start, std::string::npos, rule.replacement);
+    return;
+  }
+}
+
+void step1a(std::string &word) {
+  if (ends_with(word, "'s'")) {
+    word.resize(word.size() - 3);
+  } else if (ends_with(word, "'s")) {
+    word.resize(word.size() - 2);
+  } else if (ends_with(word, "'")) {
+    word.resize(word.size() - 1);
+  }
+
+  if (ends_with(word, "sses")) {
+    word.resize(word.size() - 2);
+  } else if (ends_with(word, "ied") || ends_with(word, "ies")) {
+    size_t start = word.size() - 3;
+    word.replace(start, std::string::npos, start > 1 ? "i" : "ie");
+  } else if (ends_with(word, "ss") || ends_with(word, "us")) {
+    return;
+  } else if (ends_with(word, "s") && word.size() >= 2 &&
+             has_vowel(word, word.size() - 2)) {
+    word.pop_back();
+  }
+}
+
+void step1b(std::string &word, size_t r1) {
+  constexpr std::string_view suffixes[] = {"eedly", "ingly", "edly",
+                                           "eed",   "ing",   "ed"};
+  std::string_view suffix;
+  for (auto candidate : suffixes) {
+    if (ends_with(word, candidate)) {
+      suffix = candidate;
+      break;
     }
-    i++;
   }
+  if (suffix.empty()) {
+    return;
+  }
+  size_t start = word.size() - suffix.size();
+  std::string_view stem(word.data(), start);
+
+  if (suffix == "eed" || suffix == "eedly") {
+    if (start >= r1 && stem != "succ" && stem != "proc" && stem != "exc") {
+      word.replace(start, std::string::npos, "ee");
+    }
+    return;
+  }
+  if (suffix == "ing") {
+    // dying, lying, tying
+    if (stem.size() == 2 && stem[1] == 'y' && !is_vowel(stem[0])) {
+      word.replace(1, std::string::npos, "ie");
+      return;
+    }
+    if (stem == "even" || stem == "cann" || stem == "inn" || stem == "earr" ||
+        stem == "herr" || stem == "out") {
+      return;
+    }
+  }
+  if (!has_vowel(word, start)) {
+    return;
+  }
+
+  word.resize(start);
+  if (ends_with(word, "at") || ends_with(word, "bl") || ends_with(word, "iz")) {
+    word.push_back('e');
+    return;
+  }
+  size_t n = word.size();
+  if (n >= 2 && word[n - 1] == word[n - 2] &&
+      strchr("bdfgmnprt", word[n - 1]) != nullptr) {
+    if (n == 3 && strchr("aeo", word[0]) != nullptr) {
+      return;
+    }
+    word.pop_back();
+    return;
+  }
+  if (n == r1 && ends_short(word, n)) {
+    word.push_back('e');
+  }
+}
+
+void step1c(std::string &word) {
+  size_t n = word.size();
+  if (n > 2 && (word[n - 1] == 'y' || word[n - 1] == 'Y') &&
+      !is_vowel(word[n - 2])) {
+    word[n - 1] = 'i';
+  }
+}
+
+void step5(std::string &word, size_t r1, size_t r2) {
+  if (word.empty()) {
+    return;
+  }
+  size_t last = word.size() - 1;
+  if (word[last] == 'e') {
+    if (last >= r2 || (last >= r1 && !ends_short(word, last))) {
+      word.pop_back();
+    }
+  } else if (word[last] == 'l') {
+    if (last >= r2 && last > 0 && word[last - 1] == 'l') {
+      word.pop_back();
+    }
+  }
+}
+
+void stem(std::string &word) {
+  // None of the exceptions is longer than 6 letters
+  for (const auto &exception : exceptions) {
+    if (word.size() <= 6 && word == exception.word) {
+      word.assign(exception.stem);
+      return;
+    }
+  }
+  if (word.size() < 3) {
+    return;
+  }
+
+  if (word[0] == '\'') {
+    word.erase(0, 1);
+  }
+  for (size_t i = 0; i < word.size(); i++) {
+    if (word[i] == 'y' && (i == 0 || is_vowel(word[i - 1]))) {
+      word[i] = 'Y';
+    }
+  }
+
+  size_t r1 = std::string::npos;
+  for (auto prefix : region_prefixes) {
+    if (word.compare(0, prefix.size(), prefix) == 0) {
+      r1 = prefix.size();
+      break;
+    }
+  }
+  if (r1 == std::string::npos) {
+    r1 = region_after(word, 0);
+  }
+  size_t r2 = region_after(word, r1);
+
+  step1a(word);
+  step1b(word, r1);
+  step1c(word);
+  replace_longest<step2_rules>(word, r1, r2);
+  replace_longest<step3_rules>(word, r1, r2);
+  replace_longest<step4_rules>(word, r2, r2);
+  step5(word, r1, r2);
+
+  std::replace(word.begin(), word.end(), 'Y', 'y');
+}
+
+} // namespace english
+
+// Stemmers by name, picked with the `language` argument. A stemmer gets a
+// lowercase ASCII word and rewrites it in place.
+struct Language {
+  const char *name;
+  void (*stem)(std::string &word);
+};
+
+constexpr Language languages[] = {
+    {"english", english::stem},
+};
+
+// Longer tokens are passed on as they are
+constexpr int max_stem_length = 64;
+
+} // namespace
+
+// Stems the tokens of another tokenizer, so "running", "runs" and "run" all
+// become "run". Arguments:
+//   [language english] [parent [parent arguments...]]
+// The parent defaults to wordtokenizer, e.g. 'portertokenizer' or
+// 'portertokenizer unicode61 remove_diacritics 2'. Tokens with anything but
+// ASCII letters and apostrophes in them are not stemmed.
+class PorterTokenizer {
+public:
+  PorterTokenizer() = default;
+  ~PorterTokenizer() {
+    if (parent != nullptr) {
+      parent_api.xDelete(parent);
+    }
+  }
+
+  void (*stem)(std::string &word) = nullptr;
+  fts5_tokenizer parent_api{};
+  Fts5Tokenizer *parent = nullptr;
+
+  int tokenize(void *ctx, int flags, const char *text, int length,
+               TokenCallback on_token) {
+    this->ctx = ctx;
+    this->on_token = on_token;
+    return parent_api.xTokenize(parent, this, flags, text, length,
+                                on_parent_token);
+  }
+
+private:
+  static int on_parent_token(void *self, int flags, const char *token,
+                             int length, int start, int end) {
+    auto *tokenizer = static_cast<PorterTokenizer *>(self);
+    bool stemmable = length <= max_stem_length;
+    for (int i = 0; stemmable && i < length; i++) {
+      stemmable = (token[i] >= 'a' && token[i] <= 'z') || token[i] == '\'';
+    }
+    if (!stemmable) {
+      return tokenizer->on_token(tokenizer->ctx, flags, token, length, start,
+                                 end);
+    }
+    std::string &word = tokenizer->word;
+    word.assign(token, static_cast<size_t>(length));
+    tokenizer->stem(word);
+    return tokenizer->on_token(tokenizer->ctx, flags, word.data(),
+                               static_cast<int>(word.size()), start, end);
+  }
+
+  void *ctx = nullptr;
+  TokenCallback on_token = nullptr;
+  std::string word;
+};
+
+// pContext is the fts5_api, used to look up the parent tokenizer
+int porterTokenizerCreate(void *pContext, const char **azArg, int nArg,
+                          Fts5Tokenizer **ppOut) {
+  auto *ftsApi = static_cast<fts5_api *>(pContext);
+  auto tokenizer = std::make_unique<PorterTokenizer>();
+
+  int i = 0;
+  const char *language = "english";
+  if (nArg >= 2 && strcmp(azArg[0], "language") == 0) {
+    language = azArg[1];
+    i = 2;
+  }
+  for (const auto &candidate : languages) {
+    if (strcmp(candidate.name, language) == 0) {
+      tokenizer->stem = candidate.stem;
+    }
+  }
+  if (tokenizer->stem == nullptr) {
+    return SQLITE_ERROR;
+  }
+
+  const char *parent_name = i < nArg ? azArg[i++] : "wordtokenizer";
+  void *parent_context = nullptr;
+  int rc = ftsApi->xFindTokenizer(ftsApi, parent_name, &parent_context,
+                                  &tokenizer->parent_api);
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+  rc = tokenizer->parent_api.xCreate(parent_context, azArg + i, nArg - i,
+                                     &tokenizer->parent);
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+
+  *ppOut = reinterpret_cast<Fts5Tokenizer *>(tokenizer.release());
   return SQLITE_OK;
 }
 
+void porterTokenizerDelete(Fts5Tokenizer *pTokenizer) {
+  delete reinterpret_cast<PorterTokenizer *>(pTokenizer);
+}
+
+int porterTokenizerTokenize(Fts5Tokenizer *pTokenizer, void *pCtx, int flags,
+                            const char *pText, int nText,
+                            int (*xToken)(void *, int, const char *, int, int,
+                                          int)) {
+  return reinterpret_cast<PorterTokenizer *>(pTokenizer)
+      ->tokenize(pCtx, flags, pText, nText, xToken);
+}
+
 int opsqlite_wordtokenizer_init(sqlite3 *db, char **error,
                                 sqlite3_api_routines const *api) {
   fts5_tokenizer wordtokenizer = {wordTokenizerCreate, wordTokenizerDelete,
@@ -74,14 +1010,14 @@ int opsqlite_wordtokenizer_init(sqlite3 *db, char **error,
 
 int opsqlite_porter_init(sqlite3 *db, char **error,
                          sqlite3_api_routines const *api) {
-  fts5_tokenizer porter_tokenizer = {wordTokenizerCreate, wordTokenizerDelete,
-                                     wordTokenizerTokenize};
+  fts5_tokenizer porter_tokenizer = {
+      porterTokenizerCreate, porterTokenizerDelete, porterTokenizerTokenize};
 
   fts5_api *ftsApi = (fts5_api *)fts5_api_from_db(db);
   if (ftsApi == nullptr)
     return SQLITE_ERROR;
 
-  return ftsApi->xCreateTokenizer(ftsApi, "portertokenizer", NULL,
+  return ftsApi->xCreateTokenizer(ftsApi, "portertokenizer", ftsApi,
                                   &porter_tokenizer, NULL);
 }
 
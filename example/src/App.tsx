@@ -5,7 +5,13 @@ import {
 } from "@op-engineering/op-test";
 import { useEffect, useState } from "react";
 import "./tests"; // import all tests to register them
-import {performanceTest, performanceTestAsync, insertTest} from './performance_test';
+import {
+	backendComparisonTest,
+	bulkTextInsertTest,
+	insertTest,
+	performanceTest,
+	performanceTestAsync,
+} from './performance_test';
 import { StyleSheet, Text, View } from "react-native";
 import { SafeAreaProvider, SafeAreaView } from "react-native-safe-area-context";
 // import {open} from '@op-engineering/op-sqlite';
@@ -14,6 +20,10 @@ export default function App() {
 	const [results, setResults] = useState<any>(null);
 	const [perfResult, setPerfResult] = useState<number>(0);
 	const [perfResultAsync, setPerfResultAsync] = useState<number>(0);
+	const [bulkTextResult, setBulkTextResult] = useState<number>(0);
+	const [comparisonResult, setComparisonResult] = useState<ReturnType<
+		typeof backendComparisonTest
+	> | null>(null);
 	const [openTime, setOpenTime] = useState(0);
 
 	useEffect(() => {
@@ -48,6 +58,9 @@ export default function App() {
 			      // global?.gc?.();
 			      // let perfResAsync = await performanceTestAsync();
 			      // setPerfResultAsync(perfResAsync);
+
+			      setComparisonResult(backendComparisonTest());
+			      setBulkTextResult(bulkTextInsertTest());
 			    } catch (e) {
 			      // intentionally left blank
 			    }
@@ -96,6 +109,18 @@ export default function App() {
 					<Text style={styles.performanceText}>
 						perf test (async) time: {perfResultAsync.toFixed(0)} ms
 					</Text>
+					<Text style={styles.performanceText}>
+						bulk text insert time: {bulkTextResult.toFixed(0)} ms
+					</Text>
+					{comparisonResult && (
+						<Text style={styles.performanceText}>
+							backend comparison (µs/call): insert{" "}
+							{comparisonResult.insert.toFixed(1)}, point read{" "}
+							{comparisonResult.pointRead.toFixed(1)}, range read{" "}
+							{comparisonResult.rangeRead.toFixed(1)}, update{" "}
+							{comparisonResult.update.toFixed(1)}
+						</Text>
+					)}
 				</View>
 				<View style={styles.results}>{displayResults(results)}</View>
 			</SafeAreaView>
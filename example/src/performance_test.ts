@@ -105,3 +105,77 @@ export function insertTest() {
 
   return performance.now() - t;
 }
+
+// Same workload on every backend, build the example once with `turso: true`
+// and once without to compare the Turso bridge with the plain SQLite one.
+// Returns the average time of one call of each kind, in microseconds.
+export function backendComparisonTest() {
+  const db = open({
+    name: 'backendComparison.sqlite',
+  });
+
+  db.executeSync('DROP TABLE IF EXISTS comparison');
+  db.executeSync(
+    'CREATE TABLE comparison (id INTEGER PRIMARY KEY, name TEXT, value REAL, data BLOB)',
+  );
+
+  const blob = new Uint8Array(64).fill(7).buffer;
+  const time = (iterations: number, fn: (i: number) => void) => {
+    const start = performance.now();
+    for (let i = 0; i < iterations; i++) {
+      fn(i);
+    }
+    return ((performance.now() - start) * 1000) / iterations;
+  };
+
+  db.executeSync('BEGIN');
+  const insert = time(ITERATIONS * 10, i => {
+    db.executeSync('INSERT INTO comparison VALUES (?, ?, ?, ?)', [
+      i,
+      `name ${i}`,
+      i * 1.5,
+      blob,
+    ]);
+  });
+  db.executeSync('COMMIT');
+
+  const pointRead = time(ITERATIONS * 10, i => {
+    db.executeSync('SELECT * FROM comparison WHERE id = ?', [i]);
+  });
+
+  const rangeRead = time(ITERATIONS, i => {
+    db.executeSync('SELECT * FROM comparison WHERE id >= ? LIMIT 100', [i]);
+  });
+
+  const update = time(ITERATIONS, i => {
+    db.executeSync('UPDATE comparison SET value = ? WHERE id = ?', [i, i]);
+  });
+
+  db.close();
+  return {insert, pointRead, rangeRead, update};
+}
+
+// Bulk insert of text parameters, the bind path of every backend
+export function bulkTextInsertTest() {
+  const db = open({
+    name: 'bulkTextInsert.sqlite',
+  });
+
+  db.executeSync('DROP TABLE IF EXISTS text_bench');
+  db.executeSync('CREATE TABLE text_bench (id INTEGER PRIMARY KEY, a TEXT, b TEXT)');
+
+  const text = 'x'.repeat(256);
+  const start = performance.now();
+  db.executeSync('BEGIN');
+  for (let i = 0; i < ITERATIONS * 10; i++) {
+    db.executeSync('INSERT INTO text_bench (a, b) VALUES (?, ?)', [
+      `${i} ${text}`,
+      text,
+    ]);
+  }
+  db.executeSync('COMMIT');
+  const elapsed = performance.now() - start;
+
+  db.close();
+  return elapsed;
+}
@@ -1,4 +1,4 @@
-import { type DB, open } from "@op-engineering/op-sqlite";
+import { type DB, isLibsql, isTurso, open } from "@op-engineering/op-sqlite";
 import {
 	afterAll,
 	beforeEach,
@@ -129,4 +129,95 @@ describe("Blobs", () => {
 		const finalUint8 = new Uint8Array(result.rows[0]!.content as any);
 		expect(finalUint8[0]).toBe(52);
 	});
+
+	it("Inserts vectors from a Float32Array", async () => {
+		if (isLibsql() || isTurso()) {
+			return;
+		}
+
+		await db.execute("DROP TABLE IF EXISTS VectorTable;");
+		await db.execute(
+			"CREATE TABLE VectorTable (id INTEGER PRIMARY KEY, embedding BLOB);",
+		);
+
+		// A view in the middle of a larger buffer, rows are sliced from it
+		const all = new Float32Array(2 + 3 * 4);
+		for (let i = 0; i < all.length; i++) {
+			all[i] = i * 0.5;
+		}
+		const vectors = all.subarray(2);
+
+		const { rowsAffected } = await db.insertVectors(
+			"VectorTable",
+			new Int32Array([10, 20, 30]),
+			vectors,
+			4,
+			{ chunkSize: 2 },
+		);
+		expect(rowsAffected).toBe(3);
+
+		const result = await db.execute(
+			"SELECT id, embedding FROM VectorTable ORDER BY id",
+		);
+		expect(result.rows.map((row) => row.id)).toEqual([10, 20, 30]);
+		const second = new Float32Array(result.rows[1]!.embedding as ArrayBuffer);
+		expect(Array.from(second)).toEqual([3, 3.5, 4, 4.5]);
+
+		let error: Error | undefined;
+		try {
+			await db.insertVectors("VectorTable", [1, 2], vectors, 4);
+		} catch (e) {
+			error = e as Error;
+		}
+		expect(error?.message.includes("2 ids for 3 vectors")).toBe(true);
+	});
+
+	it("Rejects vectors whose buffer was transferred", async () => {
+		if (isLibsql() || isTurso()) {
+			return;
+		}
+
+		const vectors = new Float32Array(8);
+		// ArrayBuffer.prototype.transfer is missing from older engines
+		const buffer: any = vectors.buffer;
+		if (typeof buffer.transfer !== "function") {
+			return;
+		}
+		buffer.transfer();
+
+		let error: Error | undefined;
+		try {
+			await db.insertVectors("VectorTable", null, vectors, 4);
+		} catch (e) {
+			error = e as Error;
+		}
+		expect(error?.message.includes("detached")).toBe(true);
+	});
+
+	it("Rejects an invalid dim or chunkSize", async () => {
+		if (isLibsql() || isTurso()) {
+			return;
+		}
+
+		const vectors = new Float32Array(8);
+		const messages: string[] = [];
+		for (const dim of [0, -4, NaN, Infinity, 2.5]) {
+			try {
+				await db.insertVectors("VectorTable", null, vectors, dim);
+			} catch (e) {
+				messages.push((e as Error).message);
+			}
+		}
+		for (const chunkSize of [-1, NaN, Infinity, 1.5]) {
+			try {
+				await db.insertVectors("VectorTable", null, vectors, 4, { chunkSize });
+			} catch (e) {
+				messages.push((e as Error).message);
+			}
+		}
+
+		expect(messages.length).toBe(9);
+		expect(messages.slice(0, 5).every((m) => m.includes("dim"))).toBe(true);
+		expect(messages.slice(5).every((m) => m.includes("chunkSize"))).toBe(true);
+	});
 });
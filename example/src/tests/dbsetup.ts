@@ -2,12 +2,14 @@ import {
   ANDROID_DATABASE_PATH,
   // ANDROID_EXTERNAL_FILES_PATH,
   IOS_LIBRARY_PATH,
+  getAllocatorStats,
   isIOSEmbedded,
   isLibsql,
   isSQLCipher,
   isTurso,
   moveAssetsDatabase,
   open,
+  openAsync,
 } from "@op-engineering/op-sqlite";
 import { describe, expect, it } from "@op-engineering/op-test";
 import { Platform } from "react-native";
@@ -74,6 +76,188 @@ describe("DB setup tests", () => {
     inMemoryDb.close();
   });
 
+  it("Opens a database off the JS thread with openAsync", async () => {
+    const db = await openAsync({
+      name: "openAsyncTest.sqlite",
+      encryptionKey: "test",
+    });
+
+    await db.execute("DROP TABLE IF EXISTS User;");
+    await db.execute("CREATE TABLE User (id INT PRIMARY KEY, name TEXT NOT NULL) STRICT;");
+    await db.execute("INSERT INTO User (id, name) VALUES (1, 'Alice');");
+
+    const res = await db.execute("SELECT name FROM User WHERE id = 1;");
+    expect(res.rows[0]!.name).toEqual("Alice");
+
+    db.delete();
+  });
+
+  if (isSQLCipher()) {
+    it("openAsync rejects a wrong encryption key", async () => {
+      const db = await openAsync({
+        name: "openAsyncKeyTest.sqlite",
+        encryptionKey: "test",
+      });
+      await db.execute("CREATE TABLE IF NOT EXISTS Data (id INT PRIMARY KEY);");
+      db.close();
+
+      let error: unknown = null;
+      try {
+        await openAsync({
+          name: "openAsyncKeyTest.sqlite",
+          encryptionKey: "wrong",
+        });
+      } catch (e) {
+        error = e;
+      }
+      expect(!!error).toEqual(true);
+
+      open({ name: "openAsyncKeyTest.sqlite", encryptionKey: "test" }).delete();
+    });
+  }
+
+  if (!isTurso()) {
+    it("Applies a pragma profile at open", async () => {
+      const db = open({
+        name: "profileTest.sqlite",
+        encryptionKey: "test",
+        profile: "read-heavy",
+      });
+
+      const settings = await db.getSettings();
+      expect(settings.journal_mode).toEqual("wal");
+      expect(settings.synchronous).toEqual(1);
+      expect(settings.cache_size).toEqual(-16000);
+      expect(settings.busy_timeout).toEqual(5000);
+
+      db.delete();
+    });
+
+    if (!isLibsql()) {
+      it("Applies a pragma profile to a read-only open", async () => {
+        const name = "profileReadOnlyTest.sqlite";
+        const setup = open({ name, encryptionKey: "test" });
+        await setup.execute("CREATE TABLE IF NOT EXISTS Data (id INT PRIMARY KEY)");
+        setup.close();
+
+        const db = open({
+          name,
+          encryptionKey: "test",
+          readOnly: true,
+          profile: "read-heavy",
+        });
+
+        const settings = await db.getSettings();
+        expect(settings.journal_mode).toEqual("delete");
+        expect(settings.cache_size).toEqual(-16000);
+        expect(settings.busy_timeout).toEqual(5000);
+
+        db.delete();
+      });
+    }
+
+    it("Applies a custom pragma profile", async () => {
+      const db = open({
+        name: "customProfileTest.sqlite",
+        encryptionKey: "test",
+        profile: { cache_size: -1234, temp_store: "MEMORY" },
+      });
+
+      const settings = await db.getSettings();
+      expect(settings.cache_size).toEqual(-1234);
+      expect(settings.temp_store).toEqual(2);
+
+      db.delete();
+    });
+
+    if (!isLibsql()) {
+      it("Checkpoints the WAL in the background", async () => {
+        const db = open({
+          name: "checkpointTest.sqlite",
+          encryptionKey: "test",
+          profile: "write-heavy",
+        });
+
+        db.startCheckpointScheduler({ idleMs: 50 });
+        expect(db.getCheckpointStats().running).toBe(true);
+
+        await db.execute("CREATE TABLE IF NOT EXISTS Data (id INT PRIMARY KEY, value TEXT);");
+        await db.executeBatch([
+          [
+            "INSERT OR REPLACE INTO Data (id, value) VALUES (?, ?)",
+            Array.from({ length: 200 }, (_, i) => [i, "x".repeat(1000)]),
+          ],
+        ]);
+
+        await new Promise((resolve) => setTimeout(resolve, 300));
+
+        const stats = db.getCheckpointStats();
+        expect(stats.checkpoints > 0).toBe(true);
+        expect(stats.checkpointedFrames).toEqual(stats.walFrames);
+
+        db.stopCheckpointScheduler();
+        expect(db.getCheckpointStats().running).toBe(false);
+        db.delete();
+      });
+    }
+
+    if (!isLibsql()) {
+      it("Reports and releases cache memory", async () => {
+        const db = open({
+          name: "memoryTest.sqlite",
+          encryptionKey: "test",
+        });
+
+        await db.execute("CREATE TABLE IF NOT EXISTS Data (id INT PRIMARY KEY, value TEXT);");
+        await db.executeBatch([
+          [
+            "INSERT OR REPLACE INTO Data (id, value) VALUES (?, ?)",
+            Array.from({ length: 200 }, (_, i) => [i, "x".repeat(1000)]),
+          ],
+        ]);
+        await db.execute("SELECT * FROM Data");
+
+        const usage = await db.getMemoryUsage();
+        expect(usage.cacheUsed > 0).toBe(true);
+        expect(usage.schemaUsed > 0).toBe(true);
+        expect(usage.lookasideHits > 0).toBe(true);
+
+        await db.releaseMemory();
+        const released = await db.getMemoryUsage();
+        expect(released.cacheUsed <= usage.cacheUsed).toBe(true);
+
+        db.delete();
+      });
+
+      it("Reports pool allocator stats when enabled", async () => {
+        const db = open({ name: "allocatorTest.sqlite" });
+        await db.execute("SELECT 1");
+
+        const stats = getAllocatorStats();
+        if (stats != null) {
+          expect(stats.allocations > 0).toBe(true);
+          expect(stats.bytesInUse > 0).toBe(true);
+          expect(stats.allocations >= stats.frees).toBe(true);
+        }
+
+        db.delete();
+      });
+    }
+
+    it("Rejects unsafe pragma values", () => {
+      let error: unknown = null;
+      try {
+        open({
+          name: "badProfileTest.sqlite",
+          profile: { cache_size: "1; DROP TABLE User" },
+        });
+      } catch (e) {
+        error = e;
+      }
+      expect(!!error).toEqual(true);
+    });
+  }
+
   // if (Platform.OS === "android") {
   // 	it("Create db in external directory Android", async () => {
   // 		const androidDb = open({
@@ -318,6 +502,123 @@ describe("DB setup tests", () => {
     reopened.close();
     reopened.delete();
   });
+
+  if (!isLibsql() && !isTurso() && !isSQLCipher()) {
+    it("Backs up an in-memory database to disk", async () => {
+      const target = open({ name: "backupTarget.sqlite" });
+      const targetPath = target.getDbPath();
+      target.delete();
+
+      const inMemoryDb = open({
+        name: "backupSource.sqlite",
+        location: ":memory:",
+      });
+      await inMemoryDb.execute("CREATE TABLE Data (id INT PRIMARY KEY, value TEXT);");
+      await inMemoryDb.executeBatch([
+        [
+          "INSERT INTO Data (id, value) VALUES (?, ?)",
+          Array.from({ length: 500 }, (_, i) => [i, "x".repeat(1000)]),
+        ],
+      ]);
+
+      let progressCalls = 0;
+      await inMemoryDb.backup(targetPath, {
+        pagesPerStep: 10,
+        onProgress: ({ remaining, pageCount }) => {
+          progressCalls++;
+          expect(remaining <= pageCount).toBe(true);
+        },
+      });
+      inMemoryDb.close();
+
+      expect(progressCalls > 1).toBe(true);
+
+      const restored = open({ name: "backupTarget.sqlite" });
+      const res = await restored.execute("SELECT COUNT(*) as count FROM Data");
+      expect(res.rows[0]!.count).toEqual(500);
+      restored.delete();
+    });
+
+    it("Rejects invalid backup steps", async () => {
+      const db = open({ name: "backupInvalid.sqlite" });
+      const targetPath = `${db.getDbPath()}.copy`;
+
+      for (const pagesPerStep of [0, -5, Number.NaN]) {
+        let error: any = null;
+        try {
+          await db.backup(targetPath, { pagesPerStep });
+        } catch (e) {
+          error = e;
+        }
+        expect(error?.message).toContain("pagesPerStep must be at least 1");
+      }
+
+      // Larger than the database, copies it in one step
+      await db.backup(targetPath, { pagesPerStep: 2 ** 40 });
+      db.delete();
+    });
+
+    it("Retries a backup while the destination is locked", async () => {
+      const target = open({ name: "backupLocked.sqlite" });
+      const targetPath = target.getDbPath();
+      target.executeSync("BEGIN EXCLUSIVE");
+
+      const source = open({ name: "backupLockedSource.sqlite" });
+      await source.execute("CREATE TABLE IF NOT EXISTS Data (id INT PRIMARY KEY)");
+
+      const backup = source.backup(targetPath);
+      await new Promise((resolve) => setTimeout(resolve, 100));
+      target.executeSync("COMMIT");
+      await backup;
+
+      target.close();
+      const restored = open({ name: "backupLocked.sqlite" });
+      const res = await restored.execute("SELECT COUNT(*) as count FROM Data");
+      expect(res.rows[0]!.count).toEqual(0);
+      restored.delete();
+      source.delete();
+    });
+
+    it("Serializes a database and opens it from the buffer", async () => {
+      const source = open({ name: "serializeSource.sqlite" });
+      await source.execute("DROP TABLE IF EXISTS Data;");
+      await source.execute("CREATE TABLE Data (id INT PRIMARY KEY, value TEXT);");
+      await source.executeBatch([
+        [
+          "INSERT INTO Data (id, value) VALUES (?, ?)",
+          Array.from({ length: 100 }, (_, i) => [i, `value ${i}`]),
+        ],
+      ]);
+
+      const image = await source.serialize();
+      source.delete();
+
+      expect(image.byteLength > 0).toBe(true);
+
+      const copy = open({ name: "serializeCopy.sqlite", fromBuffer: image });
+      const res = await copy.execute("SELECT COUNT(*) as count FROM Data");
+      expect(res.rows[0]!.count).toEqual(100);
+
+      await copy.execute("INSERT INTO Data (id, value) VALUES (100, 'new');");
+      const updated = await copy.execute("SELECT COUNT(*) as count FROM Data");
+      expect(updated.rows[0]!.count).toEqual(101);
+      copy.close();
+
+      const readOnlyCopy = open({
+        name: "serializeReadOnly.sqlite",
+        fromBuffer: image,
+        readOnly: true,
+      });
+      let error: unknown = null;
+      try {
+        await readOnlyCopy.execute("INSERT INTO Data (id, value) VALUES (100, 'new');");
+      } catch (e) {
+        error = e;
+      }
+      expect(!!error).toEqual(true);
+      readOnlyCopy.close();
+    });
+  }
 });
 
 it("Can attach/dettach database", () => {
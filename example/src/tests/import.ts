@@ -0,0 +1,139 @@
+import {
+  ANDROID_DATABASE_PATH,
+  type DB,
+  IOS_LIBRARY_PATH,
+  isLibsql,
+  isTurso,
+  moveAssetsDatabase,
+  open,
+} from "@op-engineering/op-sqlite";
+import { afterEach, beforeEach, describe, expect, it } from "@op-engineering/op-test";
+import { Platform } from "react-native";
+
+// Fixtures live in example/assets, they are copied next to the databases
+async function fixturePath(filename: string) {
+  await moveAssetsDatabase({ filename, overwrite: true });
+  const folder = Platform.OS === "ios" ? IOS_LIBRARY_PATH : ANDROID_DATABASE_PATH;
+  return folder.endsWith("/") ? folder + filename : `${folder}/${filename}`;
+}
+
+describe("File imports", () => {
+  if (isLibsql() || isTurso()) {
+    return;
+  }
+
+  let db: DB;
+
+  beforeEach(async () => {
+    db = open({ name: "import.sqlite", encryptionKey: "test" });
+    for (const table of ["LoadFileItems", "LoadFileLog", "LoadFileLines", "LoadFileBroken"]) {
+      await db.execute(`DROP TABLE IF EXISTS ${table}`);
+    }
+    await db.execute("DROP TABLE IF EXISTS ImportCountries");
+    await db.execute("CREATE TABLE ImportCountries (code TEXT PRIMARY KEY, name TEXT, note TEXT)");
+  });
+
+  afterEach(() => {
+    if (db) {
+      db.delete();
+      // @ts-expect-error
+      db = null;
+    }
+  });
+
+  it("loadFile runs every statement of a dump", async () => {
+    const path = await fixturePath("loadfile-statements.sql");
+
+    const { commands } = await db.loadFile(path);
+
+    // The dump's own BEGIN and COMMIT are skipped
+    expect(commands).toEqual(6);
+    const items = await db.execute("SELECT id, name, note FROM LoadFileItems ORDER BY id");
+    expect(items.rows).toDeepEqual([
+      { id: 1, name: "semi;colon", note: "it's quoted" },
+      { id: 2, name: "two", note: null },
+      { id: 3, name: "last", note: "no semicolon" },
+    ]);
+    // Ran by the trigger spanning several lines
+    const log = await db.execute("SELECT COUNT(*) AS count FROM LoadFileLog");
+    expect(log.rows[0]!.count).toEqual(3);
+  });
+
+  it("loadFile reads files without semicolons line by line", async () => {
+    const path = await fixturePath("loadfile-lines.sql");
+
+    const { commands } = await db.loadFile(path);
+
+    expect(commands).toEqual(4);
+    const res = await db.execute("SELECT name FROM LoadFileLines ORDER BY id");
+    expect(res.rows.map((row) => row.name)).toDeepEqual(["one", "two", "three"]);
+  });
+
+  it("loadFile rolls back when a statement fails", async () => {
+    const path = await fixturePath("loadfile-error.sql");
+
+    let error: any = null;
+    try {
+      await db.loadFile(path);
+    } catch (e) {
+      error = e;
+    }
+
+    expect(error?.message).toContain("no such table: LoadFileMissing");
+    const res = await db.execute(
+      "SELECT COUNT(*) AS count FROM sqlite_master WHERE name = 'LoadFileBroken'",
+    );
+    expect(res.rows[0]!.count).toEqual(0);
+  });
+
+  it("importFile unquotes CSV fields", async () => {
+    const path = await fixturePath("import-quoted.csv");
+
+    const { rowsAffected } = await db.importFile(path, {
+      format: "csv",
+      table: "ImportCountries",
+    });
+
+    expect(rowsAffected).toEqual(3);
+    const res = await db.execute("SELECT code, name, note FROM ImportCountries ORDER BY code");
+    expect(res.rows).toDeepEqual([
+      { code: "FR", name: "France", note: "Paris, Lyon" },
+      { code: "US", name: 'United "States"', note: "line one\nline two" },
+      // Empty unquoted is NULL, "" is an empty string
+      { code: "XX", name: null, note: "" },
+    ]);
+  });
+
+  it("importFile inserts missing NDJSON keys as NULL", async () => {
+    const path = await fixturePath("import-rows.ndjson");
+
+    await db.importFile(path, {
+      format: "ndjson",
+      table: "ImportCountries",
+      columns: ["code", "name", "note"],
+    });
+
+    const res = await db.execute("SELECT code, name, note FROM ImportCountries ORDER BY code");
+    expect(res.rows).toDeepEqual([
+      { code: "DE", name: "Germany", note: null },
+      { code: "IT", name: "Italy", note: '{"capital":"Rome","cities":["Milan"]}' },
+      { code: "JP", name: "Japan", note: null },
+    ]);
+  });
+
+  it("importFile rejects a malformed CSV row", async () => {
+    const path = await fixturePath("import-malformed.csv");
+
+    let error: any = null;
+    try {
+      await db.importFile(path, { format: "csv", table: "ImportCountries" });
+    } catch (e) {
+      error = e;
+    }
+
+    // The header is row 1
+    expect(error?.message).toContain("row 3: expected 3 fields, found 2");
+    const res = await db.execute("SELECT COUNT(*) AS count FROM ImportCountries");
+    expect(res.rows[0]!.count).toEqual(0);
+  });
+});
@@ -2,8 +2,10 @@ import "./blob";
 import "./constants";
 import "./dbsetup";
 import "./hooks";
+import "./import";
 import "./preparedStatements";
 import "./queries";
+import "./queryCache";
 import "./reactive";
 import "./storage";
 import "./tokenizer";
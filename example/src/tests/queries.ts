@@ -2,10 +2,13 @@ import {
   // openRemote,
   // openSync,
   type DB,
+  getWorkerStats,
+  getWorkerThreads,
   isLibsql,
   isTurso,
   open,
   type SQLBatchTuple,
+  setWorkerThreads,
 } from "@op-engineering/op-sqlite";
 import { afterEach, beforeEach, describe, expect, it } from "@op-engineering/op-test";
 import { chance, sleep } from "./utils";
@@ -84,6 +87,14 @@ describe("Queries tests", () => {
     });
   });
 
+  it("Binds whole numbers beyond 32 bits as integers", async () => {
+    const big = 2 ** 40 + 1;
+    const res = await db.execute("SELECT typeof(?) AS type, ? AS value", [big, big]);
+
+    expect(res.rows[0]!.type).toEqual("integer");
+    expect(res.rows[0]!.value).toEqual(big);
+  });
+
   it("Trying to pass object as param should throw", async () => {
     try {
       // @ts-expect-error
@@ -93,6 +104,269 @@ describe("Queries tests", () => {
     }
   });
 
+  it("Interactive queries run before queued normal ones", async () => {
+    const finished: string[] = [];
+    const normal = Array.from({ length: 100 }, (_, i) =>
+      db.execute("SELECT ?", [i]).then(() => {
+        finished.push("normal");
+      }),
+    );
+    const interactive = db
+      .execute("SELECT 1", [], { priority: "interactive" })
+      .then(() => {
+        finished.push("interactive");
+      });
+
+    await Promise.all([...normal, interactive]);
+
+    expect(finished.indexOf("interactive") < finished.length - 1).toBe(true);
+  });
+
+  it("Background batch still commits every command", async () => {
+    const commands: SQLBatchTuple[] = Array.from({ length: 50 }, (_, i) => [
+      "INSERT INTO User (id, name, age, networth) VALUES(?, ?, ?, ?)",
+      [i, "bg", 20, 1.5],
+    ]);
+
+    const batch = db.executeBatch(commands, { priority: "background" });
+    const lookup = db.execute("SELECT 1", [], { priority: "interactive" });
+    const [batchResult] = await Promise.all([batch, lookup]);
+
+    expect(batchResult.rowsAffected).toEqual(50);
+    const res = await db.execute("SELECT COUNT(*) as count FROM User");
+    expect(res.rows[0]!.count).toEqual(50);
+  });
+
+  it("Background batch keeps interactive writes out of its transaction", async () => {
+    const commands: SQLBatchTuple[] = [
+      // Slow enough for the write below to be queued while it runs
+      [
+        "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 200000) INSERT INTO User (id, name, age, networth) SELECT x, 'bg', 20, 1.5 FROM n",
+      ],
+      ...Array.from({ length: 20 }, (_, i): SQLBatchTuple => [
+        "INSERT INTO User (id, name, age, networth) VALUES(?, ?, ?, ?)",
+        [300000 + i, "bg", 20, 1.5],
+      ]),
+      // Duplicate id, fails the batch
+      ["INSERT INTO User (id, name, age, networth) VALUES(1, 'bg', 20, 1.5)"],
+    ];
+
+    const batch = db.executeBatch(commands, { priority: "background" });
+    await new Promise((resolve) => setTimeout(resolve, 10));
+    const write = db.execute(
+      "INSERT INTO User (id, name, age, networth) VALUES(?, ?, ?, ?)",
+      [-1, "interactive", 20, 1.5],
+      { priority: "interactive" },
+    );
+
+    let error: unknown = null;
+    try {
+      await batch;
+    } catch (e) {
+      error = e;
+    }
+    await write;
+
+    expect(!!error).toEqual(true);
+    const res = await db.execute("SELECT name FROM User ORDER BY id");
+    expect(res.rows.map((row) => row.name)).toEqual(["interactive"]);
+  });
+
+  it("Rejects an unknown priority", async () => {
+    let error: unknown = null;
+    try {
+      // @ts-expect-error
+      await db.execute("SELECT 1", [], { priority: "urgent" });
+    } catch (e) {
+      error = e;
+    }
+    expect(!!error).toEqual(true);
+  });
+
+  it("Databases share the worker threads", async () => {
+    const previous = getWorkerThreads();
+    setWorkerThreads(1);
+    expect(getWorkerThreads()).toEqual(1);
+
+    const other = open({ name: "queries-worker.sqlite" });
+    try {
+      await other.execute("DROP TABLE IF EXISTS T;");
+      await other.execute("CREATE TABLE T (id INT PRIMARY KEY) STRICT;");
+
+      const inserts = [];
+      for (let i = 0; i < 20; i++) {
+        inserts.push(other.execute("INSERT INTO T (id) VALUES (?)", [i]));
+        inserts.push(
+          db.execute("INSERT INTO User (id, name) VALUES (?, ?)", [i, "x"]),
+        );
+      }
+      await Promise.all(inserts);
+
+      const a = await other.execute("SELECT count(*) as count FROM T");
+      const b = await db.execute("SELECT count(*) as count FROM User");
+      expect(a.rows[0]!.count).toEqual(20);
+      expect(b.rows[0]!.count).toEqual(20);
+    } finally {
+      other.delete();
+      setWorkerThreads(previous);
+    }
+  });
+
+  it("setWorkerThreads rejects counts below 1", () => {
+    let error: unknown = null;
+    try {
+      setWorkerThreads(0);
+    } catch (e) {
+      error = e;
+    }
+    expect(!!error).toEqual(true);
+  });
+
+  it("syncAsync is only available for databases with a remote", async () => {
+    if (!isLibsql() && !isTurso()) {
+      return;
+    }
+
+    let error: unknown = null;
+    try {
+      await db.syncAsync();
+    } catch (e) {
+      error = e;
+    }
+    expect(!!error).toEqual(true);
+  });
+
+  it("Rejects a query still queued at its deadline", async () => {
+    if (isLibsql() || isTurso()) {
+      return;
+    }
+
+    const slow = db.execute(
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c LIMIT 3000000) SELECT count(*) FROM c",
+    );
+    const late = db.execute("SELECT 1", [], { deadlineMs: 1 });
+    const onTime = db.execute("SELECT 2 as value", [], { deadlineMs: 60000 });
+
+    await slow;
+    let error: any = null;
+    try {
+      await late;
+    } catch (e) {
+      error = e;
+    }
+    expect(error?.message.includes("in the queue")).toEqual(true);
+    const res = await onTime;
+    expect(res.rows[0]!.value).toEqual(2);
+
+    const stats = db.getQueueStats();
+    expect(stats.expired).toEqual(1);
+    expect(stats.queued).toEqual(0);
+    expect(stats.waitMaxMs >= stats.waitP50Ms).toEqual(true);
+    expect(stats.busyMs > 0).toEqual(true);
+
+    const workers = getWorkerStats();
+    expect(workers.completed >= stats.completed).toEqual(true);
+    expect(workers.threads >= 1).toEqual(true);
+  });
+
+  it("Rejects an invalid deadlineMs", async () => {
+    let error: unknown = null;
+    try {
+      await db.execute("SELECT 1", [], { deadlineMs: 0 });
+    } catch (e) {
+      error = e;
+    }
+    expect(!!error).toEqual(true);
+  });
+
+  it("Rejects a NaN timeoutMs", async () => {
+    let error: any = null;
+    try {
+      await db.execute("SELECT 1", [], { timeoutMs: NaN });
+    } catch (e) {
+      error = e;
+    }
+    expect(error?.message.includes("timeoutMs")).toEqual(true);
+  });
+
+  it("Removes the abort listener once the query settles", async () => {
+    const controller = new AbortController();
+    const signal = controller.signal;
+    let listeners = 0;
+    const add = signal.addEventListener.bind(signal);
+    const remove = signal.removeEventListener.bind(signal);
+    signal.addEventListener = ((...args: Parameters<typeof add>) => {
+      listeners++;
+      add(...args);
+    }) as typeof signal.addEventListener;
+    signal.removeEventListener = ((...args: Parameters<typeof remove>) => {
+      listeners--;
+      remove(...args);
+    }) as typeof signal.removeEventListener;
+
+    for (let i = 0; i < 5; i++) {
+      await db.execute("SELECT 1", [], { signal });
+    }
+    try {
+      await db.execute("SELECT * FROM NoSuchTable", [], { signal });
+    } catch (_e) {}
+
+    expect(listeners).toEqual(0);
+  });
+
+  it("Rejects a query whose signal is already aborted", async () => {
+    const controller = new AbortController();
+    controller.abort();
+
+    let error: any = null;
+    try {
+      await db.execute("SELECT 1", [], { signal: controller.signal });
+    } catch (e) {
+      error = e;
+    }
+    expect(error?.message.includes("aborted")).toEqual(true);
+  });
+
+  it("Aborting skips a queued query without affecting the others", async () => {
+    const controller = new AbortController();
+    const first = db.execute("SELECT 1");
+    const cancelled = db.execute("SELECT 2", [], { signal: controller.signal });
+    const last = db.execute("SELECT 3 as value");
+    controller.abort();
+
+    await first;
+    let error: unknown = null;
+    try {
+      await cancelled;
+    } catch (e) {
+      error = e;
+    }
+    expect(!!error).toEqual(true);
+    const res = await last;
+    expect(res.rows[0]!.value).toEqual(3);
+  });
+
+  it("Times out a long running query", async () => {
+    if (isLibsql() || isTurso()) {
+      return;
+    }
+
+    let error: any = null;
+    try {
+      await db.execute(
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) SELECT count(*) FROM c",
+        [],
+        { timeoutMs: 100 },
+      );
+    } catch (e) {
+      error = e;
+    }
+    expect(error?.message.includes("timed out")).toEqual(true);
+
+    const res = await db.execute("SELECT 1 as value");
+    expect(res.rows[0]!.value).toEqual(1);
+  });
+
   it("interrupt is safe to call with no in-flight query", () => {
     if (isLibsql() || isTurso()) {
       return;
@@ -299,6 +573,40 @@ describe("Queries tests", () => {
     ]);
   });
 
+  it("Reused statements don't keep the params of the previous run", async () => {
+    const first = await db.execute("SELECT ? AS a, ? AS b", [1, 2]);
+    expect(first.rows[0]).toDeepEqual({ a: 1, b: 2 });
+
+    // Same SQL, fewer params, the second one must not be 2 anymore
+    const second = await db.execute("SELECT ? AS a, ? AS b", [3]);
+    expect(second.rows[0]).toDeepEqual({ a: 3, b: null });
+
+    const sync = db.executeSync("SELECT ? AS a, ? AS b", [4]);
+    expect(sync.rows[0]).toDeepEqual({ a: 4, b: null });
+  });
+
+  it("Reused statements see schema changes", async () => {
+    await db.execute("INSERT INTO User (id, name, age, networth) VALUES(?, ?, ?, ?)", [
+      1,
+      "Ann",
+      30,
+      1.5,
+    ]);
+    const before = await db.execute("SELECT * FROM User");
+    expect(Object.keys(before.rows[0]!)).toDeepEqual(["id", "name", "age", "networth", "nickname"]);
+
+    await db.execute("ALTER TABLE User ADD COLUMN email TEXT");
+    const after = await db.execute("SELECT * FROM User");
+    expect(after.rows[0]!.email).toEqual(null);
+    expect(after.columnNames).toDeepEqual(["id", "name", "age", "networth", "nickname", "email"]);
+
+    await db.execute("DROP TABLE User");
+    await db.execute("CREATE TABLE User (id INT PRIMARY KEY, name TEXT) STRICT");
+    await db.execute("INSERT INTO User (id, name) VALUES(?, ?)", [2, "Bob"]);
+    const recreated = await db.execute("SELECT * FROM User");
+    expect(recreated.rows).toDeepEqual([{ id: 2, name: "Bob" }]);
+  });
+
   it("Preserves non-ASCII strings when binding params", async () => {
     const value = JSON.stringify({
       bullet: "Kimball Wildlife Refuge • Burlingame State Park",
@@ -723,6 +1031,27 @@ describe("Queries tests", () => {
     ]);
   });
 
+  it("executeBatch rejects when a statement fails while stepping", async () => {
+    const id = chance.integer();
+
+    let error: any = null;
+    try {
+      // The second row hits the primary key after the first was returned
+      await db.executeBatch([
+        [
+          'INSERT INTO "User" (id, name, age, networth) VALUES (?, ?, ?, ?), (?, ?, ?, ?) RETURNING id',
+          [id, "first", 1, 1, id, "second", 2, 2],
+        ],
+      ]);
+    } catch (e) {
+      error = e;
+    }
+
+    expect(error?.message.includes("UNIQUE")).toEqual(true);
+    const res = await db.execute('SELECT COUNT(*) AS count FROM "User"');
+    expect(res.rows[0]!.count).toEqual(0);
+  });
+
   it("Batch execute with BLOB", async () => {
     const db = open({
       name: "queries.sqlite",
@@ -0,0 +1,196 @@
+import { type DB, isLibsql, isTurso, open } from "@op-engineering/op-sqlite";
+import {
+	afterEach,
+	beforeEach,
+	describe,
+	expect,
+	it,
+} from "@op-engineering/op-test";
+
+describe("Query cache", () => {
+	let db: DB;
+	if (isLibsql() || isTurso()) {
+		return;
+	}
+
+	beforeEach(async () => {
+		db = open({
+			name: "queryCache.sqlite",
+			encryptionKey: "test",
+		});
+
+		await db.execute("DROP TABLE IF EXISTS User;");
+		await db.execute("DROP TABLE IF EXISTS Other;");
+		await db.execute(
+			"CREATE TABLE User (id INT PRIMARY KEY, name TEXT NOT NULL) STRICT;",
+		);
+		await db.execute("CREATE TABLE Other (id INT PRIMARY KEY) STRICT;");
+		await db.execute("INSERT INTO User (id, name) VALUES (1, 'Alice');");
+	});
+
+	afterEach(() => {
+		if (db) {
+			db.delete();
+			// @ts-expect-error
+			db = null;
+		}
+	});
+
+	it("returns the same rows as execute", async () => {
+		const res = await db.executeCached("SELECT * FROM User WHERE id = ?", [1]);
+		const cached = await db.executeCached("SELECT * FROM User WHERE id = ?", [
+			1,
+		]);
+
+		expect(res.rows).toDeepEqual([{ id: 1, name: "Alice" }]);
+		expect(cached.rows).toDeepEqual(res.rows);
+	});
+
+	it("distinguishes params", async () => {
+		await db.execute("INSERT INTO User (id, name) VALUES (2, 'Bob');");
+
+		const first = await db.executeCached("SELECT name FROM User WHERE id = ?", [
+			1,
+		]);
+		const second = await db.executeCached(
+			"SELECT name FROM User WHERE id = ?",
+			[2],
+		);
+
+		expect(first.rows[0]!.name).toEqual("Alice");
+		expect(second.rows[0]!.name).toEqual("Bob");
+	});
+
+	it("invalidates on insert, update and delete", async () => {
+		const query = "SELECT COUNT(*) as count FROM User";
+
+		let res = await db.executeCached(query);
+		expect(res.rows[0]!.count).toEqual(1);
+
+		await db.execute("INSERT INTO User (id, name) VALUES (2, 'Bob');");
+		res = await db.executeCached(query);
+		expect(res.rows[0]!.count).toEqual(2);
+
+		await db.execute("UPDATE User SET name = 'Carol' WHERE id = 2;");
+		res = await db.executeCached("SELECT name FROM User WHERE id = 2");
+		expect(res.rows[0]!.name).toEqual("Carol");
+
+		await db.execute("DELETE FROM User;");
+		res = await db.executeCached(query);
+		expect(res.rows[0]!.count).toEqual(0);
+	});
+
+	it("never serves stale rows of WITHOUT ROWID tables", async () => {
+		// Writes to these tables don't reach the update hook
+		await db.execute("DROP TABLE IF EXISTS Setting;");
+		await db.execute(
+			"CREATE TABLE Setting (key TEXT PRIMARY KEY, value TEXT) WITHOUT ROWID;",
+		);
+		await db.execute("INSERT INTO Setting VALUES ('theme', 'light');");
+		const query = "SELECT value FROM Setting WHERE key = 'theme'";
+
+		let res = await db.executeCached(query);
+		expect(res.rows[0]!.value).toEqual("light");
+
+		await db.execute("UPDATE Setting SET value = 'dark' WHERE key = 'theme';");
+		res = await db.executeCached(query);
+		expect(res.rows[0]!.value).toEqual("dark");
+	});
+
+	it("invalidates after a committed transaction", async () => {
+		const query = "SELECT COUNT(*) as count FROM User";
+		await db.executeCached(query);
+
+		await db.transaction(async (tx) => {
+			await tx.execute("INSERT INTO User (id, name) VALUES (2, 'Bob');");
+		});
+
+		const res = await db.executeCached(query);
+		expect(res.rows[0]!.count).toEqual(2);
+	});
+
+	it("still drops tables once the cache is enabled", async () => {
+		await db.executeCached("SELECT COUNT(*) as count FROM Other");
+
+		await db.execute("DROP TABLE Other;");
+
+		const res = await db.execute(
+			"SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'Other'",
+		);
+		expect(res.rows.length).toEqual(0);
+	});
+
+	it("does not cache non-deterministic functions", async () => {
+		const query = "SELECT random() as value";
+		const first = await db.executeCached(query);
+		const second = await db.executeCached(query);
+
+		expect(first.rows[0]!.value === second.rows[0]!.value).toEqual(false);
+	});
+
+	it("keeps entries for unrelated tables", async () => {
+		const query = "SELECT COUNT(*) as count FROM User";
+		await db.executeCached(query);
+
+		await db.execute("INSERT INTO Other (id) VALUES (1);");
+
+		const res = await db.executeCached(query);
+		expect(res.rows[0]!.count).toEqual(1);
+	});
+
+	it("clearQueryCache drops all entries", async () => {
+		const query = "SELECT name FROM User WHERE id = 1";
+		await db.executeCached(query);
+
+		db.clearQueryCache();
+
+		const res = await db.executeCached(query);
+		expect(res.rows[0]!.name).toEqual("Alice");
+	});
+
+	it("executeFast answers a cheap read inline once it is known", async () => {
+		const query = "SELECT name FROM User WHERE id = ?";
+		const first = db.executeFast(query, [1]);
+		expect(first instanceof Promise).toEqual(true);
+		expect((await first).rows[0]!.name).toEqual("Alice");
+
+		const second = db.executeFast(query, [1]);
+		expect(second instanceof Promise).toEqual(false);
+		expect((await second).rows[0]!.name).toEqual("Alice");
+	});
+
+	it("executeFast queues behind pending work and never inlines writes", async () => {
+		const query = "SELECT COUNT(*) as count FROM User";
+		await db.executeFast(query);
+
+		const write = "INSERT INTO User (id, name) VALUES (?, 'Bob');";
+		await db.executeFast(write, [2]);
+		const second = db.executeFast(write, [3]);
+		expect(second instanceof Promise).toEqual(true);
+
+		// Still queued behind the insert, must see it
+		const res = await db.executeFast(query);
+		expect(res.rows[0]!.count).toEqual(3);
+	});
+
+	it("executeFast never inlines several statements or transactions", async () => {
+		for (const query of ["SELECT 1 as one; SELECT 2 as two", "BEGIN"]) {
+			await db.executeFast(query);
+			const second = db.executeFast(query);
+			expect(second instanceof Promise).toEqual(true);
+			await second.catch(() => {});
+			await db.execute("ROLLBACK").catch(() => {});
+		}
+	});
+
+	it("executeFast rejects on errors", async () => {
+		const query = "SELECT CAST(? AS INT) + missing FROM User";
+		let error: unknown = null;
+		try {
+			await db.executeFast(query, [1]);
+		} catch (e) {
+			error = e;
+		}
+		expect(!!error).toEqual(true);
+	});
+});
@@ -44,5 +44,35 @@ describe("Tokenizer tests", () => {
 			expect(res.rows.length).toEqual(1);
 			expect(res.rows[0]?.content).toEqual("This is a test document");
 		});
+
+		it("Should fold case and diacritics when asked to", async () => {
+			await db.execute("DROP TABLE IF EXISTS folded_table;");
+			await db.execute(
+				`CREATE VIRTUAL TABLE folded_table USING fts5(content, tokenize = 'wordtokenizer remove_diacritics 1');`,
+			);
+			await db.execute("INSERT INTO folded_table(content) VALUES (?)", [
+				"Crème Brûlée at the CAFÉ",
+			]);
+			const res = await db.execute(
+				"SELECT content FROM folded_table WHERE folded_table MATCH ?",
+				["creme AND brulee AND café"],
+			);
+			expect(res.rows.length).toEqual(1);
+		});
+
+		it("Should match word variants with the porter tokenizer", async () => {
+			await db.execute("DROP TABLE IF EXISTS stemmed_table;");
+			await db.execute(
+				`CREATE VIRTUAL TABLE stemmed_table USING fts5(content, tokenize = 'portertokenizer');`,
+			);
+			await db.execute("INSERT INTO stemmed_table(content) VALUES (?)", [
+				"He was running to the Connections meeting",
+			]);
+			const res = await db.execute(
+				"SELECT content FROM stemmed_table WHERE stemmed_table MATCH ?",
+				["run AND connected AND meetings"],
+			);
+			expect(res.rows.length).toEqual(1);
+		});
 	}
 });
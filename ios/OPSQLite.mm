@@ -4,6 +4,7 @@
 #import <React/RCTLog.h>
 #import <React/RCTUtils.h>
 #import <ReactCommon/RCTTurboModule.h>
+#import <UIKit/UIKit.h>
 #import <jsi/jsi.h>
 
 // RCTCxxBridge (the old-architecture class that exposed `.runtime`) no
@@ -123,9 +124,24 @@ RCT_EXPORT_BLOCKING_SYNCHRONOUS_METHOD(install) {
   _generationAlive =
       opsqlite::install(runtime, callInvoker, [documentPath UTF8String],
                        [sqlite_vec_path UTF8String]);
+
+  NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+  [center removeObserver:self
+                    name:UIApplicationDidReceiveMemoryWarningNotification
+                  object:nil];
+  [center addObserver:self
+             selector:@selector(didReceiveMemoryWarning)
+                 name:UIApplicationDidReceiveMemoryWarningNotification
+               object:nil];
   return @true;
 }
 
+// iOS has a single memory warning level, it is only sent when the app is
+// close to being terminated
+- (void)didReceiveMemoryWarning {
+  opsqlite::on_memory_pressure(true);
+}
+
 RCT_EXPORT_BLOCKING_SYNCHRONOUS_METHOD(getDylibPath : (
     NSString *)bundleId andResource : (NSString *)resourceName) {
   NSString *bundle_path = [[[NSBundle mainBundle] privateFrameworksPath]
@@ -177,6 +193,10 @@ RCT_EXPORT_METHOD(moveAssetsDatabase : (NSDictionary *)args resolve : (
 }
 
 - (void)invalidate {
+  [[NSNotificationCenter defaultCenter]
+      removeObserver:self
+                name:UIApplicationDidReceiveMemoryWarningNotification
+              object:nil];
   opsqlite::invalidate(_generationAlive);
   _generationAlive = nullptr;
 }
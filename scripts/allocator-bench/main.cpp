@@ -0,0 +1,237 @@
+// Benchmarks SQLite with the system allocator against the pool allocator of
+// cpp/OPAllocator.cpp (the poolAllocator option), outside of a device. The
+// allocator has to be chosen before SQLite is initialized, so one run measures
+// one of them:
+//
+//   allocator-bench [--pool] [--rows N] [--runs N] [--dir path]
+//
+// Every workload runs --runs times on fresh databases in --dir and the best
+// time is reported:
+//   - insert: --rows rows into an indexed table, in one transaction
+//   - scan: 5 passes of a filtered and sorted select over those rows
+//   - statements: 200000 prepare/step/finalize of a point query
+//   - concurrent: insert and scan on a worker thread while the main thread
+//     runs point queries on another database, like the worker and JS threads
+//     of the app
+// Connections are opened with the flags and the lookaside of opsqlite_open.
+
+#include "OPAllocator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace opsqlite;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+struct Options {
+  bool pool = false;
+  int rows = 200000;
+  int runs = 5;
+  std::string dir = ".";
+};
+
+constexpr int point_queries = 200000;
+constexpr int scan_passes = 5;
+
+[[noreturn]] void usage() {
+  fprintf(stderr, "usage: allocator-bench [--pool] [--rows N] [--runs N] "
+                  "[--dir path]\n");
+  exit(2);
+}
+
+[[noreturn]] void die(sqlite3 *db, const char *what) {
+  fprintf(stderr, "%s: %s\n", what, db ? sqlite3_errmsg(db) : "out of memory");
+  exit(1);
+}
+
+void exec(sqlite3 *db, const char *sql) {
+  if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+    die(db, sql);
+  }
+}
+
+sqlite3_stmt *prepare(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    die(db, sql);
+  }
+  return stmt;
+}
+
+sqlite3 *open_database(const Options &options, const char *name, bool pool) {
+  std::string path = options.dir + "/" + name;
+  remove(path.c_str());
+  remove((path + "-wal").c_str());
+  remove((path + "-shm").c_str());
+
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(path.c_str(), &db,
+                      SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_READWRITE |
+                          SQLITE_OPEN_CREATE,
+                      nullptr) != SQLITE_OK) {
+    die(db, path.c_str());
+  }
+  if (pool) {
+    configure_lookaside(db);
+  }
+  exec(db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL");
+  return db;
+}
+
+// Workloads
+
+void insert_rows(sqlite3 *db, int rows) {
+  exec(db, "DROP TABLE IF EXISTS items;"
+           "CREATE TABLE items (id INTEGER PRIMARY KEY, title TEXT, "
+           "tag TEXT, price REAL, stock INTEGER);"
+           "CREATE INDEX items_tag ON items (tag)");
+  exec(db, "BEGIN");
+  sqlite3_stmt *stmt = prepare(
+      db, "INSERT INTO items (title, tag, price, stock) VALUES (?, ?, ?, ?)");
+  char tag[64];
+  for (int i = 0; i < rows; i++) {
+    // Spread the index inserts over the whole tree
+    snprintf(tag, sizeof(tag), "tag number %d",
+             static_cast<int>((i * 7919LL) % rows));
+    sqlite3_bind_text(stmt, 1, "a short product title", -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, tag, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(stmt, 3, i * 1.5);
+    sqlite3_bind_int(stmt, 4, i);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      die(db, "insert");
+    }
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  exec(db, "COMMIT");
+}
+
+long long scan_rows(sqlite3 *db, int passes) {
+  long long checksum = 0;
+  for (int pass = 0; pass < passes; pass++) {
+    sqlite3_stmt *stmt = prepare(db, "SELECT title, tag, price, stock FROM "
+                                     "items WHERE stock % 3 = 0 ORDER BY tag");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      checksum += sqlite3_column_bytes(stmt, 1) + sqlite3_column_int(stmt, 3);
+    }
+    sqlite3_finalize(stmt);
+  }
+  return checksum;
+}
+
+void point_query(sqlite3 *db, int count, int rows) {
+  for (int i = 0; i < count; i++) {
+    sqlite3_stmt *stmt =
+        prepare(db, "SELECT title, tag FROM items WHERE id = ?");
+    sqlite3_bind_int(stmt, 1, i % rows + 1);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+      die(db, "point query");
+    }
+    sqlite3_finalize(stmt);
+  }
+}
+
+struct Result {
+  double insert = 1e300;
+  double scan = 1e300;
+  double statements = 1e300;
+  double concurrent = 1e300;
+};
+
+void run_once(const Options &options, Result &result) {
+  sqlite3 *worker = open_database(options, "allocator-worker.sqlite",
+                                  options.pool);
+  sqlite3 *js = open_database(options, "allocator-js.sqlite", options.pool);
+  constexpr int js_rows = 2000;
+  insert_rows(js, js_rows);
+
+  auto start = Clock::now();
+  insert_rows(worker, options.rows);
+  result.insert = std::min(result.insert, elapsed_ms(start));
+
+  start = Clock::now();
+  long long checksum = scan_rows(worker, scan_passes);
+  result.scan = std::min(result.scan, elapsed_ms(start));
+  if (checksum == 0) {
+    die(nullptr, "scan returned no rows");
+  }
+
+  start = Clock::now();
+  point_query(js, point_queries, js_rows);
+  result.statements = std::min(result.statements, elapsed_ms(start));
+
+  start = Clock::now();
+  std::thread thread([&] {
+    insert_rows(worker, options.rows);
+    scan_rows(worker, 3);
+  });
+  point_query(js, point_queries, js_rows);
+  thread.join();
+  result.concurrent = std::min(result.concurrent, elapsed_ms(start));
+
+  sqlite3_close(worker);
+  sqlite3_close(js);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        usage();
+      }
+      return argv[++i];
+    };
+    if (arg == "--pool") {
+      options.pool = true;
+    } else if (arg == "--rows") {
+      options.rows = std::max(1, atoi(value().c_str()));
+    } else if (arg == "--runs") {
+      options.runs = std::max(1, atoi(value().c_str()));
+    } else if (arg == "--dir") {
+      options.dir = value();
+    } else {
+      usage();
+    }
+  }
+
+  if (options.pool && !install_pool_allocator()) {
+    fprintf(stderr, "The pool allocator could not be installed\n");
+    return 1;
+  }
+
+  Result result;
+  for (int run = 0; run < options.runs; run++) {
+    run_once(options, result);
+  }
+
+  printf("allocator: %s, %d rows, best of %d runs\n",
+         options.pool ? "pool" : "system", options.rows, options.runs);
+  printf("  insert      %8.0f ms\n", result.insert);
+  printf("  scan        %8.0f ms\n", result.scan);
+  printf("  statements  %8.0f ms\n", result.statements);
+  printf("  concurrent  %8.0f ms\n", result.concurrent);
+
+  if (options.pool) {
+    auto stats = get_pool_allocator_stats();
+    printf("  %lld allocations: %lld thread cache, %lld shared pool, %lld "
+           "system (%lld large)\n",
+           stats.allocations, stats.thread_cache_hits, stats.shared_pool_hits,
+           stats.system_allocations, stats.large_allocations);
+  }
+  return 0;
+}
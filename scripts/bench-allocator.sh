@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+
+# Builds scripts/allocator-bench with sqlite3.c and cpp/OPAllocator.cpp into a
+# Linux/macOS binary, then measures the same workloads with the system
+# allocator and with the pool allocator of the poolAllocator option.
+# Arguments go to the harness:
+#
+#   ./scripts/bench-allocator.sh
+#   ./scripts/bench-allocator.sh --rows 50000 --runs 3
+#
+# SQLITE_DIR          folder with sqlite3.c and sqlite3.h, downloaded when missing
+# OP_SQLITE_SANITIZE  set to 1 to build with AddressSanitizer and UBSan
+
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_DIR="$ROOT_DIR/scripts/allocator-bench"
+BUILD_DIR="$BENCH_DIR/build"
+SQLITE_DIR="${SQLITE_DIR:-"$BUILD_DIR/sqlite"}"
+CC="${CC:-cc}"
+CXX="${CXX:-c++}"
+
+if [[ ! -f "$SQLITE_DIR/sqlite3.c" ]]; then
+  "$ROOT_DIR/scripts/download-latest-sqlite-amalgamation.sh" "$SQLITE_DIR"
+fi
+
+FLAGS=(-O2 -g)
+if [[ "${OP_SQLITE_SANITIZE:-0}" == "1" ]]; then
+  FLAGS=(-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined)
+fi
+
+mkdir -p "$BUILD_DIR"
+
+# Same threading mode as the app, the concurrent workload needs it
+SQLITE_OBJECT="$BUILD_DIR/sqlite3-${OP_SQLITE_SANITIZE:-0}.o"
+if [[ ! -f "$SQLITE_OBJECT" || "$SQLITE_DIR/sqlite3.c" -nt "$SQLITE_OBJECT" ]]; then
+  echo "Compiling sqlite3.c..."
+  "$CC" "${FLAGS[@]}" -DSQLITE_THREADSAFE=1 -DSQLITE_OMIT_LOAD_EXTENSION \
+    -c "$SQLITE_DIR/sqlite3.c" -o "$SQLITE_OBJECT"
+fi
+
+echo "Compiling the allocator benchmark..."
+"$CXX" -std=c++17 "${FLAGS[@]}" -DOP_SQLITE_USE_POOL_ALLOCATOR \
+  -I"$SQLITE_DIR" -I"$ROOT_DIR/cpp" "$ROOT_DIR/cpp/OPAllocator.cpp" \
+  "$BENCH_DIR/main.cpp" "$SQLITE_OBJECT" -lpthread -lm \
+  -o "$BUILD_DIR/allocator-bench"
+
+"$BUILD_DIR/allocator-bench" --dir "$BUILD_DIR" "$@"
+"$BUILD_DIR/allocator-bench" --dir "$BUILD_DIR" --pool "$@"
@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+
+# Builds the tokenizers of a c_sources folder into a Linux/macOS binary with an
+# FTS5 enabled sqlite3.c, then checks and benchmarks them with
+# scripts/tokenizer-bench. Arguments go to the harness, by default the
+# tokenizers of the example app are measured:
+#
+#   ./scripts/bench-tokenizers.sh
+#   ./scripts/bench-tokenizers.sh --docs 100000 "wordtokenizer remove_diacritics 0"
+#   ./scripts/bench-tokenizers.sh --corpus mails=/path/to/mails.txt portertokenizer
+#   ./scripts/bench-tokenizers.sh --words /path/to/words.txt
+#
+# C_SOURCES_DIR       tokenizers to build (default: example/c_sources)
+# SQLITE_DIR          folder with sqlite3.c and sqlite3.h, downloaded when missing
+# OP_SQLITE_SANITIZE  set to 1 to build with AddressSanitizer and UBSan
+
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_DIR="$ROOT_DIR/scripts/tokenizer-bench"
+BUILD_DIR="$BENCH_DIR/build"
+C_SOURCES_DIR="${C_SOURCES_DIR:-"$ROOT_DIR/example/c_sources"}"
+SQLITE_DIR="${SQLITE_DIR:-"$BUILD_DIR/sqlite"}"
+CC="${CC:-cc}"
+CXX="${CXX:-c++}"
+
+if [[ ! -f "$C_SOURCES_DIR/tokenizers.h" ]]; then
+  echo "Error: $C_SOURCES_DIR/tokenizers.h not found, run pod install first to generate it." >&2
+  exit 1
+fi
+
+if [[ ! -f "$SQLITE_DIR/sqlite3.c" ]]; then
+  "$ROOT_DIR/scripts/download-latest-sqlite-amalgamation.sh" "$SQLITE_DIR"
+fi
+
+FLAGS=(-O2 -g)
+if [[ "${OP_SQLITE_SANITIZE:-0}" == "1" ]]; then
+  FLAGS=(-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined)
+fi
+
+mkdir -p "$BUILD_DIR"
+
+SQLITE_OBJECT="$BUILD_DIR/sqlite3-${OP_SQLITE_SANITIZE:-0}.o"
+if [[ ! -f "$SQLITE_OBJECT" || "$SQLITE_DIR/sqlite3.c" -nt "$SQLITE_OBJECT" ]]; then
+  echo "Compiling sqlite3.c..."
+  "$CC" "${FLAGS[@]}" -DSQLITE_ENABLE_FTS5 -DSQLITE_THREADSAFE=0 \
+    -DSQLITE_OMIT_LOAD_EXTENSION -c "$SQLITE_DIR/sqlite3.c" -o "$SQLITE_OBJECT"
+fi
+
+echo "Compiling the tokenizers in $C_SOURCES_DIR..."
+"$CXX" -std=c++17 "${FLAGS[@]}" -I"$SQLITE_DIR" -I"$C_SOURCES_DIR" \
+  "$C_SOURCES_DIR"/*.cpp "$BENCH_DIR/main.cpp" "$SQLITE_OBJECT" \
+  -lpthread -lm -o "$BUILD_DIR/tokenizer-bench"
+
+# Without a tokenizer spec among the arguments, measure the example ones
+HAS_SPEC=0
+HAS_WORDS=0
+ARGS=("$@")
+for ((i = 0; i < ${#ARGS[@]}; i++)); do
+  case "${ARGS[i]}" in
+    --words) HAS_WORDS=1; i=$((i + 1)) ;;
+    --docs | --seed | --corpus | --cases) i=$((i + 1)) ;;
+    *) HAS_SPEC=1 ;;
+  esac
+done
+if [[ "$HAS_SPEC" == "0" ]]; then
+  set -- "$@" wordtokenizer portertokenizer
+fi
+# The system word list makes a more realistic english corpus than the
+# built-in vocabulary
+if [[ "$HAS_WORDS" == "0" && -f /usr/share/dict/words ]]; then
+  set -- --words /usr/share/dict/words "$@"
+fi
+
+exec "$BUILD_DIR/tokenizer-bench" --cases "$BENCH_DIR/cases.txt" "$@"
@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+
+# Builds the HTTP client of the Turso bridge into a Linux/macOS binary and runs
+# scripts/turso-http-test against a stand-in server on 127.0.0.1:
+#
+#   ./scripts/test-turso-http.sh
+#
+# OP_SQLITE_SANITIZE  set to 1 to build with AddressSanitizer and UBSan
+
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+TEST_DIR="$ROOT_DIR/scripts/turso-http-test"
+BUILD_DIR="$TEST_DIR/build"
+CXX="${CXX:-c++}"
+
+FLAGS=(-O1 -g)
+if [[ "${OP_SQLITE_SANITIZE:-0}" == "1" ]]; then
+  FLAGS=(-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined)
+fi
+
+mkdir -p "$BUILD_DIR"
+
+echo "Compiling the Turso HTTP client..."
+"$CXX" -std=c++17 "${FLAGS[@]}" -I"$ROOT_DIR/cpp/turso" \
+  "$ROOT_DIR/cpp/turso/OPTursoHttp.cpp" "$TEST_DIR/main.cpp" \
+  -lpthread -o "$BUILD_DIR/turso-http-test"
+
+exec "$BUILD_DIR/turso-http-test"
@@ -0,0 +1,1071 @@
+// Correctness checks and benchmarks for the tokenizers in c_sources, outside
+// of a device. The tokenizers are registered the way opsqlite_open does it,
+// through TOKENIZER_LIST, then for every tokenizer spec:
+//   - the expectations of the cases file are checked
+//   - the token offsets of every document and of random bytes are checked
+//   - every corpus is tokenized (tokens/s), indexed into an FTS5 table (build
+//     time, index size, distinct terms) and queried (term and prefix query
+//     latency, recall of words known to be in a document)
+//
+//   tokenizer-bench [--docs N] [--seed N] [--words file]
+//                   [--corpus name=file]... [--cases file] [spec]...
+//
+// A spec is what goes into tokenize = '...', e.g. "wordtokenizer
+// remove_diacritics 0", arguments are separated by spaces. The built-in
+// unicode61 is always measured as a baseline. A corpus file holds one
+// document per line, without any the english, cjk and chat corpora are
+// generated. The english one draws from a word list, e.g.
+// /usr/share/dict/words, or else from words derived from a few hundred
+// stems, in both cases with a Zipf distribution. Exits with 1 when a check
+// fails.
+
+#include "tokenizers.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace opsqlite;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+struct Options {
+  size_t documents = 20000;
+  unsigned seed = 1;
+  std::vector<std::pair<std::string, std::string>> corpus_files;
+  // Word list of the english corpus, one per line
+  std::string words_path;
+  std::string cases_path;
+  std::vector<std::string> specs;
+};
+
+// Corpora
+
+struct Corpus {
+  std::string name;
+  std::vector<std::string> documents;
+  // A word, as written, known to be in the document at index first
+  std::vector<std::pair<size_t, std::string>> probes;
+};
+
+class Generator {
+public:
+  explicit Generator(unsigned seed) : rng(seed) {}
+
+  // Picks from words with a Zipf distribution, the first ones are the common
+  // ones
+  template <size_t N> const char *zipf(const char *const (&words)[N]) {
+    static std::discrete_distribution<size_t> pick = [] {
+      std::vector<double> weights(N);
+      for (size_t i = 0; i < N; i++) {
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+      }
+      return std::discrete_distribution<size_t>(weights.begin(),
+                                                weights.end());
+    }();
+    return words[pick(rng)];
+  }
+
+  template <size_t N> const char *any(const char *const (&words)[N]) {
+    return words[between(0, N - 1)];
+  }
+
+  size_t between(size_t low, size_t high) {
+    return std::uniform_int_distribution<size_t>(low, high)(rng);
+  }
+
+  bool chance(double p) { return std::bernoulli_distribution(p)(rng); }
+
+  std::mt19937 rng;
+};
+
+// The most common English words, they head the Zipf ranking of the english
+// corpus
+constexpr const char *function_words[] = {
+    "the",   "of",    "and",   "to",    "a",     "in",    "is",    "it",
+    "that",  "was",   "for",   "on",    "are",   "with",  "they",  "be",
+    "at",    "one",   "have",  "this",  "from",  "by",    "but",   "what",
+    "some",  "we",    "can",   "out",   "other", "were",  "all",   "there",
+    "when",  "up",    "your",  "how",   "said",  "each",  "which", "she",
+    "do",    "their", "if",    "will",  "about", "many",  "then",  "them",
+    "would", "so",    "these", "her",   "him",   "has",   "more",  "could",
+    "did",   "no",    "not",   "my",    "than",  "been",  "who",   "its",
+    "now",   "only",  "into",  "over",  "also",  "after", "our",   "any",
+    "where", "most",  "just",  "very",  "those", "such",  "while", "should",
+};
+
+// Stems the rest of the vocabulary is derived from with regular English
+// morphology, so the stemmer sees the inflections and derivations real text
+// has instead of a handful of hand-picked forms
+constexpr const char *stems[] = {
+    "accept",   "account",  "act",      "add",      "adjust",   "admire",
+    "adopt",    "advance",  "advise",   "afford",   "agree",    "alarm",
+    "allow",    "amaze",    "announce", "appear",   "apply",    "approve",
+    "argue",    "arrange",  "arrive",   "assist",   "attach",   "attack",
+    "attempt",  "attend",   "attract",  "avoid",    "bake",     "balance",
+    "bless",    "block",    "boil",     "book",     "borrow",   "bounce",
+    "break",    "breathe",  "brush",    "build",    "burn",     "calculate",
+    "call",     "care",     "carry",    "cause",    "celebrate", "challenge",
+    "change",   "charge",   "chase",    "check",    "cheer",    "claim",
+    "clean",    "clear",    "close",    "collect",  "combine",  "comfort",
+    "command",  "compare",  "compete",  "complain", "complete", "compute",
+    "concern",  "confess",  "confirm",  "confuse",  "connect",  "consider",
+    "consist",  "contain",  "continue", "control",  "convert",  "cook",
+    "correct",  "count",    "cover",    "crack",    "create",   "cross",
+    "cure",     "damage",   "dance",    "deal",     "decide",   "declare",
+    "decorate", "defend",   "deliver",  "demand",   "depend",   "describe",
+    "deserve",  "design",   "destroy",  "detect",   "develop",  "differ",
+    "direct",   "discover", "divide",   "doubt",    "drain",    "dream",
+    "dress",    "drift",    "earn",     "educate",  "embarrass", "employ",
+    "empty",    "encourage", "end",     "enjoy",    "enter",    "entertain",
+    "escape",   "examine",  "excite",   "excuse",   "exercise", "exist",
+    "expand",   "expect",   "explain",  "explode",  "express",  "extend",
+    "fail",     "fasten",   "fear",     "fetch",    "fill",     "film",
+    "fix",      "flash",    "float",    "flow",     "fold",     "follow",
+    "force",    "form",     "found",    "frame",    "gather",   "generate",
+    "govern",   "grab",     "grant",    "greet",    "grind",    "guard",
+    "guess",    "guide",    "hand",     "handle",   "happen",   "harm",
+    "hate",     "heal",     "help",     "hope",     "hunt",     "hurry",
+    "identify", "ignore",   "imagine",  "impress",  "improve",  "include",
+    "increase", "index",    "inform",   "inject",   "insert",   "inspect",
+    "instruct", "intend",   "interest", "interrupt", "introduce", "invent",
+    "invite",   "join",     "judge",    "jump",     "kick",     "kill",
+    "kiss",     "knock",    "label",    "land",     "last",     "laugh",
+    "launch",   "learn",    "level",    "lift",     "light",    "limit",
+    "list",     "listen",   "load",     "lock",     "look",     "love",
+    "manage",   "mark",     "match",    "matter",   "measure",  "melt",
+    "mention",  "mind",     "miss",     "mix",      "move",     "name",
+    "need",     "nest",     "note",     "notice",   "number",   "obey",
+    "object",   "observe",  "obtain",   "occur",    "offend",   "offer",
+    "open",     "operate",  "order",    "organize", "own",      "paint",
+    "park",     "part",     "pass",     "pause",    "perform",  "permit",
+    "pick",     "place",    "plan",     "plant",    "play",     "please",
+    "point",    "polish",   "possess",  "post",     "pour",     "practice",
+    "pray",     "prefer",   "prepare",  "present",  "preserve", "press",
+    "pretend",  "prevent",  "print",    "process",  "produce",  "profit",
+    "program",  "promise",  "protect",  "provide",  "publish",  "pull",
+    "punish",   "push",     "query",    "question", "rain",     "reach",
+    "read",     "realize",  "receive",  "record",   "reduce",   "reflect",
+    "refuse",   "regret",   "reign",    "reject",   "relate",   "relax",
+    "release",  "rely",     "remain",   "remember", "remind",   "remove",
+    "repair",   "repeat",   "replace",  "reply",    "report",   "request",
+    "rescue",   "resist",   "respect",  "rest",     "return",   "reveal",
+    "review",   "reward",   "risk",     "rule",     "rush",     "sail",
+    "satisfy",  "save",     "scatter",  "search",   "seal",     "select",
+    "settle",   "shape",    "share",    "shelter",  "shift",    "shock",
+    "sign",     "signal",   "smell",    "smile",    "solve",    "sort",
+    "sound",    "spark",    "spell",    "spoil",    "spray",    "start",
+    "stay",     "steer",    "stem",     "step",     "store",    "strengthen",
+    "stretch",  "study",    "succeed",  "suffer",   "suggest",  "supply",
+    "support",  "suppose",  "surprise", "surround", "suspect",  "switch",
+    "talk",     "taste",    "teach",    "tempt",    "test",     "thank",
+    "tire",     "token",    "touch",    "tour",     "trace",    "trade",
+    "train",    "transfer", "transform", "travel",  "treat",    "trust",
+    "try",      "turn",     "type",     "unite",    "use",      "value",
+    "vanish",   "visit",    "wait",     "walk",     "want",     "warm",
+    "warn",     "wash",     "waste",    "watch",    "wave",     "weigh",
+    "welcome",  "whisper",  "wish",     "wonder",   "work",     "worry",
+    "wrap",     "write",    "yell",     "zone",
+};
+
+constexpr const char *prefixes[] = {"", "", "", "", "re", "un", "pre",
+                                    "over", "dis", "mis", "under", "co"};
+
+constexpr const char *suffixes[] = {
+    "",      "s",     "ed",    "ing",    "er",     "ers",    "ly",
+    "ness",  "ment",  "ments", "able",   "ably",   "ation",  "ations",
+    "ful",   "fully", "less",  "ive",    "ively",  "ion",    "ions",
+    "al",    "ally",  "ize",   "izes",   "ized",   "izing",  "ization",
+    "ist",   "ism",   "ity",   "ities",  "ous",    "ously",  "ance",
+    "ence",  "ant",   "ent",   "ency",   "ingly",  "edly",   "iveness",
+};
+
+// Words with diacritics and capitals, for the folding of the tokenizers
+constexpr const char *accented_words[] = {
+    "café",  "naïve",   "résumé", "façade",  "jalapeño", "Zürich",
+    "München", "São",   "Paulo",  "Ångström", "fiancée", "crème",
+    "brûlée",  "déjà",  "vu",     "coöperate", "élite",  "señor",
+};
+
+// stem + suffix with the usual spelling changes: a silent e goes before a
+// vowel, a y after a consonant turns into i
+std::string attach(const std::string &stem, const char *suffix) {
+  if (*suffix == '\0') {
+    return stem;
+  }
+  auto is_vowel = [](char c) {
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+  };
+  std::string word = stem;
+  char last = word.back();
+  if (last == 'e' && (is_vowel(suffix[0]) || suffix[0] == 'y')) {
+    word.pop_back();
+  } else if (last == 'y' && word.size() > 1 &&
+             !is_vowel(word[word.size() - 2]) && suffix[0] != 'i') {
+    word.back() = 'i';
+  } else if ((last == 's' || last == 'x' || last == 'h') &&
+             strcmp(suffix, "s") == 0) {
+    word += 'e';
+  }
+  return word + suffix;
+}
+
+// Words of the english corpus, most frequent first, with a Zipf
+// distribution over them like in natural text
+struct Vocabulary {
+  std::vector<std::string> words;
+  std::discrete_distribution<size_t> pick;
+
+  const std::string &next(std::mt19937 &rng) { return words[pick(rng)]; }
+};
+
+Vocabulary english_vocabulary(unsigned seed, const std::string &words_path) {
+  Vocabulary vocabulary;
+  for (const char *word : function_words) {
+    vocabulary.words.emplace_back(word);
+  }
+
+  std::vector<std::string> rest;
+  if (!words_path.empty()) {
+    std::ifstream file(words_path, std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Cannot read word list %s\n", words_path.c_str());
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      // Possessives fill a lot of system word lists
+      if (!line.empty() && line.find('\'') == std::string::npos) {
+        rest.push_back(std::move(line));
+      }
+    }
+  } else {
+    for (const char *stem : stems) {
+      for (const char *prefix : prefixes) {
+        for (const char *suffix : suffixes) {
+          rest.push_back(prefix + attach(stem, suffix));
+        }
+      }
+    }
+    for (const char *word : accented_words) {
+      rest.emplace_back(word);
+    }
+  }
+  std::sort(rest.begin(), rest.end());
+  rest.erase(std::unique(rest.begin(), rest.end()), rest.end());
+
+  // The rank of a word has nothing to do with its spelling
+  std::mt19937 rng(seed);
+  std::shuffle(rest.begin(), rest.end(), rng);
+  for (auto &word : rest) {
+    vocabulary.words.push_back(std::move(word));
+  }
+
+  std::vector<double> weights(vocabulary.words.size());
+  for (size_t i = 0; i < weights.size(); i++) {
+    weights[i] = 1.0 / static_cast<double>(i + 1);
+  }
+  vocabulary.pick =
+      std::discrete_distribution<size_t>(weights.begin(), weights.end());
+  return vocabulary;
+}
+
+constexpr const char *chinese_words[] = {
+    "我们", "中国", "今天", "天气", "非常", "学习", "工作", "时间",
+    "朋友", "电话", "手机", "问题", "公司", "北京", "上海", "数据",
+    "数据库", "搜索", "索引", "查询", "应用", "用户", "文件", "网络",
+    "开发", "测试", "性能", "速度", "系统", "服务", "手册", "文档",
+};
+
+constexpr const char *japanese_words[] = {
+    "今日", "は", "いい", "天気", "です", "ね", "東京", "タワー",
+    "に", "行きました", "データベース", "検索", "インデックス", "を", "使う",
+    "アプリ", "ユーザー", "の", "ファイル", "速い", "テスト", "します",
+    "日本語", "文章", "カタカナ", "ひらがな", "漢字", "が", "あります",
+};
+
+constexpr const char *korean_words[] = {
+    "안녕하세요", "오늘", "날씨가", "좋네요", "감사합니다", "데이터베이스",
+    "검색", "인덱스", "사용자", "파일", "테스트", "빠른", "서울",
+    "한국어", "문장", "있습니다", "없습니다", "그리고", "하지만",
+};
+
+constexpr const char *chat_words[] = {
+    "lol",     "ok",      "yeah",    "omg",     "haha",    "thx",
+    "pls",     "idk",     "brb",     "gonna",   "wanna",   "sooo",
+    "hey",     "meeting", "lunch",   "running", "late",    "tmrw",
+    "sure",    "nope",    "yes",     "see",     "you",     "there",
+    "coffee",  "later",   "tonight", "call",    "me",      "back",
+    "sorry",   "great",   "awesome", "deploy",  "fixed",   "broken",
+    "build",   "release", "weekend", "party",   "OMG",     "WHAT",
+    "Thanks",  "café",    "naïve",   "déjà",    "vu",      "hahaha",
+};
+
+constexpr const char *chat_extras[] = {
+    "😀", "😂", "👍", "❤️", "🎉", "🔥", "🙏", "👨‍👩‍👧", "👍🏽", "🇯🇵", "🤔", "😅",
+    "@alex", "@sam", "#release", "#friday", "https://example.com/a?b=1",
+    "10:30", "2pm", "!!!", "???", "...", ":)", ":-(",
+};
+
+bool is_plain_word(const char *word) {
+  for (const char *c = word; *c != '\0'; c++) {
+    auto byte = static_cast<unsigned char>(*c);
+    if (byte < 0x80 && !((byte >= 'a' && byte <= 'z') ||
+                         (byte >= 'A' && byte <= 'Z'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Corpus english_corpus(Generator &gen, Vocabulary &vocabulary, size_t count) {
+  Corpus corpus{"english", {}, {}};
+  for (size_t d = 0; d < count; d++) {
+    std::string doc;
+    std::vector<const char *> used;
+    size_t sentences = gen.between(1, 6);
+    for (size_t s = 0; s < sentences; s++) {
+      size_t words = gen.between(5, 20);
+      for (size_t w = 0; w < words; w++) {
+        const char *word = vocabulary.next(gen.rng).c_str();
+        used.push_back(word);
+        if (!doc.empty()) {
+          doc += ' ';
+        }
+        size_t at = doc.size();
+        doc += word;
+        if (w == 0 && doc[at] >= 'a' && doc[at] <= 'z') {
+          doc[at] = static_cast<char>(doc[at] - 32);
+        }
+        if (w + 1 < words && gen.chance(0.08)) {
+          doc += ',';
+        }
+      }
+      doc += gen.any({".", "!", "?", "."});
+    }
+    if (d % 20 == 0) {
+      corpus.probes.emplace_back(d, used[gen.between(0, used.size() - 1)]);
+    }
+    corpus.documents.push_back(std::move(doc));
+  }
+  return corpus;
+}
+
+Corpus cjk_corpus(Generator &gen, size_t count) {
+  Corpus corpus{"cjk", {}, {}};
+  for (size_t d = 0; d < count; d++) {
+    std::string doc;
+    std::vector<const char *> used;
+    size_t language = gen.between(0, 2);
+    size_t sentences = gen.between(1, 4);
+    for (size_t s = 0; s < sentences; s++) {
+      size_t words = gen.between(4, 12);
+      for (size_t w = 0; w < words; w++) {
+        const char *word = language == 0   ? gen.zipf(chinese_words)
+                           : language == 1 ? gen.zipf(japanese_words)
+                                           : gen.zipf(korean_words);
+        used.push_back(word);
+        // Only Korean separates words with spaces
+        if (language == 2 && w > 0) {
+          doc += ' ';
+        }
+        doc += word;
+        if (language != 2 && w + 1 < words && gen.chance(0.1)) {
+          doc += "、";
+        }
+      }
+      doc += language == 2 ? ". " : "。";
+    }
+    if (d % 20 == 0) {
+      corpus.probes.emplace_back(d, used[gen.between(0, used.size() - 1)]);
+    }
+    corpus.documents.push_back(std::move(doc));
+  }
+  return corpus;
+}
+
+Corpus chat_corpus(Generator &gen, size_t count) {
+  Corpus corpus{"chat", {}, {}};
+  for (size_t d = 0; d < count; d++) {
+    std::string doc;
+    std::vector<const char *> used;
+    size_t items = gen.between(3, 15);
+    for (size_t i = 0; i < items; i++) {
+      bool extra = gen.chance(0.3);
+      const char *item = extra ? gen.any(chat_extras) : gen.zipf(chat_words);
+      if (!extra) {
+        used.push_back(item);
+      }
+      // Emoji are often glued to the word before them
+      if (!doc.empty() && !(extra && gen.chance(0.4))) {
+        doc += ' ';
+      }
+      doc += item;
+    }
+    if (d % 20 == 0 && !used.empty()) {
+      const char *word = used[gen.between(0, used.size() - 1)];
+      if (is_plain_word(word)) {
+        corpus.probes.emplace_back(d, word);
+      }
+    }
+    corpus.documents.push_back(std::move(doc));
+  }
+  return corpus;
+}
+
+bool load_corpus(const std::string &name, const std::string &path,
+                 Corpus &corpus) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fprintf(stderr, "Cannot read corpus %s\n", path.c_str());
+    return false;
+  }
+  corpus.name = name;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty()) {
+      corpus.documents.push_back(std::move(line));
+    }
+  }
+  return true;
+}
+
+// SQLite
+
+sqlite3 *open_database() {
+  sqlite3 *db = nullptr;
+  if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+    fprintf(stderr, "Cannot open a database: %s\n", sqlite3_errmsg(db));
+    exit(1);
+  }
+  char *errMsg = nullptr;
+  TOKENIZER_LIST
+  sqlite3_free(errMsg);
+  return db;
+}
+
+fts5_api *fts5_api_of(sqlite3 *db) {
+  fts5_api *api = nullptr;
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT fts5(?1)", -1, &statement, nullptr) ==
+      SQLITE_OK) {
+    sqlite3_bind_pointer(statement, 1, &api, "fts5_api_ptr", nullptr);
+    sqlite3_step(statement);
+  }
+  sqlite3_finalize(statement);
+  if (api == nullptr) {
+    fprintf(stderr, "SQLite was built without FTS5\n");
+    exit(1);
+  }
+  return api;
+}
+
+bool exec(sqlite3 *db, const std::string &sql) {
+  char *error = nullptr;
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+    fprintf(stderr, "%s: %s\n", sql.c_str(), error);
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+int64_t query_int(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *statement = nullptr;
+  int64_t value = -1;
+  if (sqlite3_prepare_v2(db, sql, -1, &statement, nullptr) == SQLITE_OK &&
+      sqlite3_step(statement) == SQLITE_ROW) {
+    value = sqlite3_column_int64(statement, 0);
+  }
+  sqlite3_finalize(statement);
+  return value;
+}
+
+std::string quote(const std::string &value, char mark) {
+  std::string quoted(1, mark);
+  for (char c : value) {
+    quoted += c;
+    if (c == mark) {
+      quoted += c;
+    }
+  }
+  quoted += mark;
+  return quoted;
+}
+
+// Tokenizers
+
+std::vector<std::string> split_spec(const std::string &spec) {
+  std::vector<std::string> parts;
+  std::string part;
+  for (char c : spec) {
+    if (c == ' ' || c == '\t') {
+      if (!part.empty()) {
+        parts.push_back(std::move(part));
+        part.clear();
+      }
+    } else {
+      part += c;
+    }
+  }
+  if (!part.empty()) {
+    parts.push_back(std::move(part));
+  }
+  return parts;
+}
+
+struct Token {
+  std::string text;
+  int flags;
+  int start;
+  int end;
+};
+
+int collect_token(void *ctx, int flags, const char *token, int length,
+                  int start, int end) {
+  static_cast<std::vector<Token> *>(ctx)->push_back(
+      {std::string(token, static_cast<size_t>(std::max(length, 0))), flags,
+       start, end});
+  return SQLITE_OK;
+}
+
+int count_token(void *ctx, int, const char *, int, int, int) {
+  (*static_cast<size_t *>(ctx))++;
+  return SQLITE_OK;
+}
+
+// An instance of the tokenizer of a spec, created the way FTS5 does it for
+// tokenize = 'spec'
+class Tokenizer {
+public:
+  Tokenizer(fts5_api *fts, const std::string &spec) {
+    auto parts = split_spec(spec);
+    void *context = nullptr;
+    if (parts.empty() || fts->xFindTokenizer(fts, parts[0].c_str(), &context,
+                                             &api) != SQLITE_OK) {
+      return;
+    }
+    registered = true;
+    std::vector<const char *> args;
+    for (size_t i = 1; i < parts.size(); i++) {
+      args.push_back(parts[i].c_str());
+    }
+    if (api.xCreate(context, args.data(), static_cast<int>(args.size()),
+                    &instance) != SQLITE_OK) {
+      instance = nullptr;
+    }
+  }
+  Tokenizer(const Tokenizer &) = delete;
+  Tokenizer &operator=(const Tokenizer &) = delete;
+  ~Tokenizer() {
+    if (instance != nullptr) {
+      api.xDelete(instance);
+    }
+  }
+
+  bool registered = false;
+  bool created() const { return instance != nullptr; }
+
+  int tokenize(const std::string &text, int flags, void *ctx,
+               int (*on_token)(void *, int, const char *, int, int, int)) {
+    return api.xTokenize(instance, ctx, flags, text.data(),
+                         static_cast<int>(text.size()), on_token);
+  }
+
+  std::vector<Token> tokens(const std::string &text, int flags) {
+    std::vector<Token> out;
+    tokenize(text, flags, &out, collect_token);
+    return out;
+  }
+
+private:
+  fts5_tokenizer api{};
+  Fts5Tokenizer *instance = nullptr;
+};
+
+// What is wrong with the tokens of a text of length bytes, empty if nothing
+std::string check_tokens(const std::vector<Token> &tokens, int length) {
+  for (size_t i = 0; i < tokens.size(); i++) {
+    const Token &token = tokens[i];
+    if (token.text.empty()) {
+      return "empty token";
+    }
+    if (token.start < 0 || token.end > length || token.start > token.end) {
+      return "offsets " + std::to_string(token.start) + "-" +
+             std::to_string(token.end) + " outside of the " +
+             std::to_string(length) + " bytes of the text";
+    }
+    if (i == 0 && (token.flags & FTS5_TOKEN_COLOCATED) != 0) {
+      return "first token is colocated";
+    }
+  }
+  return "";
+}
+
+std::string printable(const std::string &text) {
+  std::string out;
+  for (unsigned char c : text) {
+    if (c < 0x20 || c >= 0x7F) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+      out += escaped;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  return out;
+}
+
+std::string join_tokens(const std::vector<Token> &tokens) {
+  std::string out;
+  for (const auto &token : tokens) {
+    if (!out.empty()) {
+      out += ' ';
+    }
+    if ((token.flags & FTS5_TOKEN_COLOCATED) != 0) {
+      out += '+';
+    }
+    out += token.text;
+  }
+  return out;
+}
+
+std::string trim(const std::string &value) {
+  size_t start = value.find_first_not_of(" \t\r");
+  if (start == std::string::npos) {
+    return "";
+  }
+  size_t end = value.find_last_not_of(" \t\r");
+  return value.substr(start, end - start + 1);
+}
+
+// Checks
+
+int failures = 0;
+
+void fail(const std::string &message) {
+  fprintf(stderr, "FAIL %s\n", message.c_str());
+  failures++;
+}
+
+// Lines of `spec | text | tokens`, the tokens separated by spaces and the
+// colocated ones marked with a '+'
+void run_cases(fts5_api *fts, const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fail("cannot read the cases in " + path);
+    return;
+  }
+  size_t passed = 0;
+  size_t skipped = 0;
+  std::string line;
+  for (int number = 1; std::getline(file, line); number++) {
+    if (trim(line).empty() || trim(line)[0] == '#') {
+      continue;
+    }
+    size_t first = line.find('|');
+    size_t second =
+        first == std::string::npos ? first : line.find('|', first + 1);
+    if (second == std::string::npos) {
+      fail(path + ":" + std::to_string(number) +
+           " is not spec | text | tokens");
+      continue;
+    }
+    std::string spec = trim(line.substr(0, first));
+    std::string text = trim(line.substr(first + 1, second - first - 1));
+    std::string expected = trim(line.substr(second + 1));
+
+    Tokenizer tokenizer(fts, spec);
+    if (!tokenizer.registered) {
+      skipped++;
+      continue;
+    }
+    if (!tokenizer.created()) {
+      fail(path + ":" + std::to_string(number) + " '" + spec +
+           "' rejected its arguments");
+      continue;
+    }
+    std::string actual =
+        join_tokens(tokenizer.tokens(text, FTS5_TOKENIZE_DOCUMENT));
+    if (actual != expected) {
+      fail(path + ":" + std::to_string(number) + " '" + spec + "' on \"" +
+           text + "\"\n  expected: " + expected + "\n  actual:   " + actual);
+      continue;
+    }
+    passed++;
+  }
+  printf("cases: %zu passed, %d failed, %zu skipped (tokenizer not "
+         "registered)\n",
+         passed, failures, skipped);
+}
+
+// Token offsets on every document and on random bytes, with malformed UTF-8
+// among them
+void check_contract(fts5_api *fts, const std::string &spec,
+                    const std::vector<Corpus> &corpora, unsigned seed) {
+  Tokenizer tokenizer(fts, spec);
+  for (const auto &corpus : corpora) {
+    for (const auto &doc : corpus.documents) {
+      for (int flags : {FTS5_TOKENIZE_DOCUMENT, FTS5_TOKENIZE_QUERY}) {
+        auto problem = check_tokens(tokenizer.tokens(doc, flags),
+                                    static_cast<int>(doc.size()));
+        if (!problem.empty()) {
+          fail("'" + spec + "' " + problem + " on \"" + printable(doc) + "\"");
+          return;
+        }
+      }
+    }
+  }
+
+  static const char *pieces[] = {
+      "a",  "Z",  "9",    " ",    ",",    "_",        "-",    "'",
+      "é",  "É",  "ß",    "İ",    "東",   "😀",       "👍🏽", "\xcc\x81",
+      "\xff", "\xc3", "\xe2\x80", "\xf0\x9f", "\xed\xa0\x80", "\xc0\xaf",
+      "\xf4\x90\x80\x80", "abcdefghijklmnopqrstu", "ABCDEFGHIJKLMNOPQRSTU",
+  };
+  std::mt19937 rng(seed);
+  for (int i = 0; i < 20000; i++) {
+    std::string text;
+    size_t count = rng() % 24;
+    for (size_t k = 0; k < count; k++) {
+      if (rng() % 8 == 0) {
+        text += static_cast<char>(rng() % 256);
+      } else {
+        text += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+      }
+    }
+    auto problem = check_tokens(tokenizer.tokens(text, FTS5_TOKENIZE_DOCUMENT),
+                                static_cast<int>(text.size()));
+    if (!problem.empty()) {
+      fail("'" + spec + "' " + problem + " on \"" + printable(text) + "\"");
+      return;
+    }
+  }
+}
+
+// Benchmarks
+
+struct Result {
+  size_t tokens = 0;
+  double tokens_per_second = 0;
+  double megabytes_per_second = 0;
+  double build_ms = 0;
+  int64_t index_bytes = 0;
+  int64_t terms = 0;
+  double term_p50 = 0;
+  double term_p95 = 0;
+  double prefix_p50 = 0;
+  double prefix_p95 = 0;
+  // -1 when the corpus has no probes
+  double recall = -1;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  auto index = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+  return values[index];
+}
+
+size_t utf8_prefix(const std::string &value, size_t characters) {
+  size_t i = 0;
+  while (i < value.size() && characters > 0) {
+    i++;
+    while (i < value.size() && (value[i] & 0xC0) == 0x80) {
+      i++;
+    }
+    characters--;
+  }
+  return i;
+}
+
+// Microseconds each of the MATCH expressions takes to count its rows
+std::vector<double> time_queries(sqlite3 *db,
+                                 const std::vector<std::string> &matches) {
+  std::vector<double> times;
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT count(*) FROM t WHERE t MATCH ?", -1,
+                         &statement, nullptr) != SQLITE_OK) {
+    fail(std::string("prepare a query: ") + sqlite3_errmsg(db));
+    return times;
+  }
+  for (const auto &match : matches) {
+    auto start = Clock::now();
+    sqlite3_bind_text(statement, 1, match.data(),
+                      static_cast<int>(match.size()), SQLITE_STATIC);
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+    }
+    sqlite3_reset(statement);
+    times.push_back(elapsed_ms(start) * 1000);
+  }
+  sqlite3_finalize(statement);
+  return times;
+}
+
+bool benchmark(fts5_api *fts, const std::string &spec, const Corpus &corpus,
+               Result &result) {
+  // Tokenizing alone, passes until at least 200ms went by
+  Tokenizer tokenizer(fts, spec);
+  size_t bytes = 0;
+  for (const auto &doc : corpus.documents) {
+    bytes += doc.size();
+  }
+  size_t passes = 0;
+  size_t tokens = 0;
+  auto start = Clock::now();
+  double ms = 0;
+  do {
+    tokens = 0;
+    for (const auto &doc : corpus.documents) {
+      tokenizer.tokenize(doc, FTS5_TOKENIZE_DOCUMENT, &tokens, count_token);
+    }
+    passes++;
+    ms = elapsed_ms(start);
+  } while (ms < 200);
+  result.tokens = tokens;
+  result.tokens_per_second =
+      static_cast<double>(tokens * passes) / (ms / 1000);
+  result.megabytes_per_second =
+      static_cast<double>(bytes * passes) / (ms / 1000) / (1024 * 1024);
+
+  // Index
+  sqlite3 *db = open_database();
+  bool ok =
+      exec(db, "CREATE VIRTUAL TABLE t USING fts5(content, tokenize = " +
+                   quote(spec, '\'') + ")") &&
+      exec(db, "CREATE VIRTUAL TABLE v USING fts5vocab(t, 'row')");
+  if (!ok) {
+    sqlite3_close(db);
+    return false;
+  }
+  sqlite3_stmt *insert = nullptr;
+  sqlite3_prepare_v2(db, "INSERT INTO t(rowid, content) VALUES (?, ?)", -1,
+                     &insert, nullptr);
+  start = Clock::now();
+  exec(db, "BEGIN");
+  for (size_t i = 0; i < corpus.documents.size(); i++) {
+    const auto &doc = corpus.documents[i];
+    sqlite3_bind_int64(insert, 1, static_cast<sqlite3_int64>(i + 1));
+    sqlite3_bind_text(insert, 2, doc.data(), static_cast<int>(doc.size()),
+                      SQLITE_STATIC);
+    if (sqlite3_step(insert) != SQLITE_DONE) {
+      fail("'" + spec + "' insert: " + sqlite3_errmsg(db));
+      sqlite3_finalize(insert);
+      sqlite3_close(db);
+      return false;
+    }
+    sqlite3_reset(insert);
+  }
+  exec(db, "COMMIT");
+  result.build_ms = elapsed_ms(start);
+  sqlite3_finalize(insert);
+  result.index_bytes = query_int(db, "SELECT sum(length(block)) FROM t_data");
+  result.terms = query_int(db, "SELECT count(*) FROM v");
+
+  // Queries on terms spread over the vocabulary
+  std::vector<std::string> terms;
+  sqlite3_stmt *vocab = nullptr;
+  sqlite3_prepare_v2(db, "SELECT term FROM v", -1, &vocab, nullptr);
+  size_t stride = std::max<int64_t>(1, result.terms / 200);
+  for (size_t i = 0; sqlite3_step(vocab) == SQLITE_ROW; i++) {
+    if (i % stride == 0) {
+      terms.emplace_back(
+          reinterpret_cast<const char *>(sqlite3_column_text(vocab, 0)),
+          static_cast<size_t>(sqlite3_column_bytes(vocab, 0)));
+    }
+  }
+  sqlite3_finalize(vocab);
+  std::vector<std::string> term_matches;
+  std::vector<std::string> prefix_matches;
+  for (const auto &term : terms) {
+    term_matches.push_back(quote(term, '"'));
+    prefix_matches.push_back(quote(term.substr(0, utf8_prefix(term, 2)), '"') +
+                             "*");
+  }
+  auto term_times = time_queries(db, term_matches);
+  auto prefix_times = time_queries(db, prefix_matches);
+  result.term_p50 = percentile(term_times, 0.5);
+  result.term_p95 = percentile(term_times, 0.95);
+  result.prefix_p50 = percentile(prefix_times, 0.5);
+  result.prefix_p95 = percentile(prefix_times, 0.95);
+
+  // Recall of the words known to be in a document
+  if (!corpus.probes.empty()) {
+    sqlite3_stmt *probe = nullptr;
+    sqlite3_prepare_v2(
+        db, "SELECT count(*) FROM t WHERE t MATCH ? AND rowid = ?", -1,
+        &probe, nullptr);
+    size_t hits = 0;
+    for (const auto &[index, word] : corpus.probes) {
+      std::string match = quote(word, '"');
+      sqlite3_bind_text(probe, 1, match.data(), static_cast<int>(match.size()),
+                        SQLITE_STATIC);
+      sqlite3_bind_int64(probe, 2, static_cast<sqlite3_int64>(index + 1));
+      if (sqlite3_step(probe) == SQLITE_ROW &&
+          sqlite3_column_int64(probe, 0) > 0) {
+        hits++;
+      }
+      sqlite3_reset(probe);
+    }
+    sqlite3_finalize(probe);
+    result.recall = 100.0 * static_cast<double>(hits) /
+                    static_cast<double>(corpus.probes.size());
+  }
+
+  sqlite3_close(db);
+  return true;
+}
+
+void print_results(const Corpus &corpus,
+                   const std::vector<std::pair<std::string, Result>> &rows) {
+  size_t bytes = 0;
+  for (const auto &doc : corpus.documents) {
+    bytes += doc.size();
+  }
+  printf("\n%s: %zu documents, %.1f MB\n", corpus.name.c_str(),
+         corpus.documents.size(),
+         static_cast<double>(bytes) / (1024 * 1024));
+  printf("%-36s %10s %8s %7s %9s %9s %8s %13s %13s %7s\n", "tokenizer",
+         "tokens", "Mtok/s", "MB/s", "build ms", "index KB", "terms",
+         "term us p50/95", "prefix p50/95", "recall");
+  for (const auto &[spec, r] : rows) {
+    char recall[16] = "-";
+    if (r.recall >= 0) {
+      snprintf(recall, sizeof(recall), "%.1f%%", r.recall);
+    }
+    printf("%-36s %10zu %8.2f %7.1f %9.0f %9.0f %8lld %6.0f/%-6.0f "
+           "%6.0f/%-6.0f %7s\n",
+           spec.c_str(), r.tokens, r.tokens_per_second / 1e6,
+           r.megabytes_per_second, r.build_ms,
+           static_cast<double>(r.index_bytes) / 1024,
+           static_cast<long long>(r.terms), r.term_p50, r.term_p95,
+           r.prefix_p50, r.prefix_p95, recall);
+  }
+}
+
+void usage() {
+  fprintf(stderr, "usage: tokenizer-bench [--docs N] [--seed N] "
+                  "[--words file] [--corpus name=file]... [--cases file] "
+                  "[spec]...\n");
+  exit(2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        usage();
+      }
+      return argv[++i];
+    };
+    if (arg == "--docs") {
+      options.documents = std::strtoull(value().c_str(), nullptr, 10);
+    } else if (arg == "--seed") {
+      options.seed =
+          static_cast<unsigned>(std::strtoul(value().c_str(), nullptr, 10));
+    } else if (arg == "--corpus") {
+      std::string corpus = value();
+      size_t equals = corpus.find('=');
+      if (equals == std::string::npos) {
+        usage();
+      }
+      options.corpus_files.emplace_back(corpus.substr(0, equals),
+                                        corpus.substr(equals + 1));
+    } else if (arg == "--words") {
+      options.words_path = value();
+    } else if (arg == "--cases") {
+      options.cases_path = value();
+    } else if (arg.rfind("--", 0) == 0) {
+      usage();
+    } else {
+      options.specs.push_back(arg);
+    }
+  }
+  options.specs.insert(options.specs.begin(), "unicode61");
+
+  sqlite3 *db = open_database();
+  fts5_api *fts = fts5_api_of(db);
+
+  if (!options.cases_path.empty()) {
+    run_cases(fts, options.cases_path);
+  }
+
+  std::vector<std::string> specs;
+  for (const auto &spec : options.specs) {
+    Tokenizer tokenizer(fts, spec);
+    if (!tokenizer.created()) {
+      fail("'" + spec + "' is not a registered tokenizer or rejected its "
+                        "arguments");
+      continue;
+    }
+    specs.push_back(spec);
+  }
+
+  std::vector<Corpus> corpora;
+  if (options.corpus_files.empty()) {
+    Generator gen(options.seed);
+    auto vocabulary = english_vocabulary(options.seed, options.words_path);
+    printf("english vocabulary: %zu words\n", vocabulary.words.size());
+    corpora.push_back(english_corpus(gen, vocabulary, options.documents));
+    corpora.push_back(cjk_corpus(gen, options.documents));
+    corpora.push_back(chat_corpus(gen, options.documents));
+  } else {
+    for (const auto &[name, path] : options.corpus_files) {
+      Corpus corpus;
+      if (!load_corpus(name, path, corpus)) {
+        return 1;
+      }
+      corpora.push_back(std::move(corpus));
+    }
+  }
+
+  // SQLite's own tokenizers are only measured
+  for (const auto &spec : specs) {
+    auto name = split_spec(spec)[0];
+    if (name != "unicode61" && name != "ascii" && name != "porter" &&
+        name != "trigram") {
+      check_contract(fts, spec, corpora, options.seed);
+    }
+  }
+
+  for (const auto &corpus : corpora) {
+    std::vector<std::pair<std::string, Result>> rows;
+    for (const auto &spec : specs) {
+      Result result;
+      if (benchmark(fts, spec, corpus, result)) {
+        rows.emplace_back(spec, result);
+      }
+    }
+    print_results(corpus, rows);
+  }
+
+  sqlite3_close(db);
+  if (failures > 0) {
+    fprintf(stderr, "\n%d check(s) failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,312 @@
+// Checks of the HttpClient of the Turso bridge against a stand-in server on
+// 127.0.0.1, outside of a device. Every check scripts the responses of the
+// server and looks at what the client did with them: reused connections,
+// chunked bodies, retries and the urls that are refused.
+//
+//   turso-http-test
+//
+// Exits with 1 when a check fails.
+
+#include "OPTursoHttp.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace opsqlite;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (!condition) {
+    std::fprintf(stderr, "  FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+void write_all(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
+    if (n <= 0) {
+      return;
+    }
+    sent += static_cast<size_t>(n);
+  }
+}
+
+// Reads one request, head and Content-Length body. False once the client
+// closed the connection.
+bool read_request(int fd, std::string &buffer, std::string &request) {
+  while (true) {
+    auto head_end = buffer.find("\r\n\r\n");
+    if (head_end != std::string::npos) {
+      size_t body_size = 0;
+      auto length = buffer.find("Content-Length: ");
+      if (length != std::string::npos && length < head_end) {
+        body_size = std::strtoull(buffer.c_str() + length + 16, nullptr, 10);
+      }
+      if (buffer.size() >= head_end + 4 + body_size) {
+        request = buffer.substr(0, head_end + 4 + body_size);
+        buffer.erase(0, head_end + 4 + body_size);
+        return true;
+      }
+    }
+    char data[4096];
+    ssize_t n = ::recv(fd, data, sizeof(data), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer.append(data, static_cast<size_t>(n));
+  }
+}
+
+// Accepts connections one at a time and hands every request to respond, with
+// its index among all the requests. respond writes the response and returns
+// whether the connection stays open. Destroy the clients first, their idle
+// connections hold the server thread.
+class StandInServer {
+public:
+  using Respond = std::function<bool(int fd, int index, const std::string &)>;
+
+  explicit StandInServer(Respond respond) : respond(std::move(respond)) {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t size = sizeof(address);
+    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), size) != 0 ||
+        ::listen(listen_fd, 8) != 0 ||
+        ::getsockname(listen_fd, reinterpret_cast<sockaddr *>(&address),
+                      &size) != 0) {
+      throw std::runtime_error("Could not listen on 127.0.0.1");
+    }
+    port = ntohs(address.sin_port);
+    thread = std::thread([this] { serve(); });
+  }
+
+  ~StandInServer() {
+    stopping = true;
+    ::shutdown(listen_fd, SHUT_RDWR);
+    ::close(listen_fd);
+    thread.join();
+  }
+
+  std::string url(const std::string &host = "127.0.0.1") const {
+    return "http://" + host + ":" + std::to_string(port) + "/v2/pipeline";
+  }
+
+  std::atomic<int> connections{0};
+  std::atomic<int> requests{0};
+
+private:
+  void serve() {
+    while (!stopping) {
+      int fd = ::accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      connections++;
+      std::string buffer;
+      std::string request;
+      while (read_request(fd, buffer, request)) {
+        if (!respond(fd, requests++, request)) {
+          break;
+        }
+      }
+      ::close(fd);
+    }
+  }
+
+  Respond respond;
+  int listen_fd = -1;
+  int port = 0;
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
+
+std::string response(int status, const std::string &body) {
+  return "HTTP/1.1 " + std::to_string(status) +
+         " X\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" +
+         body;
+}
+
+struct Result {
+  int status = 0;
+  std::string body;
+  std::string error;
+};
+
+Result post(HttpClient &client, const std::string &url,
+            const std::string &method = "POST") {
+  static const std::string body = R"({"requests":[]})";
+  HttpRequest request;
+  request.method = method;
+  request.url = url;
+  request.headers = {{"Authorization", "Bearer token"}};
+  request.body = body.data();
+  request.body_size = body.size();
+
+  Result result;
+  try {
+    client.send(
+        request, [&](int status) { result.status = status; },
+        [&](const char *data, size_t size) { result.body.append(data, size); });
+  } catch (std::exception &e) {
+    result.error = e.what();
+  }
+  return result;
+}
+
+void keeps_connections_alive() {
+  StandInServer server([](int fd, int index, const std::string &request) {
+    bool has_body = request.find(R"({"requests":[]})") != std::string::npos;
+    write_all(fd, response(200, has_body ? "ok" + std::to_string(index) : ""));
+    return true;
+  });
+  HttpClient client;
+  auto first = post(client, server.url());
+  auto second = post(client, server.url());
+  check(first.status == 200 && first.body == "ok0", "first response");
+  check(second.status == 200 && second.body == "ok1", "second response");
+  check(server.connections == 1, "one connection for both requests");
+}
+
+void reads_chunked_bodies() {
+  StandInServer server([](int fd, int, const std::string &) {
+    write_all(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                  "5\r\nhello\r\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    write_all(fd, "6;ext=1\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n");
+    return true;
+  });
+  HttpClient client;
+  auto result = post(client, server.url());
+  check(result.error.empty(), "no error");
+  check(result.body == "hello world", "body of the chunks");
+  auto again = post(client, server.url());
+  check(again.body == "hello world", "connection reusable after the chunks");
+  check(server.connections == 1, "one connection for both requests");
+}
+
+void retries_unavailable() {
+  StandInServer server([](int fd, int index, const std::string &) {
+    write_all(fd, index == 0 ? response(503, "busy") : response(200, "done"));
+    return true;
+  });
+  HttpClient client;
+  auto result = post(client, server.url());
+  check(result.status == 200 && result.body == "done", "retried after 503");
+  check(server.requests == 2, "two requests");
+}
+
+void gives_up_after_three_attempts() {
+  StandInServer server([](int fd, int, const std::string &) {
+    write_all(fd, response(503, "busy"));
+    return true;
+  });
+  HttpClient client;
+  auto result = post(client, server.url());
+  check(result.status == 503 && result.body == "busy", "last 503 handed out");
+  check(server.requests == 3, "three requests");
+}
+
+void retries_gateway_errors_only_when_idempotent() {
+  StandInServer server([](int fd, int index, const std::string &) {
+    // The first answer to the POST and to the GET each
+    write_all(fd, index < 2 ? response(504, "timeout") : response(200, "done"));
+    return true;
+  });
+  HttpClient client;
+  // The push may have been applied behind the gateway
+  auto push = post(client, server.url());
+  check(push.status == 504 && push.body == "timeout", "504 of a POST handed out");
+  check(server.requests == 1, "the POST was sent once");
+
+  auto read = post(client, server.url(), "GET");
+  check(read.status == 200 && read.body == "done", "GET retried after 504");
+  check(server.requests == 3, "the GET was sent twice");
+}
+
+void never_resends_a_received_request() {
+  StandInServer server([](int, int, const std::string &) { return false; });
+  HttpClient client;
+  auto result = post(client, server.url());
+  check(!result.error.empty(), "closed connection is an error");
+  check(result.status == 0, "no status");
+  check(server.requests == 1, "the request was sent once");
+}
+
+void replaces_stale_connections() {
+  StandInServer server([](int fd, int, const std::string &) {
+    // Says keep-alive, then drops the connection while it sits idle
+    write_all(fd, response(200, "ok"));
+    return false;
+  });
+  HttpClient client;
+  auto first = post(client, server.url());
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto second = post(client, server.url());
+  check(first.body == "ok" && second.body == "ok", "both requests answered");
+  check(server.connections == 2, "a new connection for the second request");
+  check(server.requests == 2, "no request lost to the stale connection");
+}
+
+void refuses_remote_hosts() {
+  HttpClient client;
+  auto https = post(client, "https://example.turso.io/v2/pipeline");
+  check(https.error.find("not supported") != std::string::npos,
+        "https is refused");
+
+  auto start = std::chrono::steady_clock::now();
+  // TEST-NET-1, never reached
+  auto remote = post(client, "http://192.0.2.1:8080/v2/pipeline");
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  check(remote.error.find("not a loopback address") != std::string::npos,
+        "plain http to another host is refused");
+  check(elapsed < std::chrono::milliseconds(100), "refused without retries");
+}
+
+void serves_localhost() {
+  StandInServer server([](int fd, int, const std::string &) {
+    write_all(fd, response(200, "ok"));
+    return true;
+  });
+  HttpClient client;
+  auto local = post(client, server.url("localhost"));
+  check(local.body == "ok", "localhost is served");
+}
+
+} // namespace
+
+int main() {
+  const std::pair<const char *, void (*)()> checks[] = {
+      {"keeps connections alive", keeps_connections_alive},
+      {"reads chunked bodies", reads_chunked_bodies},
+      {"retries 503 responses", retries_unavailable},
+      {"gives up after three attempts", gives_up_after_three_attempts},
+      {"retries gateway errors only when idempotent",
+       retries_gateway_errors_only_when_idempotent},
+      {"never resends a received request", never_resends_a_received_request},
+      {"replaces stale connections", replaces_stale_connections},
+      {"refuses remote hosts", refuses_remote_hosts},
+      {"serves localhost", serves_localhost},
+  };
+  for (auto const &entry : checks) {
+    int before = failures;
+    entry.second();
+    std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", entry.first);
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -2,15 +2,18 @@ import { NativeModules, Platform } from "react-native";
 import type {
   _InternalDB,
   _PendingTransaction,
+  AllocatorStats,
   BatchQueryResult,
   DB,
   DBParams,
+  ExecuteOptions,
   OpenOptions,
   OPSQLiteProxy,
   QueryResult,
   Scalar,
   SQLBatchTuple,
   Transaction,
+  WorkerStats,
 } from "./types";
 
 declare global {
@@ -74,6 +77,17 @@ function enhanceDB(db: _InternalDB, options: DBParams): DB {
     attach: db.attach,
     detach: db.detach,
     loadFile: db.loadFile,
+    importFile: db.importFile,
+    insertVectors: db.insertVectors,
+    backup: db.backup,
+    serialize: db.serialize,
+    getSettings: db.getSettings,
+    startCheckpointScheduler: db.startCheckpointScheduler,
+    stopCheckpointScheduler: db.stopCheckpointScheduler,
+    getCheckpointStats: db.getCheckpointStats,
+    getQueueStats: db.getQueueStats,
+    getMemoryUsage: db.getMemoryUsage,
+    releaseMemory: db.releaseMemory,
     updateHook: db.updateHook,
     commitHook: db.commitHook,
     rollbackHook: db.rollbackHook,
@@ -81,31 +95,31 @@ function enhanceDB(db: _InternalDB, options: DBParams): DB {
     getDbPath: db.getDbPath,
     reactiveExecute: db.reactiveExecute,
     sync: db.sync,
+    syncAsync: db.syncAsync,
     setReservedBytes: db.setReservedBytes,
     getReservedBytes: db.getReservedBytes,
     close: db.close,
     interrupt: db.interrupt,
     executeSync: db.executeSync,
+    executeCached: db.executeCached,
+    executeFast: db.executeFast,
+    clearQueryCache: db.clearQueryCache,
     closeAsync: async () => {
       db.close();
     },
     flushPendingReactiveQueries: db.flushPendingReactiveQueries,
-    executeBatch: async (commands: SQLBatchTuple[]): Promise<BatchQueryResult> => {
+    executeBatch: async (
+      commands: SQLBatchTuple[],
+      executeOptions?: ExecuteOptions,
+    ): Promise<BatchQueryResult> => {
       async function run() {
         try {
-          enhancedDb.executeSync("BEGIN TRANSACTION;");
-
-          const res = await db.executeBatch(commands as any[]);
-
-          enhancedDb.executeSync("COMMIT;");
+          // Runs in a transaction of its own, opened and closed natively
+          const res = await db.executeBatch(commands as any[], executeOptions);
 
           await db.flushPendingReactiveQueries();
 
           return res;
-        } catch (executionError) {
-          enhancedDb.executeSync("ROLLBACK;");
-
-          throw executionError;
         } finally {
           lock.inProgress = false;
           startNextTransaction();
@@ -123,13 +137,15 @@ function enhanceDB(db: _InternalDB, options: DBParams): DB {
         startNextTransaction();
       });
     },
-    executeWithHostObjects: async (query: string, params?: Scalar[]): Promise<QueryResult> => {
-      return params
-        ? await db.executeWithHostObjects(query, params)
-        : await db.executeWithHostObjects(query);
+    executeWithHostObjects: async (
+      query: string,
+      params?: Scalar[],
+      executeOptions?: ExecuteOptions,
+    ): Promise<QueryResult> => {
+      return await db.executeWithHostObjects(query, params, executeOptions);
     },
-    executeRaw: async (query: string, params?: Scalar[]) => {
-      return db.executeRaw(query, params as Scalar[]);
+    executeRaw: async (query: string, params?: Scalar[], executeOptions?: ExecuteOptions) => {
+      return db.executeRaw(query, params as Scalar[], executeOptions);
     },
     executeRawSync: (query: string, params?: Scalar[]) => {
       return db.executeRawSync(query, params as Scalar[]);
@@ -143,8 +159,12 @@ function enhanceDB(db: _InternalDB, options: DBParams): DB {
     executeAsync: async (query: string, params?: Scalar[] | undefined): Promise<QueryResult> => {
       return db.execute(query, params);
     },
-    execute: async (query: string, params?: Scalar[] | undefined): Promise<QueryResult> => {
-      let res = params ? await db.execute(query, params) : await db.execute(query);
+    execute: async (
+      query: string,
+      params?: Scalar[] | undefined,
+      executeOptions?: ExecuteOptions,
+    ): Promise<QueryResult> => {
+      let res = await db.execute(query, params, executeOptions);
 
       if (!res.rows) {
         const rows: Record<string, Scalar>[] = [];
@@ -277,6 +297,9 @@ export const openSync = (params: {
   authToken: string;
   name: string;
   location?: string;
+  /**
+   * Syncs in the background every this many milliseconds, on libsql and Turso
+   */
   libsqlSyncInterval?: number;
   libsqlOffline?: boolean;
   encryptionKey?: string;
@@ -326,11 +349,22 @@ export const open = (params: OpenOptions): DB => {
 };
 
 /**
- * Async wrapper around open().
- * Useful for cross-platform code that also targets web where openAsync() is required.
+ * Same as open(), but the connection is opened on a background thread, including SQLCipher's key derivation
+ * and loading extensions, so the JS thread is not blocked during startup.
+ * Also the way to open databases on web, where open() is not available.
  */
 export const openAsync = async (params: OpenOptions): Promise<DB> => {
-  return open(params);
+  if (params.location?.startsWith("file://")) {
+    console.warn(
+      "[op-sqlite] You are passing a path with 'file://' prefix, it's automatically removed",
+    );
+    params.location = params.location.substring(7);
+  }
+
+  const db = await OPSQLite.openAsync(params);
+  const enhancedDb = enhanceDB(db, params);
+
+  return enhancedDb;
 };
 
 /**
@@ -379,3 +413,30 @@ export const isIOSEmbedded = (): boolean => {
 
   return OPSQLite.isIOSEmbedded();
 };
+
+/**
+ * Counters of the pool allocator, process wide. Null unless op-sqlite was built with
+ * `"poolAllocator": true`
+ */
+export const getAllocatorStats = (): AllocatorStats | null => {
+  return OPSQLite.getAllocatorStats();
+};
+
+/**
+ * Sets how many native threads run queries, shared by every open database.
+ * Queries of one database still run one at a time, in order. Defaults to 2
+ */
+export const setWorkerThreads = (count: number): void => {
+  OPSQLite.setWorkerThreads(count);
+};
+
+export const getWorkerThreads = (): number => {
+  return OPSQLite.getWorkerThreads();
+};
+
+/**
+ * Queues of every database together and the state of the shared worker threads, to alert on saturation
+ */
+export const getWorkerStats = (): WorkerStats => {
+  return OPSQLite.getWorkerStats();
+};
@@ -1,18 +1,27 @@
 import type {
   _InternalDB,
   _PendingTransaction,
+  AllocatorStats,
   BatchQueryResult,
+  CheckpointStats,
+  DatabaseSettings,
   DB,
   DBParams,
+  FileImportOptions,
   FileLoadResult,
+  MemoryUsage,
   OpenOptions,
   OPSQLiteProxy,
   PreparedStatement,
   QueryResult,
+  QueueStats,
   RawQueryResult,
+  RowIds,
   Scalar,
   SQLBatchTuple,
   Transaction,
+  VectorInsertOptions,
+  WorkerStats,
 } from "./types";
 
 type WorkerPromiser = (type: string, args?: Record<string, unknown>) => Promise<any>;
@@ -302,6 +311,45 @@ function enhanceWebDb(db: _InternalDB, options: { name?: string; location?: stri
     loadFile: async (_location: string): Promise<FileLoadResult> => {
       throw new Error("[op-sqlite] loadFile() is not supported on web.");
     },
+    importFile: async (_path: string, _options: FileImportOptions): Promise<BatchQueryResult> => {
+      throw new Error("[op-sqlite] importFile() is not supported on web.");
+    },
+    insertVectors: async (
+      _table: string,
+      _ids: RowIds | null,
+      _vectors: Float32Array,
+      _dim: number,
+      _options?: VectorInsertOptions,
+    ): Promise<BatchQueryResult> => {
+      throw new Error("[op-sqlite] insertVectors() is not supported on web.");
+    },
+    backup: async (_destPath: string) => {
+      throw new Error("[op-sqlite] backup() is not supported on web.");
+    },
+    serialize: async (_schema?: string): Promise<ArrayBuffer> => {
+      throw new Error("[op-sqlite] serialize() is not supported on web.");
+    },
+    getSettings: async (): Promise<DatabaseSettings> => {
+      throw new Error("[op-sqlite] getSettings() is not supported on web.");
+    },
+    startCheckpointScheduler: () => {
+      throw new Error("[op-sqlite] startCheckpointScheduler() is not supported on web.");
+    },
+    stopCheckpointScheduler: () => {
+      throw new Error("[op-sqlite] stopCheckpointScheduler() is not supported on web.");
+    },
+    getCheckpointStats: (): CheckpointStats => {
+      throw new Error("[op-sqlite] getCheckpointStats() is not supported on web.");
+    },
+    getQueueStats: (): QueueStats => {
+      throw new Error("[op-sqlite] getQueueStats() is not supported on web.");
+    },
+    getMemoryUsage: async (): Promise<MemoryUsage> => {
+      throw new Error("[op-sqlite] getMemoryUsage() is not supported on web.");
+    },
+    releaseMemory: async () => {
+      throw new Error("[op-sqlite] releaseMemory() is not supported on web.");
+    },
     updateHook: () => {
       throw new Error("[op-sqlite] updateHook() is not supported on web.");
     },
@@ -327,9 +375,15 @@ function enhanceWebDb(db: _InternalDB, options: { name?: string; location?: stri
     loadExtension: unsupported("loadExtension"),
     executeRaw: db.executeRaw,
     executeRawSync: unsupported("executeRawSync"),
+    executeCached: db.execute,
+    executeFast: db.execute,
+    clearQueryCache: () => {},
     getDbPath: unsupported("getDbPath"),
     reactiveExecute: unsupported("reactiveExecute"),
     sync: unsupported("sync"),
+    syncAsync: async () => {
+      throw new Error("[op-sqlite] syncAsync() is not supported on web.");
+    },
     setReservedBytes: unsupported("setReservedBytes"),
     getReservedBytes: unsupported("getReservedBytes"),
     flushPendingReactiveQueries: async () => {},
@@ -343,6 +397,14 @@ async function createWebDb(params: OpenOptions): Promise<_InternalDB> {
     throw new Error("[op-sqlite] SQLCipher is not supported on web.");
   }
 
+  if (params.fromBuffer) {
+    throw new Error("[op-sqlite] fromBuffer is not supported on web.");
+  }
+
+  if (params.profile) {
+    throw new Error("[op-sqlite] profile is not supported on web.");
+  }
+
   const promiser = callWorker;
 
   const dbId = `${params.name}-${Date.now()}-${Math.random().toString(36).slice(2)}`;
@@ -396,6 +458,45 @@ async function createWebDb(params: OpenOptions): Promise<_InternalDB> {
     loadFile: async (_location: string) => {
       throw new Error("[op-sqlite] loadFile() is not supported on web.");
     },
+    importFile: async (_path: string, _options: FileImportOptions) => {
+      throw new Error("[op-sqlite] importFile() is not supported on web.");
+    },
+    insertVectors: async (
+      _table: string,
+      _ids: RowIds | null,
+      _vectors: Float32Array,
+      _dim: number,
+      _options?: VectorInsertOptions,
+    ) => {
+      throw new Error("[op-sqlite] insertVectors() is not supported on web.");
+    },
+    backup: async (_destPath: string) => {
+      throw new Error("[op-sqlite] backup() is not supported on web.");
+    },
+    serialize: async (_schema?: string): Promise<ArrayBuffer> => {
+      throw new Error("[op-sqlite] serialize() is not supported on web.");
+    },
+    getSettings: async (): Promise<DatabaseSettings> => {
+      throw new Error("[op-sqlite] getSettings() is not supported on web.");
+    },
+    startCheckpointScheduler: () => {
+      throw new Error("[op-sqlite] startCheckpointScheduler() is not supported on web.");
+    },
+    stopCheckpointScheduler: () => {
+      throw new Error("[op-sqlite] stopCheckpointScheduler() is not supported on web.");
+    },
+    getCheckpointStats: (): CheckpointStats => {
+      throw new Error("[op-sqlite] getCheckpointStats() is not supported on web.");
+    },
+    getQueueStats: (): QueueStats => {
+      throw new Error("[op-sqlite] getQueueStats() is not supported on web.");
+    },
+    getMemoryUsage: async (): Promise<MemoryUsage> => {
+      throw new Error("[op-sqlite] getMemoryUsage() is not supported on web.");
+    },
+    releaseMemory: async () => {
+      throw new Error("[op-sqlite] releaseMemory() is not supported on web.");
+    },
     updateHook: () => {
       throw new Error("[op-sqlite] updateHook() is not supported on web.");
     },
@@ -434,6 +535,13 @@ async function createWebDb(params: OpenOptions): Promise<_InternalDB> {
     executeRawSync: () => {
       throwSyncApiError("executeRawSync");
     },
+    executeCached: async (query: string, bind?: Scalar[]) => {
+      return executeWorker(promiser, dbId, query, bind);
+    },
+    executeFast: async (query: string, bind?: Scalar[]) => {
+      return executeWorker(promiser, dbId, query, bind);
+    },
+    clearQueryCache: () => {},
     getDbPath: () => {
       throwSyncApiError("getDbPath");
     },
@@ -443,6 +551,9 @@ async function createWebDb(params: OpenOptions): Promise<_InternalDB> {
     sync: () => {
       throwSyncApiError("sync");
     },
+    syncAsync: async () => {
+      throw new Error("[op-sqlite] syncAsync() is not supported on web.");
+    },
     setReservedBytes: () => {
       throwSyncApiError("setReservedBytes");
     },
@@ -511,6 +622,20 @@ export const isIOSEmbedded = (): boolean => {
   return false;
 };
 
+export const getAllocatorStats = (): AllocatorStats | null => {
+  return null;
+};
+
+export const setWorkerThreads = (_count: number): void => {};
+
+export const getWorkerThreads = (): number => {
+  return 1;
+};
+
+export const getWorkerStats = (): WorkerStats => {
+  throw new Error("[op-sqlite] getWorkerStats() is not supported on web.");
+};
+
 /**
  * @deprecated Use `isIOSEmbedded` instead. This alias will be removed in a future release.
  */
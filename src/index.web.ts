@@ -3,18 +3,37 @@ export { Storage } from "./Storage.web";
 export type {
 	_InternalDB,
 	_PendingTransaction,
+	AllocatorStats,
+	BackupOptions,
+	BackupProgress,
 	BatchQueryResult,
+	CheckpointSchedulerOptions,
+	CheckpointStats,
 	ColumnMetadata,
+	DatabaseSettings,
 	DB,
 	DBParams,
+	ExecuteOptions,
+	FileImportOptions,
+	FileLoadOptions,
+	FileLoadProgress,
 	FileLoadResult,
+	MemoryUsage,
 	OPSQLiteProxy,
+	PragmaProfile,
 	PreparedStatement,
+	QueryPriority,
 	QueryResult,
+	QueueStats,
+	RowIds,
 	Scalar,
 	SQLBatchTuple,
+	SyncOptions,
+	SyncPhase,
 	Transaction,
 	UpdateHookOperation,
+	VectorInsertOptions,
+	WorkerStats,
 } from "./types";
 
 export const IOS_DOCUMENT_PATH = "";
@@ -1,5 +1,38 @@
 export type Scalar = string | number | boolean | null | ArrayBuffer | ArrayBufferView;
 
+/**
+ * Pragmas applied natively when the database is opened, before the connection is handed to JS.
+ *
+ * - `read-heavy`: WAL, synchronous NORMAL, 16MB page cache, 256MB mmap, temp tables in memory
+ * - `write-heavy`: WAL, synchronous NORMAL, 8MB page cache, 64MB mmap, temp tables in memory, checkpoints every
+ *   2000 pages and a 64MB WAL size limit
+ * - `low-memory`: WAL, synchronous NORMAL, 512KB page cache, no mmap, temp tables on disk
+ *
+ * All presets set a 5 second busy timeout. An object maps pragma names to values and is applied as is,
+ * e.g. `{ journal_mode: 'WAL', cache_size: -4000 }`
+ */
+export type PragmaProfile =
+  | "read-heavy"
+  | "write-heavy"
+  | "low-memory"
+  | Record<string, string | number | boolean>;
+
+/**
+ * Effective values reported by `db.getSettings()`, straight from the corresponding pragmas.
+ * Pragmas the backend does not support are left out
+ */
+export type DatabaseSettings = {
+  busy_timeout?: number;
+  journal_mode?: string;
+  synchronous?: number;
+  cache_size?: number;
+  mmap_size?: number;
+  temp_store?: number;
+  page_size?: number;
+  wal_autocheckpoint?: number;
+  journal_size_limit?: number;
+};
+
 export interface OpenOptions {
   /**
    * The file name of the database to open.
@@ -27,6 +60,20 @@ export interface OpenOptions {
    * opening databases will throw.
    */
   readOnly?: boolean;
+  /**
+   * Opens an in-memory database initialized from a database image, e.g. one returned by `db.serialize()` or a
+   * bundled asset read into memory. The buffer is copied, changes are never written back to it.
+   *
+   * `name` is still used to identify the database, `location` is ignored. Combine with `readOnly` to keep the
+   * image from being modified. Only supported for plain SQLite3 and SQLCipher (the image must not be encrypted).
+   */
+  fromBuffer?: ArrayBuffer;
+  /**
+   * Performance pragmas to apply while opening, either a preset or custom pragma values. See `PragmaProfile`.
+   *
+   * Not supported on Turso
+   */
+  profile?: PragmaProfile;
 }
 
 /**
@@ -101,6 +148,205 @@ export type FileLoadResult = BatchQueryResult & {
   commands?: number;
 };
 
+export type FileLoadProgress = {
+  rowsAffected: number;
+  commands: number;
+  bytesRead: number;
+  totalBytes: number;
+};
+
+export type FileLoadOptions = {
+  /**
+   * Commit every `chunkSize` statements instead of running the whole file in a single transaction.
+   * If the import fails only the current chunk is rolled back.
+   */
+  chunkSize?: number;
+  /**
+   * Called roughly every megabyte read and once the import is done
+   */
+  onProgress?: (progress: FileLoadProgress) => void;
+};
+
+export type BackupProgress = {
+  remaining: number;
+  pageCount: number;
+};
+
+/**
+ * Phase of a sync as it starts. Turso reports `push`, `pull` and `apply` (only when the remote had changes),
+ * libsql a single `sync`
+ */
+export type SyncPhase = "push" | "pull" | "apply" | "sync";
+
+export type SyncOptions = {
+  onProgress?: (phase: SyncPhase) => void;
+};
+
+export type BackupOptions = {
+  /**
+   * Database to copy, "main" by default. Can be the alias of an attached database or "temp"
+   */
+  schema?: string;
+  /**
+   * Pages copied per step, at least 1, -1 copies everything in a single step. Defaults to 100
+   */
+  pagesPerStep?: number;
+  /**
+   * Pause between steps, the database thread stays free for other queries meanwhile. Defaults to 0
+   */
+  sleepMs?: number;
+  onProgress?: (progress: BackupProgress) => void;
+};
+
+export type CheckpointSchedulerOptions = {
+  /**
+   * WAL size in bytes above which a checkpoint runs right away and the WAL file is truncated. Defaults to 64MB
+   */
+  walSizeLimit?: number;
+  /**
+   * Time without commits before a checkpoint runs. Defaults to 1000
+   */
+  idleMs?: number;
+};
+
+export type CheckpointStats = {
+  running: boolean;
+  checkpoints: number;
+  /**
+   * Checkpoints that also truncated the WAL file because it crossed `walSizeLimit`
+   */
+  truncates: number;
+  /**
+   * Checkpoints that could not copy every frame back, e.g. because another connection was reading
+   */
+  busy: number;
+  walFrames: number;
+  checkpointedFrames: number;
+  lastDurationMs: number;
+};
+
+/**
+ * Memory held by one connection, from sqlite3_db_status. Sizes are in bytes, the cache counters are totals since
+ * the database was opened
+ */
+export type MemoryUsage = {
+  cacheUsed: number;
+  schemaUsed: number;
+  statementsUsed: number;
+  cacheHits: number;
+  cacheMisses: number;
+  cacheSpills: number;
+  lookasideUsed: number;
+  lookasideHits: number;
+  lookasideMisses: number;
+};
+
+/**
+ * Queue of one database. Wait times cover the last 512 queries
+ */
+export type QueueStats = {
+  queued: number;
+  running: number;
+  completed: number;
+  /**
+   * Queries rejected without running because they were still queued at their `deadlineMs`
+   */
+  expired: number;
+  waitP50Ms: number;
+  waitP95Ms: number;
+  waitP99Ms: number;
+  waitMaxMs: number;
+  /**
+   * Total time spent running queries
+   */
+  busyMs: number;
+};
+
+/**
+ * Queues of every database together, plus the shared worker threads
+ */
+export type WorkerStats = QueueStats & {
+  threads: number;
+  busyThreads: number;
+  /**
+   * Databases with queries waiting for a free thread. Above 0 for long means the threads are saturated
+   */
+  waitingDatabases: number;
+};
+
+export type AllocatorStats = {
+  allocations: number;
+  frees: number;
+  threadCacheHits: number;
+  sharedPoolHits: number;
+  systemAllocations: number;
+  largeAllocations: number;
+  bytesInUse: number;
+  bytesCached: number;
+};
+
+export type FileImportOptions = {
+  format: "csv" | "ndjson";
+  table: string;
+  /**
+   * Columns to fill. For CSV files with a header they are looked up by name in the header,
+   * without a header fields are mapped in order. For NDJSON they are the keys read from every object.
+   * Defaults to the CSV header or the keys of the first NDJSON object
+   */
+  columns?: string[];
+  /**
+   * Whether the first CSV row is a header. Defaults to true
+   */
+  header?: boolean;
+  /**
+   * CSV field delimiter, a single character. Defaults to ","
+   */
+  delimiter?: string;
+  /**
+   * Commit every `chunkSize` rows instead of importing the whole file in a single transaction
+   */
+  chunkSize?: number;
+  onProgress?: (progress: FileLoadProgress) => void;
+};
+
+export type RowIds = number[] | Int32Array | Uint32Array | Float64Array;
+
+export type VectorInsertOptions = {
+  /**
+   * Column receiving the vectors. Defaults to the first column that is not the primary key
+   */
+  column?: string;
+  /**
+   * Commit every `chunkSize` vectors. Defaults to 10000, 0 inserts everything in a single transaction
+   */
+  chunkSize?: number;
+  onProgress?: (progress: FileLoadProgress) => void;
+};
+
+export type QueryPriority = "interactive" | "normal" | "background";
+
+export type ExecuteOptions = {
+  /**
+   * Lane of the database queue the query waits in. Interactive queries run before anything else queued,
+   * background ones get a turn after every few normal ones. Defaults to normal
+   */
+  priority?: QueryPriority;
+  /**
+   * Cancels the query when aborted. A queued query is skipped, a running one is interrupted (libsql and Turso
+   * can't interrupt, the result is dropped once it finishes). The promise rejects either way
+   */
+  signal?: AbortSignal;
+  /**
+   * Cancels the query like `signal` once this many milliseconds passed since the call, time spent queued included
+   */
+  timeoutMs?: number;
+  /**
+   * Rejects the query without running it if it is still queued this many milliseconds after the call. Once it
+   * started it runs to completion
+   */
+  deadlineMs?: number;
+};
+
 export type Transaction = {
   commit: () => Promise<QueryResult>;
   execute: (query: string, params?: Scalar[]) => Promise<QueryResult>;
@@ -135,10 +381,31 @@ export type _InternalDB = {
   detach: (alias: string) => void;
   transaction: (fn: (tx: Transaction) => Promise<void>) => Promise<void>;
   executeSync: (query: string, params?: Scalar[]) => QueryResult;
-  execute: (query: string, params?: Scalar[]) => Promise<QueryResult>;
-  executeWithHostObjects: (query: string, params?: Scalar[]) => Promise<QueryResult>;
-  executeBatch: (commands: SQLBatchTuple[]) => Promise<BatchQueryResult>;
-  loadFile: (location: string) => Promise<FileLoadResult>;
+  execute: (query: string, params?: Scalar[], options?: ExecuteOptions) => Promise<QueryResult>;
+  executeWithHostObjects: (
+    query: string,
+    params?: Scalar[],
+    options?: ExecuteOptions,
+  ) => Promise<QueryResult>;
+  executeBatch: (commands: SQLBatchTuple[], options?: ExecuteOptions) => Promise<BatchQueryResult>;
+  loadFile: (location: string, options?: FileLoadOptions) => Promise<FileLoadResult>;
+  importFile: (path: string, options: FileImportOptions) => Promise<BatchQueryResult>;
+  insertVectors: (
+    table: string,
+    ids: RowIds | null,
+    vectors: Float32Array,
+    dim: number,
+    options?: VectorInsertOptions,
+  ) => Promise<BatchQueryResult>;
+  backup: (destPath: string, options?: BackupOptions) => Promise<void>;
+  serialize: (schema?: string) => Promise<ArrayBuffer>;
+  getSettings: () => Promise<DatabaseSettings>;
+  startCheckpointScheduler: (options?: CheckpointSchedulerOptions) => void;
+  stopCheckpointScheduler: () => void;
+  getCheckpointStats: () => CheckpointStats;
+  getQueueStats: () => QueueStats;
+  getMemoryUsage: () => Promise<MemoryUsage>;
+  releaseMemory: () => Promise<void>;
   updateHook: (
     callback?:
       | ((params: {
@@ -153,8 +420,15 @@ export type _InternalDB = {
   rollbackHook: (callback?: (() => void) | null) => void;
   prepareStatement: (query: string) => PreparedStatement;
   loadExtension: (path: string, entryPoint?: string) => void;
-  executeRaw: (query: string, params?: Scalar[]) => Promise<RawQueryResult>;
+  executeRaw: (
+    query: string,
+    params?: Scalar[],
+    options?: ExecuteOptions,
+  ) => Promise<RawQueryResult>;
   executeRawSync: (query: string, params?: Scalar[]) => RawQueryResult;
+  executeCached: (query: string, params?: Scalar[], options?: ExecuteOptions) => Promise<QueryResult>;
+  executeFast: (query: string, params?: Scalar[]) => QueryResult | Promise<QueryResult>;
+  clearQueryCache: () => void;
   getDbPath: (location?: string) => string;
   reactiveExecute: (params: {
     query: string;
@@ -166,6 +440,7 @@ export type _InternalDB = {
     callback: (response: any) => void;
   }) => () => void;
   sync: () => void;
+  syncAsync: (options?: SyncOptions) => Promise<void>;
   setReservedBytes: (reservedBytes: number) => void;
   getReservedBytes: () => number;
   flushPendingReactiveQueries: () => Promise<void>;
@@ -231,7 +506,7 @@ export type DB = {
    * @param params a list of parameters to bind to the query, if any
    * @returns Promise<QueryResult> with the result of the query
    */
-  execute: (query: string, params?: Scalar[]) => Promise<QueryResult>;
+  execute: (query: string, params?: Scalar[], options?: ExecuteOptions) => Promise<QueryResult>;
   /**
    * Similar to the execute function but returns the response in HostObjects
    * Read more about HostObjects in the documentation and their pitfalls
@@ -242,19 +517,91 @@ export type DB = {
    * @param params
    * @returns
    */
-  executeWithHostObjects: (query: string, params?: Scalar[]) => Promise<QueryResult>;
+  executeWithHostObjects: (
+    query: string,
+    params?: Scalar[],
+    options?: ExecuteOptions,
+  ) => Promise<QueryResult>;
   /**
    * Executes all the queries in the params inside a single transaction
    *
-   * It's faster than executing single queries as data is sent to the native side only once
+   * It's faster than executing single queries as data is sent to the native side only once.
+   * With `priority: 'background'` interactive queries can run between the commands of the batch
    * @param commands
    * @returns Promise<BatchQueryResult>
    */
-  executeBatch: (commands: SQLBatchTuple[]) => Promise<BatchQueryResult>;
+  executeBatch: (commands: SQLBatchTuple[], options?: ExecuteOptions) => Promise<BatchQueryResult>;
   /**
    * Loads a SQLite Dump from disk. It will be the fastest way to execute a large set of queries as no JS is involved
+   *
+   * Statements can span multiple lines, the file is streamed so it is never fully loaded in memory
    */
-  loadFile: (location: string) => Promise<FileLoadResult>;
+  loadFile: (location: string, options?: FileLoadOptions) => Promise<FileLoadResult>;
+  /**
+   * Imports a CSV or NDJSON file into a table. Parsing and inserts happen natively on the database thread,
+   * no data crosses into JS
+   *
+   * Empty unquoted CSV fields are inserted as NULL, nested NDJSON objects and arrays are stored as JSON text
+   */
+  importFile: (path: string, options: FileImportOptions) => Promise<BatchQueryResult>;
+  /**
+   * Inserts `vectors.length / dim` float32 vectors into `table`, e.g. a sqlite-vec `vec0` table, with `ids` as their rowids.
+   * Every row is bound straight from the typed array's memory on the database thread and commits happen in chunks,
+   * don't modify `vectors` until the promise settles. Pass `null` as `ids` to let SQLite assign the rowids.
+   *
+   * Not available on libsql or Turso
+   */
+  insertVectors: (
+    table: string,
+    ids: RowIds | null,
+    vectors: Float32Array,
+    dim: number,
+    options?: VectorInsertOptions,
+  ) => Promise<BatchQueryResult>;
+  /**
+   * Copies the database into the file at `destPath` while it stays open, using the SQLite online backup API.
+   * The copy runs in small steps on the database thread so other queries can run in between.
+   *
+   * Also works for in-memory databases, e.g. to persist them to disk. Not available on libsql or Turso
+   */
+  backup: (destPath: string, options?: BackupOptions) => Promise<void>;
+  /**
+   * Returns a copy of the database (`main` unless another attached schema is passed) as a single image,
+   * the same bytes that would be on disk. Pass it to `open({ fromBuffer })` to load it again
+   *
+   * Not available on libsql or Turso
+   */
+  serialize: (schema?: string) => Promise<ArrayBuffer>;
+  /**
+   * Reads the effective journal mode, synchronous level, cache, mmap, temp store and busy timeout settings,
+   * e.g. to check what a `profile` resulted in
+   */
+  getSettings: () => Promise<DatabaseSettings>;
+  /**
+   * Replaces SQLite's auto-checkpoint with checkpoints on a low priority background thread. They run once no
+   * commit happened for `idleMs`, or right away when the WAL grows past `walSizeLimit`, in which case the WAL
+   * file is also truncated. The database must be in WAL mode. Not available on libsql or Turso
+   */
+  startCheckpointScheduler: (options?: CheckpointSchedulerOptions) => void;
+  /**
+   * Stops the checkpoint scheduler and restores SQLite's auto-checkpoint
+   */
+  stopCheckpointScheduler: () => void;
+  getCheckpointStats: () => CheckpointStats;
+  /**
+   * Depth of this database's queue, how long queries waited in it and how long they ran
+   */
+  getQueueStats: () => QueueStats;
+  /**
+   * Page cache, schema and prepared statement memory of this connection. Useful to budget memory across
+   * databases. Not available on libsql or Turso
+   */
+  getMemoryUsage: () => Promise<MemoryUsage>;
+  /**
+   * Frees the unused pages of this connection's cache. Also happens automatically for every open database
+   * when the OS sends a memory warning. Not available on libsql or Turso
+   */
+  releaseMemory: () => Promise<void>;
   updateHook: (
     callback?:
       | ((params: {
@@ -286,11 +633,35 @@ export type DB = {
    * Same as `execute` except the rows are returned in arrays with just the values and not the keys.
    * The result includes `rawRows` plus `columnNames` so callers can map them when needed.
    */
-  executeRaw: (query: string, params?: Scalar[]) => Promise<RawQueryResult>;
+  executeRaw: (
+    query: string,
+    params?: Scalar[],
+    options?: ExecuteOptions,
+  ) => Promise<RawQueryResult>;
   /**
    * Same as `executeRaw` but it will block the JS thread and therefore your UI and should be used with caution
    */
   executeRawSync: (query: string, params?: Scalar[]) => RawQueryResult;
+  /**
+   * Same as `execute` but read-only results are kept in a native cache keyed by the query and its params.
+   * Repeated calls are answered straight from the cache on the JS thread, without a trip through the
+   * database thread. Entries are dropped as soon as one of the tables they read is written to.
+   *
+   * Only changes made through this connection are tracked. Not available with libsql or Turso.
+   */
+  executeCached: (query: string, params?: Scalar[], options?: ExecuteOptions) => Promise<QueryResult>;
+  /**
+   * Same as `execute`, but a read that was cheap the last time it ran is executed right away on the JS thread
+   * when nothing is queued for this database, and its result is returned directly instead of a promise.
+   * Anything else goes through the database thread as usual. `await` the result in both cases.
+   *
+   * Not available with libsql or Turso.
+   */
+  executeFast: (query: string, params?: Scalar[]) => QueryResult | Promise<QueryResult>;
+  /**
+   * Drops every entry cached by `executeCached`
+   */
+  clearQueryCache: () => void;
   /**
    * Gets the absolute path to the db file. Useful for debugging on local builds and for attaching the DB from users devices
    */
@@ -315,6 +686,12 @@ export type DB = {
    * The database is hosted in turso
    **/
   sync: () => void;
+  /**
+   * Same as `sync`, but it runs on a thread of its own and resolves once done, the JS thread and queries keep
+   * going meanwhile. Calls made while a sync runs share the single sync that follows it. Only for databases
+   * opened with `openSync` or `openRemote` on libsql or Turso
+   */
+  syncAsync: (options?: SyncOptions) => Promise<void>;
   setReservedBytes: (reservedBytes: number) => void;
   getReservedBytes: () => number;
   /**
@@ -336,10 +713,15 @@ export type DBParams = {
 
 export type OPSQLiteProxy = {
   open: (options: { name: string; location?: string; encryptionKey?: string }) => _InternalDB;
+  openAsync: (options: OpenOptions) => Promise<_InternalDB>;
   openRemote: (options: { url: string; authToken: string }) => _InternalDB;
   openSync: (options: DBParams) => _InternalDB;
   isSQLCipher: () => boolean;
   isLibsql: () => boolean;
   isTurso: () => boolean;
   isIOSEmbedded: () => boolean;
+  getAllocatorStats: () => AllocatorStats | null;
+  setWorkerThreads: (count: number) => void;
+  getWorkerThreads: () => number;
+  getWorkerStats: () => WorkerStats;
 };